@@ -0,0 +1,109 @@
+#include "runtime.h"
+#include <iostream>
+#include <stdexcept>
+#include <vector>
+#include "../native_funcs.h"
+
+namespace lox
+{
+    namespace aot
+    {
+        namespace
+        {
+            // exit code for a runtime error, the one clox uses
+            constexpr int RUNTIME_ERROR = 70;
+        }
+
+        void fail(int line, const std::string& message)
+        {
+            throw lox_runtime_exception(token{token_type::END_OF_FILE, "", object(), line}, message);
+        }
+
+        object binary(token_type op, const operands& values, int line)
+        {
+            auto& left = values.left;
+            auto& right = values.right;
+            try {
+                switch (op) {
+                    case token_type::GREATER:
+                        return left > right;
+                    case token_type::GREATER_EQUAL:
+                        return left >= right;
+                    case token_type::LESS:
+                        return left < right;
+                    case token_type::LESS_EQUAL:
+                        return left <= right;
+                    case token_type::PLUS:
+                        return left + right;
+                    case token_type::MINUS:
+                        return left - right;
+                    case token_type::SLASH:
+                        return left / right;
+                    default:
+                        return left * right;
+                }
+            }
+            catch (std::logic_error& e) {
+                fail(line, e.what());
+            }
+        }
+
+        object unary(token_type op, const object& value, int line)
+        {
+            try {
+                return op == token_type::MINUS ? -value : !value;
+            }
+            catch (std::logic_error& e) {
+                fail(line, e.what());
+            }
+        }
+
+        object call(std::initializer_list<object> callee_and_arguments, int line)
+        {
+            auto& callee = *callee_and_arguments.begin();
+            std::vector<object> arguments(callee_and_arguments.begin() + 1, callee_and_arguments.end());
+
+            if (not callee.is_callable()) {
+                fail(line, "Can only call functions and classes.");
+            }
+
+            auto func = callee.as_callable();
+            if (static_cast<int>(arguments.size()) != func->arity()) {
+                fail(line, "Expected " +
+                    std::to_string(func->arity()) +
+                    " arguments but got " +
+                    std::to_string(arguments.size()) + ".");
+            }
+
+            // only natives exist so far and they don't use the interpreter
+            return func->call(nullptr, arguments);
+        }
+
+        void print(const object& value)
+        {
+            std::cout << value.to_string() << std::endl;
+        }
+
+        object native(const char* name)
+        {
+            return native_functions().at(name);
+        }
+
+        void global::undefined(int line) const
+        {
+            fail(line, "Undefined variable '" + std::string(m_name) + "'.");
+        }
+
+        int run(void (*program)())
+        {
+            try {
+                program();
+            }
+            catch (const lox_runtime_exception& e) {
+                std::cerr << e.m_message << std::endl << "[line " << e.m_token.line << "]" << std::endl;
+                return RUNTIME_ERROR;
+            }
+            return 0;
+        }
+    }
+}
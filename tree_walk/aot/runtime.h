@@ -0,0 +1,152 @@
+#pragma once
+#include <initializer_list>
+#include <string>
+#include "../token.h"
+
+// what programs generated by loxc are compiled against. values are the
+// interpreter's own objects, so printing and the operators behave the same,
+// and every error names the line the tree walker would have reported
+namespace lox
+{
+    namespace aot
+    {
+        // both operands of a binary operator, braced so the left is evaluated first
+        struct operands {
+            object left;
+            object right;
+        };
+
+        // throws the runtime error run reports, the same way tree_walk::runtime_error does
+        [[noreturn]] void fail(int line, const std::string& message);
+
+        // the checked operators, for operands that aren't all numbers
+        object binary(token_type op, const operands& values, int line);
+        object unary(token_type op, const object& value, int line);
+
+        template <token_type OP>
+        object arithmetic(const operands& values, int line)
+        {
+            if (values.left.is_number() && values.right.is_number()) {
+                double a = values.left.as_number();
+                double b = values.right.as_number();
+                if constexpr (OP == token_type::PLUS) return object(a + b);
+                else if constexpr (OP == token_type::MINUS) return object(a - b);
+                else if constexpr (OP == token_type::STAR) return object(a * b);
+                else if constexpr (OP == token_type::SLASH) return object(a / b);
+                else if constexpr (OP == token_type::GREATER) return object(a > b);
+                else if constexpr (OP == token_type::GREATER_EQUAL) return object(a >= b);
+                else if constexpr (OP == token_type::LESS) return object(a < b);
+                else return object(a <= b);
+            }
+            return binary(OP, values, line);
+        }
+
+        inline object add(const operands& values, int line)
+        {
+            return arithmetic<token_type::PLUS>(values, line);
+        }
+
+        inline object subtract(const operands& values, int line)
+        {
+            return arithmetic<token_type::MINUS>(values, line);
+        }
+
+        inline object multiply(const operands& values, int line)
+        {
+            return arithmetic<token_type::STAR>(values, line);
+        }
+
+        inline object divide(const operands& values, int line)
+        {
+            return arithmetic<token_type::SLASH>(values, line);
+        }
+
+        inline object greater(const operands& values, int line)
+        {
+            return arithmetic<token_type::GREATER>(values, line);
+        }
+
+        inline object greater_equal(const operands& values, int line)
+        {
+            return arithmetic<token_type::GREATER_EQUAL>(values, line);
+        }
+
+        inline object less(const operands& values, int line)
+        {
+            return arithmetic<token_type::LESS>(values, line);
+        }
+
+        inline object less_equal(const operands& values, int line)
+        {
+            return arithmetic<token_type::LESS_EQUAL>(values, line);
+        }
+
+        // equality is defined for every pair of types, so it never fails
+        inline object equal(const operands& values)
+        {
+            return values.left == values.right;
+        }
+
+        inline object not_equal(const operands& values)
+        {
+            return values.left != values.right;
+        }
+
+        inline object negate(const object& value, int line)
+        {
+            if (value.is_number()) {
+                return object(-value.as_number());
+            }
+            return unary(token_type::MINUS, value, line);
+        }
+
+        // the callee comes first, it is evaluated before the arguments
+        object call(std::initializer_list<object> callee_and_arguments, int line);
+
+        void print(const object& value);
+
+        // the native function of that name, see native_functions
+        object native(const char* name);
+
+        // a global variable, which can be used before its declaration has run
+        class global
+        {
+            public:
+                global(const char* name) : m_name(name) {}
+
+                void define(object value)
+                {
+                    m_value = value;
+                    m_defined = true;
+                }
+
+                const object& get(int line) const
+                {
+                    if (not m_defined) {
+                        undefined(line);
+                    }
+                    return m_value;
+                }
+
+                const object& assign(object value, int line)
+                {
+                    if (not m_defined) {
+                        undefined(line);
+                    }
+                    m_value = value;
+                    return m_value;
+                }
+
+            private:
+                [[noreturn]] void undefined(int line) const;
+
+                const char* m_name;
+                object m_value;
+                bool m_defined = false;
+        };
+
+        // runs the program, reporting a runtime error like the interpreter does.
+        // returns the process exit code
+        int run(void (*program)());
+    }
+}
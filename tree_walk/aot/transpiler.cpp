@@ -0,0 +1,359 @@
+#include "transpiler.h"
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include "../native_funcs.h"
+#include "../tree_walk.h"
+
+namespace lox
+{
+    namespace
+    {
+        // the shortest decimal that reads back as exactly the same double
+        std::string number_literal(double value)
+        {
+            if (std::isnan(value)) {
+                return "std::numeric_limits<double>::quiet_NaN()";
+            }
+            if (std::isinf(value)) {
+                return value > 0 ? "std::numeric_limits<double>::infinity()" :
+                                   "-std::numeric_limits<double>::infinity()";
+            }
+
+            char buffer[32];
+            if (value == std::trunc(value) && std::fabs(value) < 1e15) {
+                std::snprintf(buffer, sizeof(buffer), "%.1f", value);
+                return buffer;
+            }
+            for (int precision = 1; precision <= 17; precision++) {
+                std::snprintf(buffer, sizeof(buffer), "%.*g", precision, value);
+                if (std::strtod(buffer, nullptr) == value) {
+                    break;
+                }
+            }
+            std::string text = buffer;
+            // without a point or exponent it would be an int
+            if (text.find_first_of(".e") == std::string::npos) {
+                text += ".0";
+            }
+            return text;
+        }
+
+        std::string string_literal(const std::string& text)
+        {
+            std::string literal = "\"";
+            for (unsigned char c : text) {
+                if (c == '"' || c == '\\') {
+                    literal += '\\';
+                    literal += c;
+                }
+                else if (c == '\n') {
+                    literal += "\\n";
+                }
+                else if (c < ' ' || c >= 0x7f) {
+                    // always three digits so a digit after it can't be taken as part of it
+                    char escape[5];
+                    std::snprintf(escape, sizeof(escape), "\\%03o", c);
+                    literal += escape;
+                }
+                else {
+                    literal += c;
+                }
+            }
+            return literal + "\"";
+        }
+
+        const char* binary_function(token_type op)
+        {
+            switch (op) {
+                case token_type::GREATER:
+                    return "aot::greater";
+                case token_type::GREATER_EQUAL:
+                    return "aot::greater_equal";
+                case token_type::LESS:
+                    return "aot::less";
+                case token_type::LESS_EQUAL:
+                    return "aot::less_equal";
+                case token_type::PLUS:
+                    return "aot::add";
+                case token_type::MINUS:
+                    return "aot::subtract";
+                case token_type::SLASH:
+                    return "aot::divide";
+                default:
+                    return "aot::multiply";
+            }
+        }
+    }
+
+    std::string transpiler::transpile(const std::vector<stmt*>& statements, const std::string& source_name)
+    {
+        // the body of the program function
+        m_indent = 2;
+        for (auto statement : statements) {
+            statement->accept(this);
+        }
+
+        std::ostringstream out;
+        out << "// generated by loxc from " << source_name << ", build it against the runtime with\n"
+            << "//   g++ -std=c++2a -O2 -I <tree_walk> program.cpp <tree_walk>/aot/lox_runtime.a\n"
+            << "#include <limits>\n"
+            << "#include <string>\n"
+            << "#include \"aot/runtime.h\"\n"
+            << "\n"
+            << "using lox::object;\n"
+            << "namespace aot = lox::aot;\n"
+            << "\n"
+            << "namespace\n"
+            << "{\n";
+
+        for (auto& [text, name] : m_constants) {
+            out << "    const object " << name << "(std::string(" << string_literal(text) << "));\n";
+        }
+        if (not m_constants.empty()) {
+            out << "\n";
+        }
+        for (auto& [lox_name, name] : m_globals) {
+            out << "    aot::global " << name << "(" << string_literal(lox_name) << ");\n";
+        }
+        if (not m_globals.empty()) {
+            out << "\n";
+        }
+
+        out << "    void program()\n"
+            << "    {\n";
+        auto natives = native_functions();
+        for (auto& [lox_name, name] : m_globals) {
+            if (natives.count(lox_name)) {
+                out << "        " << name << ".define(aot::native(" << string_literal(lox_name) << "));\n";
+            }
+        }
+        out << m_body.str()
+            << "    }\n"
+            << "}\n"
+            << "\n"
+            << "int main()\n"
+            << "{\n"
+            << "    return aot::run(program);\n"
+            << "}\n";
+        return out.str();
+    }
+
+    object transpiler::visit_assign(assign_expr* exp)
+    {
+        auto value = emit(exp->m_value);
+        if (exp->m_depth == -1) {
+            m_expr = global(exp->m_name) + ".assign(" + value + ", " + std::to_string(exp->m_name.line) + ")";
+        }
+        else {
+            m_expr = "(" + local(exp->m_depth, exp->m_slot) + " = " + value + ")";
+        }
+        return object();
+    }
+
+    object transpiler::visit_binary(binary_expr* exp)
+    {
+        // braced, so the left operand is evaluated first as it is in the interpreter
+        auto operands = "{" + emit(exp->m_left) + ", " + emit(exp->m_right) + "}";
+        switch (exp->m_op.type) {
+            case token_type::EQUAL_EQUAL:
+                m_expr = "aot::equal(" + operands + ")";
+                break;
+            case token_type::BANG_EQUAL:
+                m_expr = "aot::not_equal(" + operands + ")";
+                break;
+            default:
+                m_expr = std::string(binary_function(exp->m_op.type)) + "(" + operands + ", " +
+                         std::to_string(exp->m_op.line) + ")";
+                break;
+        }
+        return object();
+    }
+
+    object transpiler::visit_grouping(grouping_expr* exp)
+    {
+        m_expr = emit(exp->m_expression);
+        return object();
+    }
+
+    object transpiler::visit_literal(literal_expr* exp)
+    {
+        auto& value = exp->m_value;
+        if (value.is_number()) {
+            m_expr = "object(" + number_literal(value.as_number()) + ")";
+        }
+        else if (value.is_boolean()) {
+            m_expr = value.as_boolean() ? "object(true)" : "object(false)";
+        }
+        else if (value.is_text()) {
+            m_expr = constant(value.as_text());
+        }
+        else {
+            m_expr = "object()";
+        }
+        return object();
+    }
+
+    object transpiler::visit_variable(variable_expr* exp)
+    {
+        if (exp->m_depth == -1) {
+            m_expr = global(exp->m_name) + ".get(" + std::to_string(exp->m_name.line) + ")";
+        }
+        else {
+            m_expr = local(exp->m_depth, exp->m_slot);
+        }
+        return object();
+    }
+
+    object transpiler::visit_unary(unary_expr* exp)
+    {
+        auto operand = emit(exp->m_right);
+        if (exp->m_op.type == token_type::MINUS) {
+            m_expr = "aot::negate(" + operand + ", " + std::to_string(exp->m_op.line) + ")";
+        }
+        else {
+            m_expr = "!" + operand;
+        }
+        return object();
+    }
+
+    object transpiler::visit_logical(logical_expr* exp)
+    {
+        // the result is one of the operands rather than a boolean, and the right is
+        // only evaluated when the left doesn't decide it
+        auto left = emit(exp->m_left);
+        auto right = emit(exp->m_right);
+        auto result = exp->m_op.type == token_type::OR ? "value ? value : " + right :
+                                                         "value ? " + right + " : value";
+        m_expr = "[&]() -> object { object value = " + left + "; return " + result + "; }()";
+        return object();
+    }
+
+    object transpiler::visit_call(call_expr* exp)
+    {
+        auto call = "aot::call({" + emit(exp->m_callee);
+        for (auto argument : exp->m_arguments) {
+            call += ", " + emit(argument);
+        }
+        m_expr = call + "}, " + std::to_string(exp->m_paren.line) + ")";
+        return object();
+    }
+
+    void transpiler::visit_print(print_stmt* statement)
+    {
+        write("aot::print(" + emit(statement->m_expression) + ");");
+    }
+
+    void transpiler::visit_expression(expression_stmt* statement)
+    {
+        write(emit(statement->m_expression) + ";");
+    }
+
+    void transpiler::visit_var(var_stmt* statement)
+    {
+        auto value = statement->m_initializer ? emit(statement->m_initializer) : "object()";
+        if (statement->m_slot == -1) {
+            write(global(statement->m_name) + ".define(" + value + ");");
+        }
+        else if (m_blocks.back().m_declared[statement->m_slot]) {
+            write(local(0, statement->m_slot) + " = " + value + ";");
+        }
+        else {
+            m_blocks.back().m_declared[statement->m_slot] = true;
+            write("object " + local(0, statement->m_slot) + " = " + value + ";");
+        }
+    }
+
+    void transpiler::visit_block(block_stmt* statement)
+    {
+        write("{");
+        m_indent++;
+        if (statement->is_scope()) {
+            m_blocks.push_back({statement, std::vector<bool>(statement->m_slot_names.size())});
+        }
+        for (auto inner : statement->m_statements) {
+            inner->accept(this);
+        }
+        if (statement->is_scope()) {
+            m_blocks.pop_back();
+        }
+        m_indent--;
+        write("}");
+    }
+
+    void transpiler::visit_if(if_stmt* statement)
+    {
+        write("if (" + emit(statement->m_condition) + ")");
+        emit_nested(statement->m_then_branch);
+        if (statement->m_else_branch) {
+            write("else");
+            emit_nested(statement->m_else_branch);
+        }
+    }
+
+    void transpiler::visit_while(while_stmt* statement)
+    {
+        write("while (" + emit(statement->m_condition) + ")");
+        emit_nested(statement->m_body);
+    }
+
+    void transpiler::visit_function(function_stmt* statement)
+    {
+        tree_walk::error(statement->m_name, "loxc can't compile functions yet.");
+    }
+
+    void transpiler::visit_return(return_stmt* statement)
+    {
+        // only allowed inside a function body
+    }
+
+    std::string transpiler::emit(expr* exp)
+    {
+        exp->accept(this);
+        return m_expr;
+    }
+
+    void transpiler::emit_nested(stmt* statement)
+    {
+        if (dynamic_cast<block_stmt*>(statement)) {
+            statement->accept(this);
+            return;
+        }
+        write("{");
+        m_indent++;
+        statement->accept(this);
+        m_indent--;
+        write("}");
+    }
+
+    void transpiler::write(const std::string& code)
+    {
+        m_body << std::string(m_indent * 4, ' ') << code << "\n";
+    }
+
+    std::string transpiler::local(int depth, int slot)
+    {
+        // named for the block's nesting level, so c++ scoping matches the resolver's
+        size_t level = m_blocks.size() - depth;
+        return "l" + std::to_string(level) + "_" + m_blocks[level - 1].m_block->m_slot_names[slot];
+    }
+
+    std::string transpiler::global(const token& name)
+    {
+        std::string lox_name(name.lexeme);
+        auto& cpp_name = m_globals[lox_name];
+        if (cpp_name.empty()) {
+            cpp_name = "g_" + lox_name;
+        }
+        return cpp_name;
+    }
+
+    std::string transpiler::constant(const std::string& text)
+    {
+        auto& cpp_name = m_constants[text];
+        if (cpp_name.empty()) {
+            cpp_name = "k" + std::to_string(m_constants.size() - 1);
+        }
+        return cpp_name;
+    }
+}
@@ -0,0 +1,66 @@
+#pragma once
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include "../expr.h"
+#include "../stmt.h"
+
+namespace lox
+{
+    // turns a resolved and folded program into a c++ translation unit that runs it,
+    // built against aot/runtime. block locals become c++ locals in nested scopes, so
+    // the system compiler can keep them in registers, and globals are file statics
+    class transpiler : public expr_visitor, stmt_visitor
+    {
+        public:
+            // source_name only goes in the header comment of the output
+            std::string transpile(const std::vector<stmt*>& statements, const std::string& source_name);
+
+            object visit_assign(assign_expr* exp) override;
+            object visit_binary(binary_expr* exp) override;
+            object visit_grouping(grouping_expr* exp) override;
+            object visit_literal(literal_expr* exp) override;
+            object visit_variable(variable_expr* exp) override;
+            object visit_unary(unary_expr* exp) override;
+            object visit_logical(logical_expr* exp) override;
+            object visit_call(call_expr* exp) override;
+
+            void visit_print(print_stmt* statement) override;
+            void visit_expression(expression_stmt* statement) override;
+            void visit_var(var_stmt* statement) override;
+            void visit_block(block_stmt* statement) override;
+            void visit_if(if_stmt* statement) override;
+            void visit_while(while_stmt* statement) override;
+            void visit_function(function_stmt* statement) override;
+            void visit_return(return_stmt* statement) override;
+
+        private:
+            // c++ for the expression
+            std::string emit(expr* exp);
+            // writes the statement to m_body, inside braces unless it's a block already
+            void emit_nested(stmt* statement);
+            // one line of m_body at the current indent
+            void write(const std::string& code);
+
+            std::string local(int depth, int slot);
+            std::string global(const token& name);
+            std::string constant(const std::string& text);
+
+            // the result of the last expression visited
+            std::string m_expr;
+            std::ostringstream m_body;
+            int m_indent = 0;
+
+            // the blocks enclosing the statement being written, innermost last
+            struct block_scope {
+                block_stmt* m_block;
+                // a redeclaration reuses its slot, so it's written as an assignment
+                std::vector<bool> m_declared;
+            };
+            std::vector<block_scope> m_blocks;
+            // every global the program mentions, and every string literal, by c++ name
+            std::map<std::string, std::string> m_globals;
+            std::map<std::string, std::string> m_constants;
+    };
+}
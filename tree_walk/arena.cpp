@@ -0,0 +1,54 @@
+#include "arena.h"
+#include <cstdint>
+
+namespace lox
+{
+    arena::~arena()
+    {
+        destroy_all();
+    }
+
+    void arena::reset()
+    {
+        destroy_all();
+        m_destructors.clear();
+        m_bytes_used = 0;
+
+        if (not m_blocks.empty()) {
+            // every block is at least BLOCK_SIZE, even the oversized ones
+            m_blocks.resize(1);
+            m_cursor = m_blocks.front().get();
+            m_end = m_cursor + BLOCK_SIZE;
+        }
+    }
+
+    void arena::destroy_all()
+    {
+        // nodes may refer to earlier nodes, so tear down newest first
+        for (auto iter = m_destructors.rbegin(); iter != m_destructors.rend(); ++iter) {
+            iter->destroy(iter->items, iter->count);
+        }
+    }
+
+    void* arena::allocate(size_t size, size_t alignment)
+    {
+        auto address = reinterpret_cast<uintptr_t>(m_cursor);
+        size_t padding = (alignment - (address % alignment)) % alignment;
+
+        if (m_cursor == nullptr || padding + size > static_cast<size_t>(m_end - m_cursor)) {
+            // anything too big for a normal block gets a block of its own
+            size_t block_size = size + alignment > BLOCK_SIZE ? size + alignment : BLOCK_SIZE;
+            m_blocks.push_back(std::unique_ptr<char[]>(new char[block_size]));
+            m_cursor = m_blocks.back().get();
+            m_end = m_cursor + block_size;
+
+            address = reinterpret_cast<uintptr_t>(m_cursor);
+            padding = (alignment - (address % alignment)) % alignment;
+        }
+
+        void* result = m_cursor + padding;
+        m_cursor += padding + size;
+        m_bytes_used += size;
+        return result;
+    }
+}
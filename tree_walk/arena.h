@@ -0,0 +1,105 @@
+#pragma once
+#include <cstddef>
+#include <memory>
+#include <new>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace lox
+{
+    // a fixed size array living in an arena, used for the child lists of ast nodes
+    template <typename T>
+    class node_list
+    {
+        public:
+            node_list() = default;
+            node_list(T* items, size_t size) : m_items(items), m_size(size) {}
+
+            T* begin() const { return m_items; }
+            T* end() const { return m_items + m_size; }
+            size_t size() const { return m_size; }
+            bool empty() const { return m_size == 0; }
+            T& operator[](size_t index) const { return m_items[index]; }
+
+        private:
+            T* m_items = nullptr;
+            size_t m_size = 0;
+    };
+
+    // bump allocator that owns every node of a parsed program, nodes are never
+    // freed individually - everything goes at once when the arena is destroyed
+    class arena
+    {
+        public:
+            arena() = default;
+            ~arena();
+
+            arena(const arena&) = delete;
+            arena& operator=(const arena&) = delete;
+
+            template <typename T, typename... Args>
+            T* make(Args&&... args)
+            {
+                void* memory = allocate(sizeof(T), alignof(T));
+                T* result = new (memory) T(std::forward<Args>(args)...);
+                if constexpr (not std::is_trivially_destructible_v<T>) {
+                    m_destructors.push_back({result, 1, destroy<T>});
+                }
+                return result;
+            }
+
+            template <typename T>
+            node_list<T> make_list(const std::vector<T>& items)
+            {
+                return make_list(items.data(), items.size());
+            }
+
+            template <typename T>
+            node_list<T> make_list(const T* items, size_t count)
+            {
+                if (count == 0) {
+                    return node_list<T>();
+                }
+
+                T* memory = static_cast<T*>(allocate(sizeof(T) * count, alignof(T)));
+                std::uninitialized_copy(items, items + count, memory);
+                if constexpr (not std::is_trivially_destructible_v<T>) {
+                    m_destructors.push_back({memory, count, destroy<T>});
+                }
+                return node_list<T>(memory, count);
+            }
+
+            // destroys every node but keeps the first block for the next batch
+            void reset();
+
+            // total bytes handed out, for reporting
+            size_t bytes_used() const { return m_bytes_used; }
+
+        private:
+            void* allocate(size_t size, size_t alignment);
+            void destroy_all();
+
+            template <typename T>
+            static void destroy(void* items, size_t count)
+            {
+                for (size_t i = 0; i < count; i++) {
+                    static_cast<T*>(items)[i].~T();
+                }
+            }
+
+            struct destructor {
+                void* items;
+                size_t count;
+                void (*destroy)(void*, size_t);
+            };
+
+            static const size_t BLOCK_SIZE = 64 * 1024;
+
+            std::vector<std::unique_ptr<char[]>> m_blocks;
+            char* m_cursor = nullptr;
+            char* m_end = nullptr;
+            size_t m_bytes_used = 0;
+            std::vector<destructor> m_destructors;
+    };
+}
@@ -15,12 +15,12 @@ class ast_printer : public lox::expr_visitor
 
         lox::object visit_binary(lox::binary_expr* expr) override
         {
-            return parenthesize(expr->m_op.lexeme, {expr->m_left.get(), expr->m_right.get()});
+            return parenthesize(expr->m_op.lexeme, {expr->m_left, expr->m_right});
         }
 
         lox::object visit_grouping(lox::grouping_expr* expr) override
         {
-            return parenthesize("group", {expr->m_expression.get()});
+            return parenthesize("group", {expr->m_expression});
         }
 
         lox::object visit_literal(lox::literal_expr* expr) override
@@ -30,11 +30,11 @@ class ast_printer : public lox::expr_visitor
 
         lox::object visit_unary(lox::unary_expr* expr) override
         {
-            return parenthesize(expr->m_op.lexeme, {expr->m_right.get()});
+            return parenthesize(expr->m_op.lexeme, {expr->m_right});
         }
 
     private:
-        lox::object parenthesize(std::string name, std::vector<lox::expr*> exprs)
+        lox::object parenthesize(std::string_view name, std::vector<lox::expr*> exprs)
         {
             std::stringstream stream;
             stream << "(" << name;
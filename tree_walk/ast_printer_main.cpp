@@ -17,21 +17,22 @@ int main()
         star_token.line = 1;
     }
 
-    std::shared_ptr<lox::expr> expression = std::make_shared<lox::binary_expr>(
+    lox::arena nodes;
+    lox::expr* expression = nodes.make<lox::binary_expr>(
         // -123
-        std::make_shared<lox::unary_expr>(minus_token,
-            std::make_shared<lox::literal_expr>(lox::object(123.0))
+        nodes.make<lox::unary_expr>(minus_token,
+            nodes.make<lox::literal_expr>(lox::object(123.0))
         ),
         //*
         star_token,
         //(45.67)
-        std::make_shared<lox::grouping_expr>(
-            std::make_shared<lox::literal_expr>(lox::object(45.67))
+        nodes.make<lox::grouping_expr>(
+            nodes.make<lox::literal_expr>(lox::object(45.67))
         )
     );
 
     ast_printer printer;
-    auto result = printer.print(expression.get());
+    auto result = printer.print(expression);
 
     std::cout << result << std::endl;
 
@@ -0,0 +1,818 @@
+#include "closure_compiler.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "../lox_callable.h"
+
+namespace lox
+{
+    namespace
+    {
+        // the operators, chosen when a node is compiled rather than each time it runs
+
+        template <token_type OP>
+        object apply(const object& a, const object& b)
+        {
+            if constexpr (OP == token_type::GREATER) return a > b;
+            else if constexpr (OP == token_type::GREATER_EQUAL) return a >= b;
+            else if constexpr (OP == token_type::LESS) return a < b;
+            else if constexpr (OP == token_type::LESS_EQUAL) return a <= b;
+            else if constexpr (OP == token_type::BANG_EQUAL) return a != b;
+            else if constexpr (OP == token_type::EQUAL_EQUAL) return a == b;
+            else if constexpr (OP == token_type::PLUS) return a + b;
+            else if constexpr (OP == token_type::MINUS) return a - b;
+            else if constexpr (OP == token_type::SLASH) return a / b;
+            else return a * b;
+        }
+
+        template <token_type OP>
+        auto apply_number(double a, double b)
+        {
+            if constexpr (OP == token_type::GREATER) return a > b;
+            else if constexpr (OP == token_type::GREATER_EQUAL) return a >= b;
+            else if constexpr (OP == token_type::LESS) return a < b;
+            else if constexpr (OP == token_type::LESS_EQUAL) return a <= b;
+            else if constexpr (OP == token_type::BANG_EQUAL) return a != b;
+            else if constexpr (OP == token_type::EQUAL_EQUAL) return a == b;
+            else if constexpr (OP == token_type::PLUS) return a + b;
+            else if constexpr (OP == token_type::MINUS) return a - b;
+            else if constexpr (OP == token_type::SLASH) return a / b;
+            else return a * b;
+        }
+
+        bool is_arithmetic(token_type op)
+        {
+            return op == token_type::PLUS || op == token_type::MINUS ||
+                   op == token_type::STAR || op == token_type::SLASH;
+        }
+
+        // comparing strings or doing arithmetic on them is an error, only these
+        // operators can skip the checks once both sides are known to be strings
+        bool is_string_operator(token_type op)
+        {
+            return op == token_type::PLUS ||
+                   op == token_type::EQUAL_EQUAL ||
+                   op == token_type::BANG_EQUAL;
+        }
+
+        // instantiates NODE for the operator, which is only known at runtime here
+        template <typename BASE, template <token_type> class NODE, typename... Args>
+        BASE* make_for_operator(arena& nodes, token_type op, Args... args)
+        {
+            switch (op) {
+                case token_type::GREATER:
+                    return nodes.make<NODE<token_type::GREATER>>(args...);
+                case token_type::GREATER_EQUAL:
+                    return nodes.make<NODE<token_type::GREATER_EQUAL>>(args...);
+                case token_type::LESS:
+                    return nodes.make<NODE<token_type::LESS>>(args...);
+                case token_type::LESS_EQUAL:
+                    return nodes.make<NODE<token_type::LESS_EQUAL>>(args...);
+                case token_type::BANG_EQUAL:
+                    return nodes.make<NODE<token_type::BANG_EQUAL>>(args...);
+                case token_type::EQUAL_EQUAL:
+                    return nodes.make<NODE<token_type::EQUAL_EQUAL>>(args...);
+                case token_type::PLUS:
+                    return nodes.make<NODE<token_type::PLUS>>(args...);
+                case token_type::MINUS:
+                    return nodes.make<NODE<token_type::MINUS>>(args...);
+                case token_type::SLASH:
+                    return nodes.make<NODE<token_type::SLASH>>(args...);
+                default:
+                    return nodes.make<NODE<token_type::STAR>>(args...);
+            }
+        }
+
+        [[noreturn]] void undefined_variable(const token& name)
+        {
+            throw lox_runtime_exception(name,
+                "Undefined variable '" + std::string(name.lexeme) + "'.");
+        }
+
+        // expressions
+
+        struct constant_node : expr_closure
+        {
+            constant_node(object value) : expr_closure{run}, m_value(value) {}
+
+            static object run(const expr_closure* self, closure_context&)
+            {
+                return static_cast<const constant_node*>(self)->m_value;
+            }
+
+            object m_value;
+        };
+
+        struct local_get_node : expr_closure
+        {
+            local_get_node(size_t index) : expr_closure{run}, m_index(index) {}
+
+            static object run(const expr_closure* self, closure_context& context)
+            {
+                return context.m_slots[static_cast<const local_get_node*>(self)->m_index];
+            }
+
+            size_t m_index;
+        };
+
+        struct local_set_node : expr_closure
+        {
+            local_set_node(size_t index, expr_closure* value) :
+                expr_closure{run}, m_index(index), m_value(value) {}
+
+            static object run(const expr_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const local_set_node*>(self);
+                auto value = node->m_value->m_run(node->m_value, context);
+                context.m_slots[node->m_index] = value;
+                return value;
+            }
+
+            size_t m_index;
+            expr_closure* m_value;
+        };
+
+        struct local_set_number_node : expr_closure
+        {
+            local_set_number_node(size_t index, number_closure* value) :
+                expr_closure{run}, m_index(index), m_value(value) {}
+
+            static object run(const expr_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const local_set_number_node*>(self);
+                object value(node->m_value->m_run(node->m_value, context));
+                context.m_slots[node->m_index] = value;
+                return value;
+            }
+
+            size_t m_index;
+            number_closure* m_value;
+        };
+
+        // globals are looked up the first time the node runs, they are never removed
+        // from the context so the address stays good for the rest of the program
+        struct global_get_node : expr_closure
+        {
+            global_get_node(token name) : expr_closure{run}, m_name(name) {}
+
+            static object run(const expr_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const global_get_node*>(self);
+                if (node->m_global == nullptr) {
+                    auto find_iter = context.m_globals.find(node->m_name.value);
+                    if (find_iter == context.m_globals.end()) {
+                        undefined_variable(node->m_name);
+                    }
+                    node->m_global = &find_iter->second;
+                }
+                return *node->m_global;
+            }
+
+            token m_name;
+            mutable object* m_global = nullptr;
+        };
+
+        struct global_set_node : expr_closure
+        {
+            global_set_node(token name, expr_closure* value) :
+                expr_closure{run}, m_name(name), m_value(value) {}
+
+            static object run(const expr_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const global_set_node*>(self);
+                auto value = node->m_value->m_run(node->m_value, context);
+                if (node->m_global == nullptr) {
+                    auto find_iter = context.m_globals.find(node->m_name.value);
+                    if (find_iter == context.m_globals.end()) {
+                        undefined_variable(node->m_name);
+                    }
+                    node->m_global = &find_iter->second;
+                }
+                *node->m_global = value;
+                return value;
+            }
+
+            token m_name;
+            expr_closure* m_value;
+            mutable object* m_global = nullptr;
+        };
+
+        template <token_type OP>
+        struct binary_node : expr_closure
+        {
+            binary_node(expr_closure* left, expr_closure* right, token op) :
+                expr_closure{run}, m_left(left), m_right(right), m_op(op) {}
+
+            static object run(const expr_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const binary_node*>(self);
+                auto left = node->m_left->m_run(node->m_left, context);
+                auto right = node->m_right->m_run(node->m_right, context);
+                try {
+                    return apply<OP>(left, right);
+                }
+                catch (std::logic_error& e) {
+                    throw lox_runtime_exception(node->m_op, e.what());
+                }
+            }
+
+            expr_closure* m_left;
+            expr_closure* m_right;
+            token m_op;
+        };
+
+        // both operands are proven numbers, the result is boxed for an untyped parent
+        template <token_type OP>
+        struct number_binary_node : expr_closure
+        {
+            number_binary_node(number_closure* left, number_closure* right) :
+                expr_closure{run}, m_left(left), m_right(right) {}
+
+            static object run(const expr_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const number_binary_node*>(self);
+                double left = node->m_left->m_run(node->m_left, context);
+                double right = node->m_right->m_run(node->m_right, context);
+                return object(apply_number<OP>(left, right));
+            }
+
+            number_closure* m_left;
+            number_closure* m_right;
+        };
+
+        // both operands are proven strings and OP is one is_string_operator accepts
+        template <token_type OP>
+        struct string_binary_node : expr_closure
+        {
+            string_binary_node(expr_closure* left, expr_closure* right) :
+                expr_closure{run}, m_left(left), m_right(right) {}
+
+            static object run(const expr_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const string_binary_node*>(self);
+                auto left = node->m_left->m_run(node->m_left, context);
+                auto right = node->m_right->m_run(node->m_right, context);
+                // interned, so the same text is the same object
+                if constexpr (OP == token_type::PLUS) {
+                    return object(left.as_text() + right.as_text());
+                }
+                else if constexpr (OP == token_type::BANG_EQUAL) {
+                    return object(left.bits() != right.bits());
+                }
+                else {
+                    return object(left.bits() == right.bits());
+                }
+            }
+
+            expr_closure* m_left;
+            expr_closure* m_right;
+        };
+
+        struct not_node : expr_closure
+        {
+            not_node(expr_closure* operand) : expr_closure{run}, m_operand(operand) {}
+
+            static object run(const expr_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const not_node*>(self);
+                return !node->m_operand->m_run(node->m_operand, context);
+            }
+
+            expr_closure* m_operand;
+        };
+
+        struct negate_node : expr_closure
+        {
+            negate_node(expr_closure* operand, token op) :
+                expr_closure{run}, m_operand(operand), m_op(op) {}
+
+            static object run(const expr_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const negate_node*>(self);
+                auto operand = node->m_operand->m_run(node->m_operand, context);
+                try {
+                    return -operand;
+                }
+                catch (std::logic_error& e) {
+                    throw lox_runtime_exception(node->m_op, e.what());
+                }
+            }
+
+            expr_closure* m_operand;
+            token m_op;
+        };
+
+        template <bool IS_OR>
+        struct logical_node : expr_closure
+        {
+            logical_node(expr_closure* left, expr_closure* right) :
+                expr_closure{run}, m_left(left), m_right(right) {}
+
+            static object run(const expr_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const logical_node*>(self);
+                auto left = node->m_left->m_run(node->m_left, context);
+                // short circuit
+                if (static_cast<bool>(left) == IS_OR) {
+                    return left;
+                }
+                return node->m_right->m_run(node->m_right, context);
+            }
+
+            expr_closure* m_left;
+            expr_closure* m_right;
+        };
+
+        struct call_node : expr_closure
+        {
+            call_node(expr_closure* callee, node_list<expr_closure*> arguments, token paren) :
+                expr_closure{run}, m_callee(callee), m_arguments(arguments), m_paren(paren) {}
+
+            static object run(const expr_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const call_node*>(self);
+                auto callee = node->m_callee->m_run(node->m_callee, context);
+
+                std::vector<object> arguments;
+                arguments.reserve(node->m_arguments.size());
+                for (auto argument : node->m_arguments) {
+                    arguments.push_back(argument->m_run(argument, context));
+                }
+
+                if (not callee.is_callable()) {
+                    throw lox_runtime_exception(node->m_paren,
+                        "Can only call functions and classes.");
+                }
+
+                auto func = callee.as_callable();
+                if (static_cast<int>(arguments.size()) != func->arity()) {
+                    throw lox_runtime_exception(node->m_paren,
+                        "Expected " +
+                        std::to_string(func->arity()) +
+                        " arguments but got " +
+                        std::to_string(arguments.size()) + ".");
+                }
+
+                // only natives exist so far and they don't use the interpreter
+                return func->call(nullptr, arguments);
+            }
+
+            expr_closure* m_callee;
+            node_list<expr_closure*> m_arguments;
+            token m_paren;
+        };
+
+        // numbers
+
+        struct number_constant_node : number_closure
+        {
+            number_constant_node(double value) : number_closure{run}, m_value(value) {}
+
+            static double run(const number_closure* self, closure_context&)
+            {
+                return static_cast<const number_constant_node*>(self)->m_value;
+            }
+
+            double m_value;
+        };
+
+        struct number_local_node : number_closure
+        {
+            number_local_node(size_t index) : number_closure{run}, m_index(index) {}
+
+            static double run(const number_closure* self, closure_context& context)
+            {
+                return context.m_slots[static_cast<const number_local_node*>(self)->m_index].as_number();
+            }
+
+            size_t m_index;
+        };
+
+        template <token_type OP>
+        struct number_arithmetic_node : number_closure
+        {
+            number_arithmetic_node(number_closure* left, number_closure* right) :
+                number_closure{run}, m_left(left), m_right(right) {}
+
+            static double run(const number_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const number_arithmetic_node*>(self);
+                double left = node->m_left->m_run(node->m_left, context);
+                double right = node->m_right->m_run(node->m_right, context);
+                return apply_number<OP>(left, right);
+            }
+
+            number_closure* m_left;
+            number_closure* m_right;
+        };
+
+        struct number_negate_node : number_closure
+        {
+            number_negate_node(number_closure* operand) : number_closure{run}, m_operand(operand) {}
+
+            static double run(const number_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const number_negate_node*>(self);
+                return -node->m_operand->m_run(node->m_operand, context);
+            }
+
+            number_closure* m_operand;
+        };
+
+        // a proven number with no unboxed form of its own, like an assignment
+        struct unbox_node : number_closure
+        {
+            unbox_node(expr_closure* value) : number_closure{run}, m_value(value) {}
+
+            static double run(const number_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const unbox_node*>(self);
+                return node->m_value->m_run(node->m_value, context).as_number();
+            }
+
+            expr_closure* m_value;
+        };
+
+        // statements
+
+        struct expression_node : stmt_closure
+        {
+            expression_node(expr_closure* expression) :
+                stmt_closure{run}, m_expression(expression) {}
+
+            static void run(const stmt_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const expression_node*>(self);
+                node->m_expression->m_run(node->m_expression, context);
+            }
+
+            expr_closure* m_expression;
+        };
+
+        struct print_node : stmt_closure
+        {
+            print_node(expr_closure* expression) :
+                stmt_closure{run}, m_expression(expression) {}
+
+            static void run(const stmt_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const print_node*>(self);
+                auto value = node->m_expression->m_run(node->m_expression, context);
+                std::cout << value.to_string() << std::endl;
+            }
+
+            expr_closure* m_expression;
+        };
+
+        struct global_var_node : stmt_closure
+        {
+            global_var_node(object name, expr_closure* initializer) :
+                stmt_closure{run}, m_name(name), m_initializer(initializer) {}
+
+            static void run(const stmt_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const global_var_node*>(self);
+                object value;
+                if (node->m_initializer) {
+                    value = node->m_initializer->m_run(node->m_initializer, context);
+                }
+                context.m_globals[node->m_name] = value;
+            }
+
+            object m_name;
+            expr_closure* m_initializer;
+        };
+
+        struct local_var_node : stmt_closure
+        {
+            local_var_node(size_t index, expr_closure* initializer) :
+                stmt_closure{run}, m_index(index), m_initializer(initializer) {}
+
+            static void run(const stmt_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const local_var_node*>(self);
+                object value;
+                if (node->m_initializer) {
+                    value = node->m_initializer->m_run(node->m_initializer, context);
+                }
+                context.m_slots[node->m_index] = value;
+            }
+
+            size_t m_index;
+            expr_closure* m_initializer;
+        };
+
+        struct block_node : stmt_closure
+        {
+            block_node(node_list<stmt_closure*> statements, size_t first_slot, size_t slot_count) :
+                stmt_closure{run}, m_statements(statements),
+                m_first_slot(first_slot), m_slot_count(slot_count) {}
+
+            static void run(const stmt_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const block_node*>(self);
+                for (auto statement : node->m_statements) {
+                    statement->m_run(statement, context);
+                }
+
+                // let go of the block's locals, the same as dropping its environment
+                for (size_t i = 0; i < node->m_slot_count; i++) {
+                    context.m_slots[node->m_first_slot + i] = object();
+                }
+            }
+
+            node_list<stmt_closure*> m_statements;
+            size_t m_first_slot;
+            size_t m_slot_count;
+        };
+
+        struct if_node : stmt_closure
+        {
+            if_node(expr_closure* condition, stmt_closure* then_branch, stmt_closure* else_branch) :
+                stmt_closure{run}, m_condition(condition),
+                m_then_branch(then_branch), m_else_branch(else_branch) {}
+
+            static void run(const stmt_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const if_node*>(self);
+                if (node->m_condition->m_run(node->m_condition, context)) {
+                    if (node->m_then_branch) {
+                        node->m_then_branch->m_run(node->m_then_branch, context);
+                    }
+                }
+                else if (node->m_else_branch) {
+                    node->m_else_branch->m_run(node->m_else_branch, context);
+                }
+            }
+
+            expr_closure* m_condition;
+            stmt_closure* m_then_branch;
+            stmt_closure* m_else_branch;
+        };
+
+        struct while_node : stmt_closure
+        {
+            while_node(expr_closure* condition, stmt_closure* body) :
+                stmt_closure{run}, m_condition(condition), m_body(body) {}
+
+            static void run(const stmt_closure* self, closure_context& context)
+            {
+                auto node = static_cast<const while_node*>(self);
+                while (node->m_condition->m_run(node->m_condition, context)) {
+                    if (node->m_body) {
+                        node->m_body->m_run(node->m_body, context);
+                    }
+                }
+            }
+
+            expr_closure* m_condition;
+            stmt_closure* m_body;
+        };
+    }
+
+    closure_compiler::closure_compiler(arena& nodes) :
+        m_arena(nodes)
+    {
+    }
+
+    stmt_closure* closure_compiler::compile(const std::vector<stmt*>& statements)
+    {
+        return compile_sequence(statements, 0, 0);
+    }
+
+    size_t closure_compiler::slot_count() const
+    {
+        return m_slot_count;
+    }
+
+    object closure_compiler::visit_assign(assign_expr* exp)
+    {
+        if (exp->m_depth == -1) {
+            m_expr = m_arena.make<global_set_node>(exp->m_name, compile(exp->m_value));
+        }
+        else if (exp->m_value->m_static_type == static_type::number) {
+            m_expr = m_arena.make<local_set_number_node>(slot_index(exp->m_depth, exp->m_slot),
+                compile_number(exp->m_value));
+        }
+        else {
+            m_expr = m_arena.make<local_set_node>(slot_index(exp->m_depth, exp->m_slot),
+                compile(exp->m_value));
+        }
+        return object(nullptr);
+    }
+
+    object closure_compiler::visit_binary(binary_expr* exp)
+    {
+        auto op = exp->m_op.type;
+        auto left_type = exp->m_left->m_static_type;
+        auto right_type = exp->m_right->m_static_type;
+
+        if (left_type == static_type::number && right_type == static_type::number) {
+            m_expr = make_for_operator<expr_closure, number_binary_node>(m_arena, op,
+                compile_number(exp->m_left), compile_number(exp->m_right));
+        }
+        else if (left_type == static_type::string && right_type == static_type::string &&
+                 is_string_operator(op)) {
+            m_expr = make_for_operator<expr_closure, string_binary_node>(m_arena, op,
+                compile(exp->m_left), compile(exp->m_right));
+        }
+        else {
+            m_expr = make_for_operator<expr_closure, binary_node>(m_arena, op,
+                compile(exp->m_left), compile(exp->m_right), exp->m_op);
+        }
+        return object(nullptr);
+    }
+
+    object closure_compiler::visit_grouping(grouping_expr* exp)
+    {
+        m_expr = compile(exp->m_expression);
+        return object(nullptr);
+    }
+
+    object closure_compiler::visit_literal(literal_expr* exp)
+    {
+        m_expr = m_arena.make<constant_node>(exp->m_value);
+        return object(nullptr);
+    }
+
+    object closure_compiler::visit_variable(variable_expr* exp)
+    {
+        if (exp->m_depth == -1) {
+            m_expr = m_arena.make<global_get_node>(exp->m_name);
+        }
+        else {
+            m_expr = m_arena.make<local_get_node>(slot_index(exp->m_depth, exp->m_slot));
+        }
+        return object(nullptr);
+    }
+
+    object closure_compiler::visit_unary(unary_expr* exp)
+    {
+        if (exp->m_op.type == token_type::BANG) {
+            m_expr = m_arena.make<not_node>(compile(exp->m_right));
+        }
+        else {
+            m_expr = m_arena.make<negate_node>(compile(exp->m_right), exp->m_op);
+        }
+        return object(nullptr);
+    }
+
+    object closure_compiler::visit_logical(logical_expr* exp)
+    {
+        auto left = compile(exp->m_left);
+        auto right = compile(exp->m_right);
+        if (exp->m_op.type == token_type::OR) {
+            m_expr = m_arena.make<logical_node<true>>(left, right);
+        }
+        else {
+            m_expr = m_arena.make<logical_node<false>>(left, right);
+        }
+        return object(nullptr);
+    }
+
+    object closure_compiler::visit_call(call_expr* exp)
+    {
+        auto callee = compile(exp->m_callee);
+
+        std::vector<expr_closure*> arguments;
+        for (auto argument : exp->m_arguments) {
+            arguments.push_back(compile(argument));
+        }
+
+        m_expr = m_arena.make<call_node>(callee, m_arena.make_list(arguments), exp->m_paren);
+        return object(nullptr);
+    }
+
+    void closure_compiler::visit_print(print_stmt* statement)
+    {
+        m_stmt = m_arena.make<print_node>(compile(statement->m_expression));
+    }
+
+    void closure_compiler::visit_expression(expression_stmt* statement)
+    {
+        m_stmt = m_arena.make<expression_node>(compile(statement->m_expression));
+    }
+
+    void closure_compiler::visit_var(var_stmt* statement)
+    {
+        expr_closure* initializer = nullptr;
+        if (statement->m_initializer) {
+            initializer = compile(statement->m_initializer);
+        }
+
+        if (statement->m_slot == -1) {
+            m_stmt = m_arena.make<global_var_node>(statement->m_name.value, initializer);
+        }
+        else {
+            m_stmt = m_arena.make<local_var_node>(slot_index(0, statement->m_slot), initializer);
+        }
+    }
+
+    void closure_compiler::visit_block(block_stmt* statement)
+    {
+        size_t first_slot = m_next_slot;
+        size_t slot_count = statement->m_slot_names.size();
+
+        if (statement->is_scope()) {
+            m_scope_bases.push_back(first_slot);
+        }
+        m_next_slot += slot_count;
+        m_slot_count = std::max(m_slot_count, m_next_slot);
+
+        std::vector<stmt*> statements(statement->m_statements.begin(), statement->m_statements.end());
+        auto block = compile_sequence(statements, first_slot, slot_count);
+
+        if (statement->is_scope()) {
+            m_scope_bases.pop_back();
+        }
+        m_next_slot = first_slot;
+        m_stmt = block;
+    }
+
+    void closure_compiler::visit_if(if_stmt* statement)
+    {
+        auto condition = compile(statement->m_condition);
+        auto then_branch = compile(statement->m_then_branch);
+        stmt_closure* else_branch = nullptr;
+        if (statement->m_else_branch) {
+            else_branch = compile(statement->m_else_branch);
+        }
+        m_stmt = m_arena.make<if_node>(condition, then_branch, else_branch);
+    }
+
+    void closure_compiler::visit_while(while_stmt* statement)
+    {
+        auto condition = compile(statement->m_condition);
+        m_stmt = m_arena.make<while_node>(condition, compile(statement->m_body));
+    }
+
+    void closure_compiler::visit_function(function_stmt* statement)
+    {
+        // todo, only the interpreter runs functions so far and tree_walk won't hand
+        // a program declaring one to this engine
+        m_stmt = nullptr;
+    }
+
+    void closure_compiler::visit_return(return_stmt* statement)
+    {
+        // only allowed inside a function body
+        m_stmt = nullptr;
+    }
+
+    expr_closure* closure_compiler::compile(expr* exp)
+    {
+        exp->accept(this);
+        return m_expr;
+    }
+
+    number_closure* closure_compiler::compile_number(expr* exp)
+    {
+        // only called for proven numbers, so every shape here can skip its checks
+        if (auto literal = dynamic_cast<literal_expr*>(exp)) {
+            return m_arena.make<number_constant_node>(literal->m_value.as_number());
+        }
+        if (auto variable = dynamic_cast<variable_expr*>(exp)) {
+            return m_arena.make<number_local_node>(slot_index(variable->m_depth, variable->m_slot));
+        }
+        if (auto grouping = dynamic_cast<grouping_expr*>(exp)) {
+            return compile_number(grouping->m_expression);
+        }
+        if (auto unary = dynamic_cast<unary_expr*>(exp)) {
+            if (unary->m_right->m_static_type == static_type::number) {
+                return m_arena.make<number_negate_node>(compile_number(unary->m_right));
+            }
+        }
+        if (auto binary = dynamic_cast<binary_expr*>(exp)) {
+            if (binary->m_left->m_static_type == static_type::number &&
+                binary->m_right->m_static_type == static_type::number &&
+                is_arithmetic(binary->m_op.type)) {
+                return make_for_operator<number_closure, number_arithmetic_node>(m_arena,
+                    binary->m_op.type, compile_number(binary->m_left), compile_number(binary->m_right));
+            }
+        }
+        return m_arena.make<unbox_node>(compile(exp));
+    }
+
+    stmt_closure* closure_compiler::compile(stmt* statement)
+    {
+        statement->accept(this);
+        return m_stmt;
+    }
+
+    stmt_closure* closure_compiler::compile_sequence(const std::vector<stmt*>& statements,
+                                                     size_t first_slot, size_t slot_count)
+    {
+        std::vector<stmt_closure*> compiled;
+        for (auto statement : statements) {
+            if (auto closure = compile(statement)) {
+                compiled.push_back(closure);
+            }
+        }
+        return m_arena.make<block_node>(m_arena.make_list(compiled), first_slot, slot_count);
+    }
+
+    size_t closure_compiler::slot_index(int depth, int slot) const
+    {
+        return m_scope_bases[m_scope_bases.size() - 1 - depth] + slot;
+    }
+}
@@ -0,0 +1,89 @@
+#pragma once
+#include <vector>
+#include "../arena.h"
+#include "../expr.h"
+#include "../stmt.h"
+#include "../string_table.h"
+
+namespace lox
+{
+    // everything compiled code reads and writes while it runs
+    struct closure_context
+    {
+        interned_map<object> m_globals;
+        // every local in the program, each block owns a fixed range of them
+        std::vector<object> m_slots;
+    };
+
+    // the compiled program is a tree of these, each bound to the data its node needs
+    // and to a run function picked for its node kind and operator when it was compiled.
+    // running a node is one indirect call, with no visitor in between
+    struct expr_closure
+    {
+        object (*m_run)(const expr_closure* self, closure_context& context);
+    };
+
+    // an expression type_inference proved is a number, run without boxing the result
+    struct number_closure
+    {
+        double (*m_run)(const number_closure* self, closure_context& context);
+    };
+
+    struct stmt_closure
+    {
+        void (*m_run)(const stmt_closure* self, closure_context& context);
+    };
+
+    // walks the resolved tree once, turning every node into a closure. run type_inference
+    // first, anything it proved to be a number is compiled to number closures
+    class closure_compiler : public expr_visitor, stmt_visitor
+    {
+        public:
+            // closures are allocated in nodes, which has to outlive running them
+            closure_compiler(arena& nodes);
+
+            stmt_closure* compile(const std::vector<stmt*>& statements);
+
+            // how many local slots the compiled program needs in the context
+            size_t slot_count() const;
+
+            object visit_assign(assign_expr* exp) override;
+            object visit_binary(binary_expr* exp) override;
+            object visit_grouping(grouping_expr* exp) override;
+            object visit_literal(literal_expr* exp) override;
+            object visit_variable(variable_expr* exp) override;
+            object visit_unary(unary_expr* exp) override;
+            object visit_logical(logical_expr* exp) override;
+            object visit_call(call_expr* exp) override;
+
+            void visit_print(print_stmt* statement) override;
+            void visit_expression(expression_stmt* statement) override;
+            void visit_var(var_stmt* statement) override;
+            void visit_block(block_stmt* statement) override;
+            void visit_if(if_stmt* statement) override;
+            void visit_while(while_stmt* statement) override;
+            void visit_function(function_stmt* statement) override;
+            void visit_return(return_stmt* statement) override;
+
+        private:
+            expr_closure* compile(expr* exp);
+            number_closure* compile_number(expr* exp);
+            // nullptr for statements that do nothing
+            stmt_closure* compile(stmt* statement);
+            stmt_closure* compile_sequence(const std::vector<stmt*>& statements,
+                                           size_t first_slot, size_t slot_count);
+
+            // where a resolved local lives in the context's slots
+            size_t slot_index(int depth, int slot) const;
+
+            arena& m_arena;
+            // the first slot of every block being compiled, innermost last
+            std::vector<size_t> m_scope_bases;
+            size_t m_next_slot = 0;
+            size_t m_slot_count = 0;
+
+            // what the visit that just returned compiled its node to
+            expr_closure* m_expr = nullptr;
+            stmt_closure* m_stmt = nullptr;
+    };
+}
@@ -0,0 +1,32 @@
+#include "closure_engine.h"
+#include "../native_funcs.h"
+#include "../tree_walk.h"
+
+namespace lox
+{
+    closure_engine::closure_engine()
+    {
+        for (auto& native : native_functions()) {
+            m_context.m_globals[object(native.first)] = native.second;
+        }
+    }
+
+    void closure_engine::interpret(const std::vector<stmt*>& statements)
+    {
+        // the closures only live as long as this run, the same as the tree they came from
+        arena nodes;
+        closure_compiler compiler(nodes);
+        auto program = compiler.compile(statements);
+        m_context.m_slots.assign(compiler.slot_count(), object());
+
+        try {
+            program->m_run(program, m_context);
+        }
+        catch (const lox_runtime_exception& e) {
+            tree_walk::runtime_error(e);
+        }
+
+        // a runtime error leaves the locals of every block it unwound through behind
+        m_context.m_slots.clear();
+    }
+}
@@ -0,0 +1,20 @@
+#pragma once
+#include <vector>
+#include "closure_compiler.h"
+
+namespace lox
+{
+    // compiles each program to closures and runs them. globals persist between calls
+    // to interpret so it can back the interactive prompt
+    class closure_engine
+    {
+        public:
+            closure_engine();
+
+            // expects the statements to have been through type_inference
+            void interpret(const std::vector<stmt*>& statements);
+
+        private:
+            closure_context m_context;
+    };
+}
@@ -0,0 +1,169 @@
+#include "collector.h"
+#include <algorithm>
+#include <iomanip>
+#include "token.h"
+
+namespace lox
+{
+    namespace
+    {
+        // the old generation is never collected before it reaches this
+        constexpr size_t MINIMUM_FULL_BYTES = 8 << 20;
+
+        double milliseconds(std::chrono::steady_clock::duration duration)
+        {
+            return std::chrono::duration<double, std::milli>(duration).count();
+        }
+    }
+
+    collector::collector(root_source& roots) : m_roots(roots)
+    {
+    }
+
+    collector::~collector()
+    {
+        for (auto list : {m_nursery, m_old}) {
+            while (list != nullptr) {
+                auto next = list->m_next;
+                delete list;
+                list = next;
+            }
+        }
+    }
+
+    void collector::mark(traced* object)
+    {
+        // a nursery collection takes everything old to be alive
+        if (object == nullptr || not object->m_collected || object->m_marked ||
+            (object->m_old && not m_full)) {
+            return;
+        }
+        object->m_marked = true;
+        m_gray.push_back(object);
+    }
+
+    void collector::mark(const object& value)
+    {
+        if (value.is_collected()) {
+            mark(value.as_traced());
+        }
+    }
+
+    void collector::scan(traced* root)
+    {
+        if (root == nullptr) {
+            return;
+        }
+        if (not root->m_collected || (root->m_old && not m_full)) {
+            root->trace(*this);
+        }
+        else {
+            mark(root);
+        }
+    }
+
+    void collector::collect(bool full)
+    {
+        auto started = std::chrono::steady_clock::now();
+        m_full = full || m_old_bytes >= m_next_full;
+
+        m_roots.trace_roots(*this);
+        if (not m_full) {
+            for (auto owner : m_remembered) {
+                owner->trace(*this);
+            }
+        }
+        trace_gray();
+        for (auto owner : m_remembered) {
+            owner->m_remembered = false;
+        }
+        m_remembered.clear();
+
+        size_t before = m_nursery_bytes + m_old_bytes;
+        size_t promoted = 0;
+        auto survivors = sweep(m_nursery, promoted);
+        if (m_full) {
+            m_old_bytes = 0;
+            m_old = sweep(m_old, m_old_bytes);
+        }
+        // everything in the nursery that survived is old now
+        while (survivors != nullptr) {
+            auto next = survivors->m_next;
+            survivors->m_old = true;
+            survivors->m_next = m_old;
+            m_old = survivors;
+            survivors = next;
+        }
+        m_old_bytes += promoted;
+        m_nursery = nullptr;
+        m_nursery_bytes = 0;
+
+        if (m_full) {
+            m_next_full = std::max(MINIMUM_FULL_BYTES,
+                static_cast<size_t>(m_old_bytes * m_growth_factor));
+            m_stats.m_full++;
+        }
+        else {
+            m_stats.m_minor++;
+        }
+        // an old object can have grown since it was last measured
+        m_stats.m_bytes_freed += before > m_old_bytes ? before - m_old_bytes : 0;
+        auto pause = std::chrono::steady_clock::now() - started;
+        m_stats.m_total_pause += pause;
+        m_stats.m_longest_pause = std::max(m_stats.m_longest_pause, pause);
+        m_full = false;
+    }
+
+    void collector::set_nursery_size(size_t bytes)
+    {
+        m_nursery_size = bytes;
+    }
+
+    void collector::set_growth_factor(double factor)
+    {
+        m_growth_factor = factor;
+    }
+
+    void collector::report(std::ostream& out) const
+    {
+        auto collections = m_stats.m_minor + m_stats.m_full;
+        auto seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - m_stats.m_started).count();
+        out << "gc: " << m_stats.m_minor << " nursery and " << m_stats.m_full << " full collections, "
+            << std::fixed << std::setprecision(1) << (seconds > 0 ? collections / seconds : 0.0)
+            << " per second" << std::endl
+            << "  pauses " << std::setprecision(3) << milliseconds(m_stats.m_total_pause) << " ms in total, "
+            << milliseconds(m_stats.m_longest_pause) << " ms longest, "
+            << (collections > 0 ? milliseconds(m_stats.m_total_pause) / collections : 0.0) << " ms mean" << std::endl
+            << "  " << m_stats.m_bytes_freed << " bytes freed, " << m_old_bytes + m_nursery_bytes
+            << " bytes in use" << std::endl;
+        out.unsetf(std::ios::fixed);
+    }
+
+    traced* collector::sweep(traced* list, size_t& live_bytes)
+    {
+        traced* survivors = nullptr;
+        while (list != nullptr) {
+            auto next = list->m_next;
+            if (list->m_marked) {
+                list->m_marked = false;
+                list->m_next = survivors;
+                survivors = list;
+                live_bytes += list->size();
+            }
+            else {
+                delete list;
+            }
+            list = next;
+        }
+        return survivors;
+    }
+
+    void collector::trace_gray()
+    {
+        while (not m_gray.empty()) {
+            auto object = m_gray.back();
+            m_gray.pop_back();
+            object->trace(*this);
+        }
+    }
+}
@@ -0,0 +1,141 @@
+#pragma once
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <ostream>
+#include <utility>
+#include <vector>
+
+namespace lox
+{
+    class collector;
+    class object;
+
+    // anything the collector owns. it's created by collector::make and freed once a
+    // collection finds nothing reachable refers to it, so it can be part of a cycle
+    class traced
+    {
+        public:
+            traced() = default;
+            virtual ~traced() = default;
+
+            traced(const traced&) = delete;
+            traced& operator=(const traced&) = delete;
+
+            // marks everything this refers to
+            virtual void trace(collector& gc) = 0;
+            // roughly the memory it holds, which decides when to collect
+            virtual size_t size() const = 0;
+
+            // false for one its owner frees itself, which is never marked or swept
+            bool collected() const { return m_collected; }
+
+        private:
+            friend class collector;
+            traced* m_next = nullptr;
+            bool m_collected = false;
+            bool m_marked = false;
+            // survived a collection, so only a full collection looks at it again
+            bool m_old = false;
+            bool m_remembered = false;
+    };
+
+    // where the program holds references without going through the heap
+    class root_source
+    {
+        public:
+            virtual void trace_roots(collector& gc) = 0;
+    };
+
+    // a precise, non-moving mark and sweep collector with two generations. objects
+    // start in the nursery, which is collected on its own whenever it fills up, and
+    // whatever survives that is promoted. the old generation is only collected when
+    // it has grown by the growth factor since the last full collection
+    class collector
+    {
+        public:
+            explicit collector(root_source& roots);
+            // frees everything, reachable or not
+            ~collector();
+
+            collector(const collector&) = delete;
+            collector& operator=(const collector&) = delete;
+
+            template <typename T, typename... Args>
+            T* make(Args&&... args)
+            {
+                if (m_nursery_bytes >= m_nursery_size) {
+                    collect();
+                }
+                auto object = new T(std::forward<Args>(args)...);
+                static_cast<traced*>(object)->m_collected = true;
+                object->m_next = m_nursery;
+                m_nursery = object;
+                m_nursery_bytes += object->size();
+                return object;
+            }
+
+            // has to be called after storing a reference into owner by any means other
+            // than the slots of an environment, which are roots while they're in use
+            void write_barrier(traced* owner)
+            {
+                if (owner->m_old && not owner->m_remembered) {
+                    owner->m_remembered = true;
+                    m_remembered.push_back(owner);
+                }
+            }
+
+            // for trace and trace_roots
+            void mark(traced* object);
+            void mark(const object& value);
+            // marks a root and traces it whatever its generation, or just traces it
+            // when the collector doesn't own it
+            void scan(traced* root);
+
+            // collects the nursery, and the old generation too if it's due or full is set
+            void collect(bool full = false);
+
+            // bytes of nursery allocation between collections
+            void set_nursery_size(size_t bytes);
+            // the old generation may grow to this many times what survived the last full collection
+            void set_growth_factor(double factor);
+
+            // counts every collection, so something that was freed since a given count
+            // could have had its address reused
+            uint64_t collections() const { return m_stats.m_minor + m_stats.m_full; }
+
+            // collections, pause times, bytes freed and the collection rate so far
+            void report(std::ostream& out) const;
+
+        private:
+            // frees the unmarked objects of the list and unmarks the rest, returning
+            // the survivors and adding up their size
+            traced* sweep(traced* list, size_t& live_bytes);
+            void trace_gray();
+
+            root_source& m_roots;
+            traced* m_nursery = nullptr;
+            traced* m_old = nullptr;
+            size_t m_nursery_bytes = 0;
+            size_t m_old_bytes = 0;
+            // old objects written to since the last collection, which could refer to new ones
+            std::vector<traced*> m_remembered;
+            // marked but not yet traced
+            std::vector<traced*> m_gray;
+            bool m_full = false;
+
+            size_t m_nursery_size = 1 << 20;
+            double m_growth_factor = 2.0;
+            size_t m_next_full = 8 << 20;
+
+            struct statistics {
+                uint64_t m_minor = 0;
+                uint64_t m_full = 0;
+                size_t m_bytes_freed = 0;
+                std::chrono::steady_clock::duration m_total_pause{};
+                std::chrono::steady_clock::duration m_longest_pause{};
+                std::chrono::steady_clock::time_point m_started = std::chrono::steady_clock::now();
+            };
+            statistics m_stats;
+    };
+}
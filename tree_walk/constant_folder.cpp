@@ -0,0 +1,259 @@
+#include "constant_folder.h"
+#include <stdexcept>
+
+namespace lox
+{
+    namespace
+    {
+        literal_expr* as_literal(expr* exp)
+        {
+            return dynamic_cast<literal_expr*>(exp);
+        }
+    }
+
+    constant_folder::constant_folder(arena& nodes) :
+        m_arena(nodes)
+    {
+    }
+
+    void constant_folder::fold(std::vector<stmt*>& statements)
+    {
+        for (auto& statement : statements) {
+            statement = fold(statement);
+        }
+    }
+
+    object constant_folder::visit_assign(assign_expr* exp)
+    {
+        exp->m_value = fold(exp->m_value);
+        m_folded_expr = exp;
+        return object(nullptr);
+    }
+
+    object constant_folder::visit_binary(binary_expr* exp)
+    {
+        exp->m_left = fold(exp->m_left);
+        exp->m_right = fold(exp->m_right);
+        m_folded_expr = exp;
+
+        auto left = as_literal(exp->m_left);
+        auto right = as_literal(exp->m_right);
+        if (left == nullptr || right == nullptr) {
+            return object(nullptr);
+        }
+
+        // the same operators the interpreter uses, so the folded value can't differ
+        try {
+            const object& a = left->m_value;
+            const object& b = right->m_value;
+            switch (exp->m_op.type) {
+                case token_type::GREATER:
+                    m_folded_expr = m_arena.make<literal_expr>(a > b);
+                    break;
+                case token_type::GREATER_EQUAL:
+                    m_folded_expr = m_arena.make<literal_expr>(a >= b);
+                    break;
+                case token_type::LESS:
+                    m_folded_expr = m_arena.make<literal_expr>(a < b);
+                    break;
+                case token_type::LESS_EQUAL:
+                    m_folded_expr = m_arena.make<literal_expr>(a <= b);
+                    break;
+                case token_type::BANG_EQUAL:
+                    m_folded_expr = m_arena.make<literal_expr>(a != b);
+                    break;
+                case token_type::EQUAL_EQUAL:
+                    m_folded_expr = m_arena.make<literal_expr>(a == b);
+                    break;
+                case token_type::PLUS:
+                    m_folded_expr = m_arena.make<literal_expr>(a + b);
+                    break;
+                case token_type::MINUS:
+                    m_folded_expr = m_arena.make<literal_expr>(a - b);
+                    break;
+                case token_type::SLASH:
+                    m_folded_expr = m_arena.make<literal_expr>(a / b);
+                    break;
+                case token_type::STAR:
+                    m_folded_expr = m_arena.make<literal_expr>(a * b);
+                    break;
+                default:
+                    break;
+            }
+        }
+        catch (const std::logic_error&) {
+            // a runtime error, leave it for the interpreter to report
+        }
+        return object(nullptr);
+    }
+
+    object constant_folder::visit_grouping(grouping_expr* exp)
+    {
+        exp->m_expression = fold(exp->m_expression);
+        m_folded_expr = as_literal(exp->m_expression) ? exp->m_expression : exp;
+        return object(nullptr);
+    }
+
+    object constant_folder::visit_literal(literal_expr* exp)
+    {
+        m_folded_expr = exp;
+        return object(nullptr);
+    }
+
+    object constant_folder::visit_variable(variable_expr* exp)
+    {
+        m_folded_expr = exp;
+        return object(nullptr);
+    }
+
+    object constant_folder::visit_unary(unary_expr* exp)
+    {
+        exp->m_right = fold(exp->m_right);
+        m_folded_expr = exp;
+
+        auto right = as_literal(exp->m_right);
+        if (right == nullptr) {
+            return object(nullptr);
+        }
+
+        try {
+            switch (exp->m_op.type) {
+                case token_type::BANG:
+                    m_folded_expr = m_arena.make<literal_expr>(!right->m_value);
+                    break;
+                case token_type::MINUS:
+                    m_folded_expr = m_arena.make<literal_expr>(-right->m_value);
+                    break;
+                default:
+                    break;
+            }
+        }
+        catch (const std::logic_error&) {
+            // a runtime error, leave it for the interpreter to report
+        }
+        return object(nullptr);
+    }
+
+    object constant_folder::visit_logical(logical_expr* exp)
+    {
+        exp->m_left = fold(exp->m_left);
+        exp->m_right = fold(exp->m_right);
+        m_folded_expr = exp;
+
+        auto left = as_literal(exp->m_left);
+        if (left == nullptr) {
+            return object(nullptr);
+        }
+
+        // a known left operand decides whether the right one is evaluated at all,
+        // and the whole expression is worth whichever operand that leaves
+        bool truthy = static_cast<bool>(left->m_value);
+        bool short_circuits = exp->m_op.type == token_type::OR ? truthy : not truthy;
+        m_folded_expr = short_circuits ? exp->m_left : exp->m_right;
+        return object(nullptr);
+    }
+
+    object constant_folder::visit_call(call_expr* exp)
+    {
+        exp->m_callee = fold(exp->m_callee);
+        for (auto& argument : exp->m_arguments) {
+            argument = fold(argument);
+        }
+        m_folded_expr = exp;
+        return object(nullptr);
+    }
+
+    void constant_folder::visit_print(print_stmt* statement)
+    {
+        statement->m_expression = fold(statement->m_expression);
+        m_folded_stmt = statement;
+    }
+
+    void constant_folder::visit_expression(expression_stmt* statement)
+    {
+        statement->m_expression = fold(statement->m_expression);
+        m_folded_stmt = statement;
+    }
+
+    void constant_folder::visit_var(var_stmt* statement)
+    {
+        if (statement->m_initializer) {
+            statement->m_initializer = fold(statement->m_initializer);
+        }
+        m_folded_stmt = statement;
+    }
+
+    void constant_folder::visit_block(block_stmt* statement)
+    {
+        for (auto& inner : statement->m_statements) {
+            inner = fold(inner);
+        }
+        m_folded_stmt = statement;
+    }
+
+    void constant_folder::visit_if(if_stmt* statement)
+    {
+        statement->m_condition = fold(statement->m_condition);
+        statement->m_then_branch = fold(statement->m_then_branch);
+        if (statement->m_else_branch) {
+            statement->m_else_branch = fold(statement->m_else_branch);
+        }
+        m_folded_stmt = statement;
+
+        // a branch is a statement rather than a declaration, so it has no names that
+        // could leak into the enclosing scope when it replaces the if
+        if (auto condition = as_literal(statement->m_condition)) {
+            if (condition->m_value) {
+                m_folded_stmt = statement->m_then_branch;
+            }
+            else {
+                m_folded_stmt = statement->m_else_branch ? statement->m_else_branch : empty_statement();
+            }
+        }
+    }
+
+    void constant_folder::visit_while(while_stmt* statement)
+    {
+        statement->m_condition = fold(statement->m_condition);
+        statement->m_body = fold(statement->m_body);
+        m_folded_stmt = statement;
+
+        auto condition = as_literal(statement->m_condition);
+        if (condition && not condition->m_value) {
+            m_folded_stmt = empty_statement();
+        }
+    }
+
+    void constant_folder::visit_function(function_stmt* statement)
+    {
+        for (auto& inner : statement->m_body) {
+            inner = fold(inner);
+        }
+        m_folded_stmt = statement;
+    }
+
+    void constant_folder::visit_return(return_stmt* statement)
+    {
+        if (statement->m_value) {
+            statement->m_value = fold(statement->m_value);
+        }
+        m_folded_stmt = statement;
+    }
+
+    expr* constant_folder::fold(expr* exp)
+    {
+        exp->accept(this);
+        return m_folded_expr;
+    }
+
+    stmt* constant_folder::fold(stmt* statement)
+    {
+        statement->accept(this);
+        return m_folded_stmt;
+    }
+
+    stmt* constant_folder::empty_statement()
+    {
+        return m_arena.make<block_stmt>(node_list<stmt*>());
+    }
+}
@@ -0,0 +1,52 @@
+#pragma once
+#include <vector>
+#include "arena.h"
+#include "expr.h"
+#include "stmt.h"
+
+namespace lox
+{
+    // runs after the resolver, replacing operators whose operands are all literals with
+    // the literal they evaluate to and dropping branches that can never run. anything
+    // that would raise a runtime error is left alone so it is still reported, with its
+    // line, when the program gets there
+    class constant_folder : public expr_visitor, stmt_visitor
+    {
+        public:
+            // replacement nodes are allocated in nodes, the arena of the program being folded
+            constant_folder(arena& nodes);
+
+            void fold(std::vector<stmt*>& statements);
+
+            object visit_assign(assign_expr* exp) override;
+            object visit_binary(binary_expr* exp) override;
+            object visit_grouping(grouping_expr* exp) override;
+            object visit_literal(literal_expr* exp) override;
+            object visit_variable(variable_expr* exp) override;
+            object visit_unary(unary_expr* exp) override;
+            object visit_logical(logical_expr* exp) override;
+            object visit_call(call_expr* exp) override;
+
+            void visit_print(print_stmt* statement) override;
+            void visit_expression(expression_stmt* statement) override;
+            void visit_var(var_stmt* statement) override;
+            void visit_block(block_stmt* statement) override;
+            void visit_if(if_stmt* statement) override;
+            void visit_while(while_stmt* statement) override;
+            void visit_function(function_stmt* statement) override;
+            void visit_return(return_stmt* statement) override;
+
+        private:
+            // both return the node that should take the place of the one passed in
+            expr* fold(expr* exp);
+            stmt* fold(stmt* statement);
+
+            // stands in for a statement that was pruned
+            stmt* empty_statement();
+
+            arena& m_arena;
+            // what the visit that just returned wants its node replaced with
+            expr* m_folded_expr = nullptr;
+            stmt* m_folded_stmt = nullptr;
+    };
+}
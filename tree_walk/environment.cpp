@@ -7,45 +7,136 @@ namespace lox
         m_enclosing = nullptr;
     }
     
-    environment::environment(std::shared_ptr<environment> enclosing)
+    environment::environment(environment* enclosing,
+        const std::vector<std::string>* slot_names)
     {
-        m_enclosing = enclosing;
+        reset(enclosing, slot_names);
+    }
+
+    void environment::define(const object& name, object value)
+    {
+        auto [entry, added] = m_global_indices.try_emplace(name, static_cast<int>(m_global_values.size()));
+        if (added) {
+            m_global_values.push_back(value);
+        }
+        else {
+            m_global_values[entry->second] = value;
+        }
+    }
+
+    int environment::global_index(const object& name) const
+    {
+        auto find_iter = m_global_indices.find(name);
+        return find_iter != m_global_indices.end() ? find_iter->second : -1;
+    }
+
+    object* environment::find(const object& name)
+    {
+        int index = global_index(name);
+        return index != -1 ? &m_global_values[index] : nullptr;
+    }
+
+    void environment::define(int slot, object value)
+    {
+        m_slots[slot] = value;
     }
 
-    void environment::define(std::string name, object value)
+    object environment::get_at(int distance, int slot)
     {
-        m_values[name] = value;
+        return ancestor(distance)->m_slots[slot];
     }
 
-    object environment::get(token name)
+    void environment::assign_at(int distance, int slot, object value)
     {
-        auto find_iter = m_values.find(name.lexeme);
-        if (find_iter != m_values.end()) {
-            return find_iter->second;
+        ancestor(distance)->m_slots[slot] = value;
+    }
+
+    object* environment::slot_address(int distance, int slot)
+    {
+        return &ancestor(distance)->m_slots[slot];
+    }
+
+    upvalue* environment::capture(collector& gc, int distance, int slot)
+    {
+        auto env = ancestor(distance);
+        for (auto& open : env->m_upvalues) {
+            if (open.first == slot) {
+                return open.second;
+            }
         }
+        auto captured = gc.make<upvalue>(&env->m_slots[slot]);
+        env->m_upvalues.push_back({slot, captured});
+        return captured;
+    }
 
-        if (m_enclosing != nullptr) {
-            return m_enclosing->get(name);
+    void environment::close_upvalues(collector& gc)
+    {
+        for (auto& open : m_upvalues) {
+            open.second->close();
+            gc.write_barrier(open.second);
         }
+        m_upvalues.clear();
+    }
 
-        throw lox_runtime_exception(name, 
-            "Undefined variable '" + name.lexeme + "'.");
+    void environment::clear()
+    {
+        for (size_t i = 0; i < m_slot_count; i++) {
+            m_slots[i] = object();
+        }
+        m_enclosing = nullptr;
     }
 
-    void environment::assign(token name, object value)
+    void environment::reset(environment* enclosing, const std::vector<std::string>* slot_names)
     {
-        auto find_iter = m_values.find(name.lexeme);
-        if (find_iter != m_values.end()) {
-            m_values[name.lexeme] = value;
-            return;
+        m_enclosing = enclosing;
+        m_slot_names = slot_names;
+        m_slot_count = slot_names->size();
+
+        // the slots are all nil already, from construction or from clear
+        if (m_slot_count <= INLINE_SLOTS) {
+            m_slots = m_inline_slots;
+        }
+        else {
+            if (m_slot_count > m_heap_capacity) {
+                m_heap_slots = std::make_unique<object[]>(m_slot_count);
+                m_heap_capacity = m_slot_count;
+            }
+            m_slots = m_heap_slots.get();
         }
+    }
 
-        if (m_enclosing != nullptr) {
-            m_enclosing->assign(name, value);
-            return;
+    const std::string& environment::slot_name(int slot) const
+    {
+        return (*m_slot_names)[slot];
+    }
+
+    void environment::trace(collector& gc)
+    {
+        for (size_t i = 0; i < m_slot_count; i++) {
+            gc.mark(m_slots[i]);
+        }
+        for (auto& value : m_global_values) {
+            gc.mark(value);
         }
+        for (auto& open : m_upvalues) {
+            gc.mark(open.second);
+        }
+        gc.mark(m_enclosing);
+    }
 
-        throw lox_runtime_exception(name,
-            "Undefined variable '" + name.lexeme + "'.");
+    size_t environment::size() const
+    {
+        // a rough figure for a map node and the entry in the table
+        return sizeof(environment) + (m_heap_slots ? m_slot_count * sizeof(object) : 0) +
+            m_global_values.size() * (sizeof(object) * 2 + sizeof(int) + sizeof(void*) * 2);
+    }
+
+    environment* environment::ancestor(int distance)
+    {
+        environment* env = this;
+        for (int i = 0; i < distance; i++) {
+            env = env->m_enclosing;
+        }
+        return env;
     }
-}
\ No newline at end of file
+}
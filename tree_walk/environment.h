@@ -2,22 +2,105 @@
 #include <string>
 #include <map>
 #include <memory>
+#include <vector>
+#include "collector.h"
 #include "token.h"
+#include "string_table.h"
 
 namespace lox
 {
-    class environment
+    // a variable captured by a closure. while its scope is running the upvalue points
+    // at the variable's slot, when the scope exits the value is moved into the upvalue
+    // itself so the closure keeps just the variables it uses rather than the scope
+    class upvalue : public traced
+    {
+        public:
+            upvalue(object* slot) : m_location(slot) {}
+
+            // storing through it needs the collector's write barrier once it's closed
+            object& get() { return *m_location; }
+
+            void close()
+            {
+                m_closed = *m_location;
+                m_location = &m_closed;
+            }
+
+            void trace(collector& gc) override
+            {
+                // while open, the variable belongs to an environment that's in use
+                gc.mark(m_closed);
+            }
+
+            size_t size() const override { return sizeof(upvalue); }
+
+        private:
+            object* m_location;
+            object m_closed;
+    };
+
+    // block scopes keep their variables in a fixed array of slots numbered by the
+    // resolver, only the global scope is keyed by name as the prompt can add to it.
+    // nothing but another environment's m_enclosing refers to one, so it's reachable
+    // just while its scope is running. the interpreter pools the ones no closure
+    // captures from rather than making them on the heap
+    class environment : public traced
     {
         public:
             environment();
-            environment(std::shared_ptr<environment> enclosing);
+            // slot_names belongs to the block being executed and is only used for debugging
+            environment(environment* enclosing,
+                        const std::vector<std::string>* slot_names);
+
+            // globals, names are interned strings. a global is given the next index in
+            // the table when it's first defined and keeps it when it's redefined, so an
+            // index stays valid for as long as the environment does
+            void define(const object& name, object value);
+            // the global's index, or -1 if it isn't defined
+            int global_index(const object& name) const;
+            object& global(int index) { return m_global_values[index]; }
+            // where the global is stored or nullptr if it isn't defined, the address is
+            // only valid until another global is defined
+            object* find(const object& name);
+
+            // locals, distance is the number of enclosing environments to skip
+            void define(int slot, object value);
+            object get_at(int distance, int slot);
+            void assign_at(int distance, int slot, object value);
+            // where the local is stored, valid for as long as its environment is
+            object* slot_address(int distance, int slot);
+            // the upvalue for a local, shared by every closure that captures it
+            upvalue* capture(collector& gc, int distance, int slot);
+            // has to be called as the scope exits, so closures keep the variables' last values
+            void close_upvalues(collector& gc);
 
-            void define(std::string name, object value);
-            object get(token name);
-            void assign(token name, object value);
+            // for recycling an environment nothing captured from. clear lets go of the
+            // values as the scope exits, and reset readies it for another scope
+            void clear();
+            void reset(environment* enclosing, const std::vector<std::string>* slot_names);
+
+            const std::string& slot_name(int slot) const;
+            environment* enclosing() const { return m_enclosing; }
+
+            void trace(collector& gc) override;
+            size_t size() const override;
 
         private:
-            std::map<std::string, object> m_values;
-            std::shared_ptr<environment> m_enclosing;
+            environment* ancestor(int distance);
+
+            // small blocks fit inline, so entering them costs a single allocation
+            static const size_t INLINE_SLOTS = 4;
+            object m_inline_slots[INLINE_SLOTS];
+            std::unique_ptr<object[]> m_heap_slots;
+            size_t m_heap_capacity = 0;
+            object* m_slots = m_inline_slots;
+            size_t m_slot_count = 0;
+            const std::vector<std::string>* m_slot_names = nullptr;
+            // the slot of each open upvalue, few scopes are captured from so a search is fine
+            std::vector<std::pair<int, upvalue*>> m_upvalues;
+
+            interned_map<int> m_global_indices;
+            std::vector<object> m_global_values;
+            environment* m_enclosing;
     };
-}
\ No newline at end of file
+}
@@ -3,7 +3,7 @@
 namespace lox
 {
     
-    assign_expr::assign_expr(token name, std::shared_ptr<expr> value)
+    assign_expr::assign_expr(token name, expr* value)
     {
         m_name = name;
         m_value = value;
@@ -14,7 +14,7 @@ namespace lox
         return visitor->visit_assign(this);
     }
     
-    binary_expr::binary_expr(std::shared_ptr<expr> left, token op, std::shared_ptr<expr> right)
+    binary_expr::binary_expr(expr* left, token op, expr* right)
     {
         m_left = left;
         m_op = op;
@@ -26,7 +26,7 @@ namespace lox
         return visitor->visit_binary(this);
     }
 
-    grouping_expr::grouping_expr(std::shared_ptr<expr> expression) {
+    grouping_expr::grouping_expr(expr* expression) {
         m_expression = expression;
     }
 
@@ -57,7 +57,7 @@ namespace lox
         return visitor->visit_variable(this);
     }
 
-    unary_expr::unary_expr(token op, std::shared_ptr<expr> right)
+    unary_expr::unary_expr(token op, expr* right)
     {
         m_op = op;
         m_right = right;
@@ -68,7 +68,7 @@ namespace lox
         return visitor->visit_unary(this);
     }
 
-    logical_expr::logical_expr(std::shared_ptr<expr> left, token op, std::shared_ptr<expr> right)
+    logical_expr::logical_expr(expr* left, token op, expr* right)
     {
         m_left = left;
         m_op = op;
@@ -80,8 +80,8 @@ namespace lox
         return visitor->visit_logical(this);
     }
 
-    call_expr::call_expr(std::shared_ptr<expr> callee, token paren,
-                std::vector<std::shared_ptr<expr>> arguments)
+    call_expr::call_expr(expr* callee, token paren,
+                node_list<expr*> arguments)
     {
         m_callee = callee;
         m_paren = paren;
@@ -1,7 +1,6 @@
 #pragma once
-#include <memory>
-#include <vector>
 #include "token.h"
+#include "arena.h"
 
 namespace lox {
 
@@ -14,6 +13,14 @@ namespace lox {
     class logical_expr;
     class call_expr;
 
+    // what type_inference could prove about the value an expression produces
+    enum class static_type : uint8_t { unknown, number, string };
+
+    // what the interpreter has specialised a node for after watching it run. each
+    // specialisation is checked by a guard, a node whose guard fails goes to generic
+    // and stays there so it can't flip back and forth
+    enum class quickened : uint8_t { uninitialised, number, string, boolean, cached, generic };
+
     class expr_visitor
     {
         public:
@@ -31,39 +38,58 @@ namespace lox {
     {
         public:
             virtual object accept(expr_visitor*) = 0;
+
+            // set by type_inference, anything it can't prove stays unknown
+            static_type m_static_type = static_type::unknown;
     };
 
     class assign_expr : public expr
     {
         public:
-            assign_expr(token name, std::shared_ptr<expr> value);
+            assign_expr(token name, expr* value);
 
             object accept(expr_visitor* visitor) override;
 
             token m_name;
-            std::shared_ptr<expr> m_value;
+            expr* m_value;
+
+            // set by the resolver, a depth of -1 means the variable is a global
+            int m_depth = -1;
+            int m_slot = -1;
+            // set by the resolver when the variable belongs to an enclosing function, it's
+            // then reached through that upvalue of the current one. depth and slot still
+            // count scopes lexically, across the function boundary
+            int m_upvalue = -1;
+
+            // the global's index in the table, cached once it has been found. globals are
+            // never removed and a redefinition keeps the index, so it's never stale
+            quickened m_quickened = quickened::uninitialised;
+            int m_global = -1;
     };
 
     class binary_expr : public expr
     {
         public:
-            binary_expr(std::shared_ptr<expr> left, token op, std::shared_ptr<expr> right);
+            binary_expr(expr* left, token op, expr* right);
 
             object accept(expr_visitor* visitor) override;
 
-            std::shared_ptr<expr> m_left;
+            expr* m_left;
             token m_op;
-            std::shared_ptr<expr> m_right;
+            expr* m_right;
+
+            // number or string once both operands have been seen to be of that type
+            quickened m_quickened = quickened::uninitialised;
     };
 
     class grouping_expr : public expr
     {
         public:
-            grouping_expr(std::shared_ptr<expr> expression);
+            grouping_expr(expr* expression);
 
             object accept(expr_visitor* visitor) override;
 
-            std::shared_ptr<expr> m_expression;
+            expr* m_expression;
     };
 
     class literal_expr : public expr
@@ -84,41 +110,66 @@ namespace lox {
             object accept(expr_visitor* visitor) override;
 
             token m_name;
+
+            // set by the resolver, a depth of -1 means the variable is a global
+            int m_depth = -1;
+            int m_slot = -1;
+            // set by the resolver when the variable belongs to an enclosing function, it's
+            // then reached through that upvalue of the current one. depth and slot still
+            // count scopes lexically, across the function boundary
+            int m_upvalue = -1;
+
+            // the global's index in the table, cached once it has been found. globals are
+            // never removed and a redefinition keeps the index, so it's never stale
+            quickened m_quickened = quickened::uninitialised;
+            int m_global = -1;
     };
 
     class unary_expr : public expr
     {
         public:
-            unary_expr(token op, std::shared_ptr<expr> right);
+            unary_expr(token op, expr* right);
 
             object accept(expr_visitor* visitor) override;
 
             token m_op;
-            std::shared_ptr<expr> m_right;
+            expr* m_right;
     };
 
     class logical_expr : public expr
     {
         public:
-            logical_expr(std::shared_ptr<expr> left, token op, std::shared_ptr<expr> right);
+            logical_expr(expr* left, token op, expr* right);
 
             object accept(expr_visitor* visitor) override;
 
-            std::shared_ptr<expr> m_left;
+            expr* m_left;
             token m_op;
-            std::shared_ptr<expr> m_right;
+            expr* m_right;
+
+            // boolean once the left operand has been seen to be a boolean
+            quickened m_quickened = quickened::uninitialised;
     };
 
     class call_expr : public expr
     {
         public:
-            call_expr(std::shared_ptr<expr> callee, token paren,
-                      std::vector<std::shared_ptr<expr>> arguments);
+            call_expr(expr* callee, token paren,
+                      node_list<expr*> arguments);
 
             object accept(expr_visitor* visitor) override;
 
-            std::shared_ptr<expr> m_callee;
+            expr* m_callee;
             token m_paren;
-            std::vector<std::shared_ptr<expr>> m_arguments;
+            node_list<expr*> m_arguments;
+
+            // cached once called, while the callee stays the same it doesn't need checking
+            quickened m_quickened = quickened::uninitialised;
+            object m_callee_cache;
+            // the collector's count of collections when it was cached
+            uint64_t m_callee_epoch = 0;
+            // set by the resolver when the call is what a return returns, so the
+            // callee can reuse the caller's place on the call stack
+            bool m_tail = false;
     };
 }
\ No newline at end of file
@@ -1,31 +1,205 @@
 #include "interpreter.h"
+#include "lox_function.h"
 #include "native_funcs.h"
 #include "tree_walk.h"
+#include <functional>
 #include <iostream>
+#include <utility>
+#include <pthread.h>
+#include <sys/resource.h>
 
 namespace lox
 {
-    interpreter::interpreter()
+    namespace
     {
-        m_globals = std::make_shared<environment>();
+        // the c++ stack a call is expected to need, so a script reaches max_frames
+        // before the stack runs out
+        constexpr size_t FRAME_STACK_BYTES = 4096;
+        // left over once calls have used their share, for evaluating the innermost
+        // call's expressions and reporting a stack overflow
+        constexpr size_t RESERVED_STACK_BYTES = 1 << 20;
+
+        // runs task on a thread with a stack of the given size and waits for it,
+        // false if there isn't the memory for the thread
+        bool run_on_stack(size_t stack_size, const std::function<void()>& task)
+        {
+            pthread_attr_t attributes;
+            pthread_attr_init(&attributes);
+            pthread_attr_setstacksize(&attributes, stack_size);
+
+            auto start = [](void* task) -> void* {
+                (*static_cast<const std::function<void()>*>(task))();
+                return nullptr;
+            };
+            pthread_t thread;
+            bool started = pthread_create(&thread, &attributes, start,
+                const_cast<std::function<void()>*>(&task)) == 0;
+            if (started) {
+                pthread_join(thread, nullptr);
+            }
+            pthread_attr_destroy(&attributes);
+            return started;
+        }
+
+        // the binary operators once both operands are known to be numbers
+        object number_operation(token_type op, double a, double b)
+        {
+            switch(op) {
+                case token_type::GREATER:
+                    return object(a > b);
+                case token_type::GREATER_EQUAL:
+                    return object(a >= b);
+                case token_type::LESS:
+                    return object(a < b);
+                case token_type::LESS_EQUAL:
+                    return object(a <= b);
+                case token_type::BANG_EQUAL:
+                    return object(a != b);
+                case token_type::EQUAL_EQUAL:
+                    return object(a == b);
+                case token_type::PLUS:
+                    return object(a + b);
+                case token_type::MINUS:
+                    return object(a - b);
+                case token_type::SLASH:
+                    return object(a / b);
+                case token_type::STAR:
+                    return object(a * b);
+                default:
+                    return object(nullptr);
+            }
+        }
+
+        // comparing strings or doing arithmetic on them is an error, only
+        // these operators can be run without the generic path's checks
+        bool is_string_operator(token_type op)
+        {
+            return op == token_type::PLUS ||
+                   op == token_type::EQUAL_EQUAL ||
+                   op == token_type::BANG_EQUAL;
+        }
+
+        // the operators is_string_operator accepts once both operands are known to be
+        // strings, which are interned so equal text is the same object
+        object string_operation(token_type op, const object& a, const object& b)
+        {
+            switch(op) {
+                case token_type::PLUS:
+                    return object(a.as_text() + b.as_text());
+                case token_type::BANG_EQUAL:
+                    return object(a.bits() != b.bits());
+                default:
+                    return object(a.bits() == b.bits());
+            }
+        }
+    }
+
+    interpreter::interpreter() : m_heap(*this)
+    {
+        m_globals = m_heap.make<environment>();
         m_environment = m_globals;
 
-        m_globals->define("clock", object(std::make_shared<clock>()));
+        for (auto& native : native_functions()) {
+            m_globals->define(object(native.first), native.second);
+        }
+    }
+
+    interpreter::~interpreter() = default;
+
+    void interpreter::set_jit(jit_mode mode)
+    {
+        m_jit = mode == jit_mode::off ? nullptr : std::make_unique<loop_jit>(mode);
+    }
+
+    void interpreter::set_max_frames(size_t frames)
+    {
+        m_max_frames = frames;
     }
 
     object interpreter::visit_assign(assign_expr* expr)
     {
-        auto value = evaluate(expr->m_value.get());
-        m_environment->assign(expr->m_name, value);
+        auto value = evaluate(expr->m_value);
+        if (failed()) {
+            return object();
+        }
+        if (expr->m_upvalue != -1) {
+            auto captured = m_function->m_upvalues[expr->m_upvalue];
+            captured->get() = value;
+            m_heap.write_barrier(captured);
+            return value;
+        }
+        if (expr->m_depth != -1) {
+            m_environment->assign_at(expr->m_depth, expr->m_slot, value);
+            return value;
+        }
+
+        if (expr->m_quickened == quickened::uninitialised) {
+            expr->m_global = m_globals->global_index(expr->m_name.value);
+            if (expr->m_global == -1) {
+                return undefined(expr->m_name);
+            }
+            expr->m_quickened = quickened::cached;
+        }
+        m_globals->global(expr->m_global) = value;
         return value;
     }
 
     object interpreter::visit_binary(binary_expr* expr)
     {
+        auto left = evaluate(expr->m_left);
+        if (failed()) {
+            return object();
+        }
+        // the right operand can make calls, which can collect
+        temporary_root keep_left(*this, left.is_collected() ? &left : nullptr);
+        auto right = evaluate(expr->m_right);
+        if (failed()) {
+            return object();
+        }
+        auto op = expr->m_op.type;
+
+        // type_inference proved the operand types, so they needn't be checked
+        auto left_type = expr->m_left->m_static_type;
+        auto right_type = expr->m_right->m_static_type;
+        if (left_type == static_type::number && right_type == static_type::number) {
+            return number_operation(op, left.as_number(), right.as_number());
+        }
+        if (left_type == static_type::string && right_type == static_type::string &&
+            is_string_operator(op)) {
+            return string_operation(op, left, right);
+        }
+
+        // otherwise specialise on the types seen the first time through
+        switch (expr->m_quickened) {
+            case quickened::number:
+                if (left.is_number() && right.is_number()) {
+                    return number_operation(op, left.as_number(), right.as_number());
+                }
+                expr->m_quickened = quickened::generic;
+                break;
+            case quickened::string:
+                if (left.is_text() && right.is_text()) {
+                    return string_operation(op, left, right);
+                }
+                expr->m_quickened = quickened::generic;
+                break;
+            case quickened::uninitialised:
+                if (left.is_number() && right.is_number()) {
+                    expr->m_quickened = quickened::number;
+                }
+                else if (left.is_text() && right.is_text() && is_string_operator(op)) {
+                    expr->m_quickened = quickened::string;
+                }
+                else {
+                    expr->m_quickened = quickened::generic;
+                }
+                break;
+            default:
+                break;
+        }
+
+        // object's operators throw on a type error, which only ever reaches this far
         try {
-            auto left = evaluate(expr->m_left.get());
-            auto right = evaluate(expr->m_right.get());
-            
             switch(expr->m_op.type) {
                 case token_type::GREATER:
                     return left > right;
@@ -56,13 +230,13 @@ namespace lox
         }
         catch (std::logic_error& e)
         {
-            throw lox_runtime_exception(expr->m_op, e.what());
+            return fail(expr->m_op, e.what());
         }
     }
 
     object interpreter::visit_grouping(grouping_expr* expr)
     {
-        return evaluate(expr->m_expression.get());
+        return evaluate(expr->m_expression);
     }
 
     object interpreter::visit_literal(literal_expr* expr)
@@ -72,132 +246,469 @@ namespace lox
 
     object interpreter::visit_variable(variable_expr* expr)
     {
-        return m_environment->get(expr->m_name);
+        if (expr->m_upvalue != -1) {
+            return m_function->m_upvalues[expr->m_upvalue]->get();
+        }
+        if (expr->m_depth != -1) {
+            return m_environment->get_at(expr->m_depth, expr->m_slot);
+        }
+
+        if (expr->m_quickened == quickened::uninitialised) {
+            expr->m_global = m_globals->global_index(expr->m_name.value);
+            if (expr->m_global == -1) {
+                return undefined(expr->m_name);
+            }
+            expr->m_quickened = quickened::cached;
+        }
+        return m_globals->global(expr->m_global);
     }
 
     object interpreter::visit_unary(unary_expr* expr)
     {
-        auto right = evaluate(expr->m_right.get());
-        switch(expr->m_op.type) {
-            case token_type::BANG:
-                return object(!right);
+        auto right = evaluate(expr->m_right);
+        if (failed()) {
+            return object();
+        }
+        if (expr->m_op.type == token_type::MINUS &&
+            expr->m_right->m_static_type == static_type::number) {
+            return object(-right.as_number());
+        }
 
-            case token_type::MINUS:
-                return -right;
+        try {
+            switch(expr->m_op.type) {
+                case token_type::BANG:
+                    return object(!right);
 
-            default:
-                return object(nullptr);
+                case token_type::MINUS:
+                    return -right;
+
+                default:
+                    return object(nullptr);
+            }
+        }
+        catch (std::logic_error& e)
+        {
+            return fail(expr->m_op, e.what());
         }
     }
 
     object interpreter::visit_logical(logical_expr* expr)
     {
-        auto left = evaluate(expr->m_left.get());
+        auto left = evaluate(expr->m_left);
+        if (failed()) {
+            return object();
+        }
 
-        if (expr->m_op.type == token_type::OR) {
-            // short circuit
-            if (left) {
-                return left;
-            }
+        // a boolean is its own truth value, anything else has to be tested
+        bool truthy;
+        if (expr->m_quickened == quickened::boolean && left.is_boolean()) {
+            truthy = left.as_boolean();
         }
         else {
-            if (not left) {
-                return left;
+            if (expr->m_quickened == quickened::uninitialised && left.is_boolean()) {
+                expr->m_quickened = quickened::boolean;
+            }
+            else {
+                expr->m_quickened = quickened::generic;
             }
+            truthy = static_cast<bool>(left);
         }
 
-        return evaluate(expr->m_right.get());
+        // short circuit
+        if (expr->m_op.type == token_type::OR ? truthy : not truthy) {
+            return left;
+        }
+
+        return evaluate(expr->m_right);
     }
 
     object interpreter::visit_call(call_expr* exp)
     {
-        auto callee = evaluate(exp->m_callee.get());
+        auto callee = evaluate(exp->m_callee);
+        if (failed()) {
+            return object();
+        }
 
         std::vector<object> arguments;
+        temporary_root keep_callee(*this, callee.is_collected() ? &callee : nullptr);
+        temporary_root keep_arguments(*this, arguments);
         for (auto argument : exp->m_arguments) {
-            arguments.push_back(evaluate(argument.get()));
+            arguments.push_back(evaluate(argument));
+            if (failed()) {
+                return object();
+            }
+        }
+
+        // the same callee as last time has already been checked, unless there's been a
+        // collection since that could have freed it and put another function at its address
+        if (exp->m_quickened == quickened::cached) {
+            if (callee.bits() != exp->m_callee_cache.bits()) {
+                exp->m_quickened = quickened::generic;
+                exp->m_callee_cache = object();
+            }
+            else if (exp->m_callee_epoch == m_heap.collections()) {
+                return invoke(exp, callee, arguments);
+            }
         }
 
-        if (callee.m_type != object::object_type::callable) {
-            throw lox_runtime_exception(exp->m_paren,
-                "Can only call functions and classes.");
+        if (not callee.is_callable()) {
+            return fail(exp->m_paren, "Can only call functions and classes.");
         }
 
-        auto func = callee.m_callable;
+        auto func = callee.as_callable();
         if (static_cast<int>(arguments.size()) != func->arity()) {
-            throw lox_runtime_exception(exp->m_paren,
+            return fail(exp->m_paren,
             "Expected " +
             std::to_string(func->arity()) +
             " arguments but got " +
             std::to_string(arguments.size()) + ".");
         }
 
-        return func->call(this, arguments);
+        // holding a reference keeps a native's address from being reused, the epoch
+        // does the same for a collected function
+        if (exp->m_quickened != quickened::generic) {
+            exp->m_callee_cache = callee;
+            exp->m_callee_epoch = m_heap.collections();
+            exp->m_quickened = quickened::cached;
+        }
+        return invoke(exp, callee, arguments);
     }
 
     void interpreter::visit_print(print_stmt* statement)
     {
-        auto value = evaluate(statement->m_expression.get());
+        auto value = evaluate(statement->m_expression);
+        if (failed()) {
+            return;
+        }
         std::cout << value.to_string() << std::endl;
     }
 
     void interpreter::visit_expression(expression_stmt* statement)
     {
-        evaluate(statement->m_expression.get());
+        evaluate(statement->m_expression);
     }
 
     void interpreter::visit_var(var_stmt* statement)
     {
         object value;
         if (statement->m_initializer) {
-            value = evaluate(statement->m_initializer.get());
+            value = evaluate(statement->m_initializer);
+            if (failed()) {
+                return;
+            }
+        }
+        if (statement->m_slot == -1) {
+            m_globals->define(statement->m_name.value, value);
+        }
+        else {
+            m_environment->define(statement->m_slot, value);
         }
-        m_environment->define(statement->m_name.lexeme, value);
     }
 
     void interpreter::visit_block(block_stmt* statement)
     {
+        // nothing is declared in it, so it runs in the enclosing scope
+        if (not statement->is_scope()) {
+            for (auto inner : statement->m_statements) {
+                if (execute(inner) != completion::normal) {
+                    break;
+                }
+            }
+            return;
+        }
+
         // local scope
-        auto block_environment = std::make_shared<environment>(m_environment);
+        auto block_environment = acquire_environment(m_environment,
+            &statement->m_slot_names, statement->m_captured);
         execute_block(statement->m_statements, block_environment);
     }
 
     void interpreter::visit_if(if_stmt* statement)
     {
-        auto condition = evaluate(statement->m_condition.get());
+        auto condition = evaluate(statement->m_condition);
+        if (failed()) {
+            return;
+        }
         // this is invoking the overloaded bool() operator in lox::object
         if (condition) {
-            execute(statement->m_then_branch.get());
+            execute(statement->m_then_branch);
         }
         else if (statement->m_else_branch) {
-            execute(statement->m_else_branch.get());
+            execute(statement->m_else_branch);
         }
     }
 
     void interpreter::visit_while(while_stmt* statement)
     {
-        while (evaluate(statement->m_condition.get())) {
-            execute(statement->m_body.get());
+        if (m_jit && m_jit->enter(statement, *m_environment, *m_globals)) {
+            return;
+        }
+        while (evaluate(statement->m_condition)) {
+            // a break or continue would be consumed here once the parser has them
+            if (execute(statement->m_body) != completion::normal) {
+                return;
+            }
+            if (m_jit && m_jit->enter(statement, *m_environment, *m_globals)) {
+                return;
+            }
         }
     }
 
     void interpreter::visit_function(function_stmt* statement)
     {
-        // todo
+        auto closure = m_heap.make<lox_function>(statement);
+        object function(closure);
+        // capturing makes upvalues, which can collect
+        temporary_root keep_function(*this, &function);
+
+        closure->m_upvalues.reserve(statement->m_upvalues.size());
+        for (auto& capture : statement->m_upvalues) {
+            if (capture.m_is_local) {
+                closure->m_upvalues.push_back(m_environment->capture(m_heap, capture.m_depth, capture.m_slot));
+            }
+            else {
+                closure->m_upvalues.push_back(m_function->m_upvalues[capture.m_index]);
+            }
+        }
+        // it may have been promoted by a collection while they were made
+        m_heap.write_barrier(closure);
+        if (statement->m_slot == -1) {
+            m_globals->define(statement->m_name.value, function);
+        }
+        else {
+            m_environment->define(statement->m_slot, function);
+        }
     }
 
-    void interpreter::interpret(std::vector<std::shared_ptr<stmt>> statements)
+    void interpreter::visit_return(return_stmt* statement)
     {
+        object value;
+        if (statement->m_value) {
+            value = evaluate(statement->m_value);
+            // failed, or the value is a tail call for the caller to make
+            if (m_completion != completion::normal) {
+                return;
+            }
+        }
+        m_return_value = value;
+        m_completion = completion::returned;
+    }
+
+    void interpreter::interpret(const std::vector<stmt*>& statements)
+    {
+        m_stack_budget = m_max_frames * FRAME_STACK_BYTES;
+        if (not run_on_stack(m_stack_budget + RESERVED_STACK_BYTES, [&]() { run(statements); })) {
+            // make do with this thread's stack, as much as the limit says it can have
+            rlimit limit;
+            getrlimit(RLIMIT_STACK, &limit);
+            if (limit.rlim_cur != RLIM_INFINITY) {
+                m_stack_budget = limit.rlim_cur > RESERVED_STACK_BYTES ?
+                    limit.rlim_cur - RESERVED_STACK_BYTES : 0;
+            }
+            run(statements);
+        }
+    }
+
+    void interpreter::run(const std::vector<stmt*>& statements)
+    {
+        char stack_base;
+        m_stack_base = &stack_base;
+
+        // only a native can still throw, the interpreter's own errors come back as a completion
         try
         {
             for (auto statement : statements) {
-                execute(statement.get());
+                if (execute(statement) == completion::error) {
+                    tree_walk::runtime_error(*m_error);
+                    break;
+                }
             }
         }
         catch(const lox_runtime_exception& e)
         {
             tree_walk::runtime_error(e);
         }
+        m_completion = completion::normal;
+        m_error.reset();
+    }
+
+    object interpreter::call(lox_function* function, const std::vector<object>& arguments)
+    {
+        frame_scope caller(*this);
+
+        // a tail call replaces the function and arguments and goes round again
+        auto parameters = &arguments;
+        while (true) {
+            auto declaration = function->m_declaration;
+            // nothing outside the function is reached through the frame, only through
+            // globals and upvalues
+            auto frame = acquire_environment(m_globals, &declaration->m_slot_names,
+                declaration->m_captured);
+            for (size_t i = 0; i < parameters->size(); i++) {
+                frame->define(static_cast<int>(i), (*parameters)[i]);
+            }
+
+            // a tail call's callee and arguments are roots until the frame is current
+            m_function = function;
+            m_environment = frame;
+            m_tail_callee = object();
+            m_tail_arguments.clear();
+
+            for (auto statement : declaration->m_body) {
+                if (execute(statement) != completion::normal) {
+                    break;
+                }
+            }
+            if (m_completion != completion::tail_call) {
+                break;
+            }
+
+            m_completion = completion::normal;
+            release_environment(m_environment);
+            function = static_cast<lox_function*>(m_tail_callee.as_callable());
+            parameters = &m_tail_arguments;
+        }
+
+        if (m_completion != completion::returned) {
+            // fell off the end, or failed and the error carries on out to the caller
+            return object();
+        }
+        m_completion = completion::normal;
+        return std::exchange(m_return_value, object());
+    }
+
+    object interpreter::invoke(call_expr* exp, const object& callee, std::vector<object>& arguments)
+    {
+        auto function = dynamic_cast<lox_function*>(callee.as_callable());
+        if (function == nullptr) {
+            // natives don't nest, so they don't need a frame
+            return callee.as_callable()->call(this, arguments);
+        }
+
+        if (exp->m_tail) {
+            m_tail_callee = callee;
+            m_tail_arguments = std::move(arguments);
+            m_completion = completion::tail_call;
+            return object();
+        }
+
+        char stack_top;
+        size_t stack_used = m_stack_base - &stack_top;
+        if (m_frames.size() >= m_max_frames || stack_used > m_stack_budget) {
+            return fail(exp->m_paren, "Stack overflow.");
+        }
+        return call(function, arguments);
+    }
+
+    environment* interpreter::acquire_environment(environment* enclosing,
+        const std::vector<std::string>* slot_names, bool captured)
+    {
+        // a closure can keep the environment's upvalues, so only the collector knows
+        // when it's done with
+        if (captured) {
+            return m_heap.make<environment>(enclosing, slot_names);
+        }
+        if (m_environment_pool.empty()) {
+            m_pooled_environments.push_back(std::make_unique<environment>(enclosing, slot_names));
+            return m_pooled_environments.back().get();
+        }
+        auto scope = m_environment_pool.back();
+        m_environment_pool.pop_back();
+        scope->reset(enclosing, slot_names);
+        return scope;
+    }
+
+    void interpreter::release_environment(environment* scope)
+    {
+        if (scope->collected()) {
+            scope->close_upvalues(m_heap);
+            return;
+        }
+        scope->clear();
+        m_environment_pool.push_back(scope);
+    }
+
+    void interpreter::trace_roots(collector& gc)
+    {
+        // every environment in use is on the chain up from the current one, or from
+        // one that a call will go back to
+        auto scan_chain = [&](environment* scope) {
+            for (; scope != nullptr && scope != m_globals; scope = scope->enclosing()) {
+                gc.scan(scope);
+            }
+        };
+        gc.scan(m_globals);
+        scan_chain(m_environment);
+        gc.mark(m_function);
+        for (auto& frame : m_frames) {
+            scan_chain(frame.m_environment);
+            gc.mark(frame.m_function);
+        }
+
+        gc.mark(m_return_value);
+        gc.mark(m_tail_callee);
+        for (auto& argument : m_tail_arguments) {
+            gc.mark(argument);
+        }
+        for (auto value : m_temporaries) {
+            gc.mark(*value);
+        }
+        for (auto values : m_temporary_lists) {
+            for (auto& value : *values) {
+                gc.mark(value);
+            }
+        }
+    }
+
+    interpreter::frame_scope::frame_scope(interpreter& interpreter) : m_interpreter(interpreter)
+    {
+        m_interpreter.m_frames.push_back({interpreter.m_function, interpreter.m_environment});
+    }
+
+    interpreter::frame_scope::~frame_scope()
+    {
+        auto& caller = m_interpreter.m_frames.back();
+        if (m_interpreter.m_environment != caller.m_environment) {
+            m_interpreter.release_environment(m_interpreter.m_environment);
+        }
+        m_interpreter.m_function = caller.m_function;
+        m_interpreter.m_environment = caller.m_environment;
+        m_interpreter.m_frames.pop_back();
+    }
+
+    interpreter::environment_scope::environment_scope(interpreter& interpreter, environment* scope) :
+        m_interpreter(interpreter), m_previous(std::exchange(interpreter.m_environment, scope))
+    {
+    }
+
+    interpreter::environment_scope::~environment_scope()
+    {
+        m_interpreter.release_environment(m_interpreter.m_environment);
+        m_interpreter.m_environment = m_previous;
+    }
+
+    interpreter::temporary_root::temporary_root(interpreter& interpreter, const object* value) :
+        m_interpreter(interpreter), m_value(value), m_list(false)
+    {
+        if (value != nullptr) {
+            m_interpreter.m_temporaries.push_back(value);
+        }
+    }
+
+    interpreter::temporary_root::temporary_root(interpreter& interpreter, const std::vector<object>& values) :
+        m_interpreter(interpreter), m_value(nullptr), m_list(true)
+    {
+        m_interpreter.m_temporary_lists.push_back(&values);
+    }
+
+    interpreter::temporary_root::~temporary_root()
+    {
+        if (m_list) {
+            m_interpreter.m_temporary_lists.pop_back();
+        }
+        else if (m_value != nullptr) {
+            m_interpreter.m_temporaries.pop_back();
+        }
     }
 
     object interpreter::evaluate(expr* expr)
@@ -205,27 +716,33 @@ namespace lox
         return expr->accept(this);
     }
 
-    void interpreter::execute(stmt* statement)
+    interpreter::completion interpreter::execute(stmt* statement)
     {
         statement->accept(this);
+        return m_completion;
+    }
+
+    interpreter::completion interpreter::execute_block(node_list<stmt*> statements,
+        environment* local_environment)
+    {
+        environment_scope scope(*this, local_environment);
+        for (auto statement : statements) {
+            if (execute(statement) != completion::normal) {
+                break;
+            }
+        }
+        return m_completion;
     }
 
-    void interpreter::execute_block(std::vector<std::shared_ptr<stmt>> statements,
-     std::shared_ptr<environment> local_environment) {
-         auto previous_environment = m_environment;
-         try {
-            m_environment = local_environment;
+    object interpreter::fail(const token& where, const std::string& message)
+    {
+        m_error.emplace(where, message);
+        m_completion = completion::error;
+        return object();
+    }
 
-            for (auto statement : statements) {
-                execute(statement.get());
-            }
-         }
-         // in Crafting Intrepeters this was a finally block which c++ doesn't have
-         catch (const std::exception& e) {
-             m_environment = previous_environment;
-            throw e;
-         }
-         
-         m_environment = previous_environment;
-     }
-}
\ No newline at end of file
+    object interpreter::undefined(const token& name)
+    {
+        return fail(name, "Undefined variable '" + std::string(name.lexeme) + "'.");
+    }
+}
@@ -1,15 +1,30 @@
 #pragma once
 #include "expr.h"
 #include "stmt.h"
+#include "collector.h"
 #include "environment.h"
+#include "jit/jit.h"
+#include <memory>
+#include <optional>
 #include <vector>
 
 namespace lox
 {
-    class interpreter : public lox::expr_visitor, lox::stmt_visitor
+    class lox_function;
+
+    class interpreter : public lox::expr_visitor, lox::stmt_visitor, public root_source
     {
         public:
             interpreter();
+            ~interpreter();
+
+            // hot while loops are handed to the jit unless mode is off
+            void set_jit(jit_mode mode);
+            // how deep calls can nest before it's a lox stack overflow. tail calls
+            // don't count, they reuse the frame of the call they return from
+            void set_max_frames(size_t frames);
+            // owns the environments, upvalues and functions of everything interpreted
+            collector& heap() { return m_heap; }
 
             object visit_assign(assign_expr* exp) override;
             object visit_binary(binary_expr* exp) override;
@@ -27,15 +42,128 @@ namespace lox
             void visit_if(if_stmt* statement) override;
             void visit_while(while_stmt* statement) override;
             void visit_function(function_stmt* statement) override;
+            void visit_return(return_stmt* statement) override;
+
+            // runs on a thread of its own, whose stack has room for max_frames calls
+            void interpret(const std::vector<stmt*>& statements);
+
+            // runs the body of a function declared in the script
+            object call(lox_function* function, const std::vector<object>& arguments);
+
+            static constexpr size_t default_max_frames = 100000;
 
-            void interpret(std::vector<std::shared_ptr<stmt>> statements);
+            // the globals, every environment in use and whatever the running
+            // statements are holding on to
+            void trace_roots(collector& gc) override;
 
         private:
-            std::shared_ptr<environment> m_globals = nullptr;
-            std::shared_ptr<environment> m_environment = nullptr;
+            // how a statement finished, anything but normal skips the rest of each
+            // enclosing block until something consumes it. a call consumes returned
+            // and interpret reports error, so neither needs the c++ unwinder
+            enum class completion : uint8_t {
+                normal,
+                returned,
+                // a return whose value is a call to a script function, which the
+                // call being returned from makes in place of itself
+                tail_call,
+                error
+            };
+
+            // what a call puts back when it returns
+            struct call_frame {
+                lox_function* m_function;
+                environment* m_environment;
+            };
+
+            // declared first, so it's the last thing to go
+            collector m_heap;
+            environment* m_globals = nullptr;
+            environment* m_environment = nullptr;
+            // every environment made for a scope no closure captures from, and the
+            // ones of those that aren't in use. they go back as soon as their scope
+            // exits, so a loop or a call reuses one instead of allocating
+            std::vector<std::unique_ptr<environment>> m_pooled_environments;
+            std::vector<environment*> m_environment_pool;
+            std::unique_ptr<loop_jit> m_jit;
+            // the function whose body is running, nullptr at the top level
+            lox_function* m_function = nullptr;
+            completion m_completion = completion::normal;
+            // set along with returned and error respectively
+            object m_return_value;
+            std::optional<lox_runtime_exception> m_error;
+            // set along with tail_call
+            object m_tail_callee;
+            std::vector<object> m_tail_arguments;
+
+            // one per script function call in progress, on the heap so their number
+            // is limited by m_max_frames rather than by the c++ stack
+            std::vector<call_frame> m_frames;
+            size_t m_max_frames = default_max_frames;
+            // where the c++ stack interpret gave the statements starts, and how much of
+            // it calls can use. they check it as well as m_max_frames, since a call's
+            // expressions can take any amount of it
+            const char* m_stack_base = nullptr;
+            size_t m_stack_budget = 0;
+            // values only held in c++ locals, which a collection mustn't free
+            std::vector<const object*> m_temporaries;
+            std::vector<const std::vector<object>*> m_temporary_lists;
+
+            void run(const std::vector<stmt*>& statements);
+            // an environment for a scope, from the pool unless a closure captures from it
+            environment* acquire_environment(environment* enclosing,
+                                             const std::vector<std::string>* slot_names, bool captured);
+            // has to be called as the scope exits, in place of closing its upvalues
+            void release_environment(environment* scope);
+            // makes a checked call, or leaves it pending if it's a tail call
+            object invoke(call_expr* exp, const object& callee, std::vector<object>& arguments);
+
+            // pushes a call_frame for the caller, and puts the caller back when it goes
+            class frame_scope
+            {
+                public:
+                    explicit frame_scope(interpreter& interpreter);
+                    ~frame_scope();
+
+                private:
+                    interpreter& m_interpreter;
+            };
+
+            // makes an environment current, and releases it and puts the previous
+            // one back when it goes
+            class environment_scope
+            {
+                public:
+                    environment_scope(interpreter& interpreter, environment* scope);
+                    ~environment_scope();
+
+                private:
+                    interpreter& m_interpreter;
+                    environment* m_previous;
+            };
+
+            // adds a temporary root for as long as it lives, a null value adds nothing
+            class temporary_root
+            {
+                public:
+                    temporary_root(interpreter& interpreter, const object* value);
+                    temporary_root(interpreter& interpreter, const std::vector<object>& values);
+                    ~temporary_root();
+
+                private:
+                    interpreter& m_interpreter;
+                    const object* m_value;
+                    bool m_list;
+            };
+
             object evaluate(expr* expr);
-            void execute(stmt* statement);
-            void execute_block(std::vector<std::shared_ptr<stmt>> statements,
-                               std::shared_ptr<environment> local_environment);
+            completion execute(stmt* statement);
+            completion execute_block(node_list<stmt*> statements,
+                                     environment* local_environment);
+
+            // an expression that fails returns nil and leaves failed() set, so every
+            // value has to be checked before it's used
+            bool failed() const { return m_completion == completion::error; }
+            object fail(const token& where, const std::string& message);
+            object undefined(const token& name);
     };
 }
\ No newline at end of file
@@ -0,0 +1,418 @@
+#include "builder.h"
+#include <algorithm>
+
+namespace lox
+{
+    namespace
+    {
+        ir_op binary_op(token_type type)
+        {
+            switch (type) {
+                case token_type::PLUS: return ir_op::ADD;
+                case token_type::MINUS: return ir_op::SUBTRACT;
+                case token_type::STAR: return ir_op::MULTIPLY;
+                case token_type::SLASH: return ir_op::DIVIDE;
+                case token_type::EQUAL_EQUAL: return ir_op::EQUAL;
+                case token_type::BANG_EQUAL: return ir_op::NOT_EQUAL;
+                case token_type::GREATER: return ir_op::GREATER;
+                case token_type::GREATER_EQUAL: return ir_op::GREATER_EQUAL;
+                case token_type::LESS: return ir_op::LESS;
+                default: return ir_op::LESS_EQUAL;
+            }
+        }
+    }
+
+    std::unique_ptr<ir_function> ir_builder::build(const std::vector<stmt*>& statements)
+    {
+        m_function = std::make_unique<ir_function>();
+        m_current = new_block();
+        seal(m_current);
+
+        for (auto statement : statements) {
+            lower(statement);
+        }
+        emit(ir_op::RETURN, 0);
+
+        remove_trivial_phis();
+        return std::move(m_function);
+    }
+
+    object ir_builder::visit_assign(assign_expr* exp)
+    {
+        auto value = lower(exp->m_value);
+        if (exp->m_depth == -1) {
+            auto store = emit(ir_op::SET_GLOBAL, exp->m_name.line, {value});
+            store->m_constant = exp->m_name.value;
+        }
+        else {
+            write_variable(local(exp->m_depth, exp->m_slot), m_current, value);
+        }
+        m_result = value;
+        return object(nullptr);
+    }
+
+    object ir_builder::visit_binary(binary_expr* exp)
+    {
+        auto left = lower(exp->m_left);
+        auto right = lower(exp->m_right);
+        m_result = emit(binary_op(exp->m_op.type), exp->m_op.line, {left, right});
+        return object(nullptr);
+    }
+
+    object ir_builder::visit_grouping(grouping_expr* exp)
+    {
+        m_result = lower(exp->m_expression);
+        return object(nullptr);
+    }
+
+    object ir_builder::visit_literal(literal_expr* exp)
+    {
+        m_result = emit_constant(exp->m_value, 0);
+        return object(nullptr);
+    }
+
+    object ir_builder::visit_variable(variable_expr* exp)
+    {
+        if (exp->m_depth == -1) {
+            m_result = emit(ir_op::GET_GLOBAL, exp->m_name.line);
+            m_result->m_constant = exp->m_name.value;
+        }
+        else {
+            m_result = read_variable(local(exp->m_depth, exp->m_slot), m_current);
+        }
+        return object(nullptr);
+    }
+
+    object ir_builder::visit_unary(unary_expr* exp)
+    {
+        auto right = lower(exp->m_right);
+        auto op = exp->m_op.type == token_type::BANG ? ir_op::NOT : ir_op::NEGATE;
+        m_result = emit(op, exp->m_op.line, {right});
+        return object(nullptr);
+    }
+
+    object ir_builder::visit_logical(logical_expr* exp)
+    {
+        auto left = lower(exp->m_left);
+        auto left_end = m_current;
+
+        auto right_block = new_block();
+        auto join = new_block();
+        if (exp->m_op.type == token_type::OR) {
+            branch(left, join, right_block);
+        }
+        else {
+            branch(left, right_block, join);
+        }
+        seal(right_block);
+
+        m_current = right_block;
+        auto right = lower(exp->m_right);
+        jump(join);
+        seal(join);
+
+        m_current = join;
+        auto phi = new_phi(join);
+        for (auto pred : join->m_predecessors) {
+            phi->m_operands.push_back(pred == left_end ? left : right);
+        }
+        m_result = phi;
+        return object(nullptr);
+    }
+
+    object ir_builder::visit_call(call_expr* exp)
+    {
+        std::vector<ir_value*> operands = {lower(exp->m_callee)};
+        for (auto argument : exp->m_arguments) {
+            operands.push_back(lower(argument));
+        }
+        m_result = emit(ir_op::CALL, exp->m_paren.line, operands);
+        return object(nullptr);
+    }
+
+    void ir_builder::visit_print(print_stmt* statement)
+    {
+        auto value = lower(statement->m_expression);
+        emit(ir_op::PRINT, 0, {value});
+    }
+
+    void ir_builder::visit_expression(expression_stmt* statement)
+    {
+        lower(statement->m_expression);
+    }
+
+    void ir_builder::visit_var(var_stmt* statement)
+    {
+        auto value = statement->m_initializer ?
+            lower(statement->m_initializer) : emit_constant(object(nullptr), 0);
+
+        if (statement->m_slot == -1) {
+            auto store = emit(ir_op::DEFINE_GLOBAL, statement->m_name.line, {value});
+            store->m_constant = statement->m_name.value;
+        }
+        else {
+            write_variable(local(0, statement->m_slot), m_current, value);
+        }
+    }
+
+    void ir_builder::visit_block(block_stmt* statement)
+    {
+        if (not statement->is_scope()) {
+            for (auto inner : statement->m_statements) {
+                lower(inner);
+            }
+            return;
+        }
+
+        // every slot starts out nil, the same as a fresh environment in the interpreter
+        std::vector<int> scope;
+        auto nil = emit_constant(object(nullptr), 0);
+        for (size_t i = 0; i < statement->m_slot_names.size(); i++) {
+            scope.push_back(m_variable_count++);
+            write_variable(scope.back(), m_current, nil);
+        }
+
+        m_scopes.push_back(scope);
+        for (auto inner : statement->m_statements) {
+            lower(inner);
+        }
+        m_scopes.pop_back();
+    }
+
+    void ir_builder::visit_if(if_stmt* statement)
+    {
+        auto condition = lower(statement->m_condition);
+
+        auto then_block = new_block();
+        auto join = new_block();
+        auto else_block = statement->m_else_branch ? new_block() : join;
+        branch(condition, then_block, else_block);
+        seal(then_block);
+
+        m_current = then_block;
+        lower(statement->m_then_branch);
+        jump(join);
+
+        if (statement->m_else_branch) {
+            seal(else_block);
+            m_current = else_block;
+            lower(statement->m_else_branch);
+            jump(join);
+        }
+
+        seal(join);
+        m_current = join;
+    }
+
+    void ir_builder::visit_while(while_stmt* statement)
+    {
+        // the block the loop is entered from ends in this jump, so it doubles as the
+        // preheader code is hoisted into
+        auto header = new_block();
+        jump(header);
+
+        m_current = header;
+        auto condition = lower(statement->m_condition);
+        auto body = new_block();
+        auto exit = new_block();
+        branch(condition, body, exit);
+        seal(body);
+
+        m_current = body;
+        lower(statement->m_body);
+        jump(header);
+
+        seal(header);
+        seal(exit);
+        m_current = exit;
+    }
+
+    void ir_builder::visit_function(function_stmt* statement)
+    {
+        // todo - only the interpreter runs functions so far, tree_walk won't hand a
+        // program declaring one to this engine, --dump-ir just leaves them out
+    }
+
+    void ir_builder::visit_return(return_stmt* statement)
+    {
+        // only allowed inside a function body
+    }
+
+    ir_value* ir_builder::lower(expr* exp)
+    {
+        exp->accept(this);
+        return m_result;
+    }
+
+    void ir_builder::lower(stmt* statement)
+    {
+        statement->accept(this);
+    }
+
+    ir_block* ir_builder::new_block()
+    {
+        auto block = m_function->new_block();
+        m_definitions.emplace_back();
+        m_sealed.push_back(false);
+        m_incomplete_phis.emplace_back();
+        return block;
+    }
+
+    ir_value* ir_builder::emit(ir_op op, int line, std::vector<ir_value*> operands)
+    {
+        auto value = m_function->new_value(op, m_current, line);
+        value->m_operands = std::move(operands);
+        m_current->m_instructions.push_back(value);
+        return value;
+    }
+
+    ir_value* ir_builder::emit_constant(const object& value, int line)
+    {
+        auto constant = emit(ir_op::CONSTANT, line);
+        constant->m_constant = value;
+        return constant;
+    }
+
+    void ir_builder::jump(ir_block* target)
+    {
+        emit(ir_op::JUMP, 0);
+        add_edge(m_current, target);
+    }
+
+    void ir_builder::branch(ir_value* condition, ir_block* if_true, ir_block* if_false)
+    {
+        emit(ir_op::BRANCH, 0, {condition});
+        add_edge(m_current, if_true);
+        add_edge(m_current, if_false);
+    }
+
+    void ir_builder::add_edge(ir_block* from, ir_block* to)
+    {
+        from->m_successors.push_back(to);
+        to->m_predecessors.push_back(from);
+    }
+
+    int ir_builder::local(int depth, int slot)
+    {
+        return m_scopes[m_scopes.size() - 1 - depth][slot];
+    }
+
+    void ir_builder::write_variable(int variable, ir_block* block, ir_value* value)
+    {
+        m_definitions[block->m_id][variable] = value;
+    }
+
+    ir_value* ir_builder::read_variable(int variable, ir_block* block)
+    {
+        auto& definitions = m_definitions[block->m_id];
+        auto find_iter = definitions.find(variable);
+        if (find_iter != definitions.end()) {
+            return find_iter->second;
+        }
+        return read_variable_recursive(variable, block);
+    }
+
+    ir_value* ir_builder::read_variable_recursive(int variable, ir_block* block)
+    {
+        ir_value* value;
+        if (not m_sealed[block->m_id]) {
+            // more predecessors are coming, fill the phi in when the block is sealed
+            value = new_phi(block);
+            m_incomplete_phis[block->m_id].push_back({variable, value});
+        }
+        else if (block->m_predecessors.size() == 1) {
+            value = read_variable(variable, block->m_predecessors.front());
+        }
+        else {
+            // written before reading so a loop back to this block finds the phi
+            value = new_phi(block);
+            write_variable(variable, block, value);
+            add_phi_operands(variable, value);
+        }
+        write_variable(variable, block, value);
+        return value;
+    }
+
+    ir_value* ir_builder::new_phi(ir_block* block)
+    {
+        auto phi = m_function->new_value(ir_op::PHI, block, 0);
+        auto position = block->m_instructions.begin();
+        while (position != block->m_instructions.end() && (*position)->m_op == ir_op::PHI) {
+            ++position;
+        }
+        block->m_instructions.insert(position, phi);
+        return phi;
+    }
+
+    void ir_builder::add_phi_operands(int variable, ir_value* phi)
+    {
+        for (auto pred : phi->m_block->m_predecessors) {
+            phi->m_operands.push_back(read_variable(variable, pred));
+        }
+    }
+
+    void ir_builder::seal(ir_block* block)
+    {
+        for (auto& incomplete : m_incomplete_phis[block->m_id]) {
+            add_phi_operands(incomplete.first, incomplete.second);
+        }
+        m_incomplete_phis[block->m_id].clear();
+        m_sealed[block->m_id] = true;
+    }
+
+    void ir_builder::remove_trivial_phis()
+    {
+        auto resolve = [this](ir_value* value) {
+            auto find_iter = m_forwarded.find(value);
+            while (find_iter != m_forwarded.end()) {
+                value = find_iter->second;
+                find_iter = m_forwarded.find(value);
+            }
+            return value;
+        };
+
+        // forwarding one phi can make another trivial, so go until nothing changes
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto block : m_function->blocks()) {
+                for (auto instruction : block->m_instructions) {
+                    if (instruction->m_op != ir_op::PHI || m_forwarded.count(instruction)) {
+                        continue;
+                    }
+
+                    ir_value* same = nullptr;
+                    bool trivial = true;
+                    for (auto operand : instruction->m_operands) {
+                        operand = resolve(operand);
+                        if (operand == same || operand == instruction) {
+                            continue;
+                        }
+                        if (same != nullptr) {
+                            trivial = false;
+                            break;
+                        }
+                        same = operand;
+                    }
+
+                    if (trivial && same != nullptr) {
+                        m_forwarded[instruction] = same;
+                        changed = true;
+                    }
+                }
+            }
+        }
+
+        for (auto block : m_function->blocks()) {
+            auto& instructions = block->m_instructions;
+            instructions.erase(std::remove_if(instructions.begin(), instructions.end(),
+                [this](ir_value* value) { return m_forwarded.count(value) != 0; }),
+                instructions.end());
+            for (auto instruction : instructions) {
+                for (auto& operand : instruction->m_operands) {
+                    operand = resolve(operand);
+                }
+            }
+        }
+    }
+}
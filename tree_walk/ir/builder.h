@@ -0,0 +1,77 @@
+#pragma once
+#include <memory>
+#include <unordered_map>
+#include <vector>
+#include "ir.h"
+#include "../expr.h"
+#include "../stmt.h"
+
+namespace lox
+{
+    // lowers a resolved program into ssa form. local variables become ssa values
+    // directly, using the on the fly construction from Braun et al., "Simple and
+    // Efficient Construction of Static Single Assignment Form"; globals stay as
+    // loads and stores by name
+    class ir_builder : public expr_visitor, stmt_visitor
+    {
+        public:
+            std::unique_ptr<ir_function> build(const std::vector<stmt*>& statements);
+
+            object visit_assign(assign_expr* exp) override;
+            object visit_binary(binary_expr* exp) override;
+            object visit_grouping(grouping_expr* exp) override;
+            object visit_literal(literal_expr* exp) override;
+            object visit_variable(variable_expr* exp) override;
+            object visit_unary(unary_expr* exp) override;
+            object visit_logical(logical_expr* exp) override;
+            object visit_call(call_expr* exp) override;
+
+            void visit_print(print_stmt* statement) override;
+            void visit_expression(expression_stmt* statement) override;
+            void visit_var(var_stmt* statement) override;
+            void visit_block(block_stmt* statement) override;
+            void visit_if(if_stmt* statement) override;
+            void visit_while(while_stmt* statement) override;
+            void visit_function(function_stmt* statement) override;
+            void visit_return(return_stmt* statement) override;
+
+        private:
+            ir_value* lower(expr* exp);
+            void lower(stmt* statement);
+
+            ir_block* new_block();
+            ir_value* emit(ir_op op, int line, std::vector<ir_value*> operands = {});
+            ir_value* emit_constant(const object& value, int line);
+            void jump(ir_block* target);
+            void branch(ir_value* condition, ir_block* if_true, ir_block* if_false);
+            void add_edge(ir_block* from, ir_block* to);
+
+            int local(int depth, int slot);
+
+            void write_variable(int variable, ir_block* block, ir_value* value);
+            ir_value* read_variable(int variable, ir_block* block);
+            ir_value* read_variable_recursive(int variable, ir_block* block);
+            ir_value* new_phi(ir_block* block);
+            void add_phi_operands(int variable, ir_value* phi);
+            // no more predecessors will be added to block
+            void seal(ir_block* block);
+            // forwards phis whose operands are all the same value to that value
+            void remove_trivial_phis();
+
+            std::unique_ptr<ir_function> m_function;
+            ir_block* m_current = nullptr;
+            ir_value* m_result = nullptr;
+
+            // variable ids by slot, one list per scope, innermost last
+            std::vector<std::vector<int>> m_scopes;
+            int m_variable_count = 0;
+
+            // per block id: the value each variable has at the end of the block so far
+            std::vector<std::unordered_map<int, ir_value*>> m_definitions;
+            std::vector<bool> m_sealed;
+            // per block id: phis made before the block was sealed, still without operands
+            std::vector<std::vector<std::pair<int, ir_value*>>> m_incomplete_phis;
+            // a phi that turned out to be trivial maps to the value it stands for
+            std::unordered_map<ir_value*, ir_value*> m_forwarded;
+    };
+}
@@ -0,0 +1,208 @@
+#include "ir.h"
+#include <algorithm>
+
+namespace lox
+{
+    ir_block* ir_function::new_block()
+    {
+        m_block_storage.push_back(std::make_unique<ir_block>());
+        auto block = m_block_storage.back().get();
+        block->m_id = static_cast<int>(m_blocks.size());
+        m_blocks.push_back(block);
+        return block;
+    }
+
+    ir_value* ir_function::new_value(ir_op op, ir_block* block, int line)
+    {
+        m_values.push_back(std::make_unique<ir_value>());
+        auto value = m_values.back().get();
+        value->m_op = op;
+        value->m_id = static_cast<int>(m_values.size()) - 1;
+        value->m_line = line;
+        value->m_block = block;
+        return value;
+    }
+
+    void ir_function::remove_edge(ir_block* from, ir_block* to)
+    {
+        auto pred = std::find(to->m_predecessors.begin(), to->m_predecessors.end(), from);
+        size_t index = pred - to->m_predecessors.begin();
+        to->m_predecessors.erase(pred);
+        for (auto instruction : to->m_instructions) {
+            if (instruction->m_op == ir_op::PHI) {
+                instruction->m_operands.erase(instruction->m_operands.begin() + index);
+            }
+        }
+
+        auto succ = std::find(from->m_successors.begin(), from->m_successors.end(), to);
+        from->m_successors.erase(succ);
+    }
+
+    void ir_function::remove_unreachable()
+    {
+        std::vector<bool> reachable(m_blocks.size(), false);
+        std::vector<ir_block*> work = {entry()};
+        reachable[entry()->m_id] = true;
+        while (not work.empty()) {
+            auto block = work.back();
+            work.pop_back();
+            for (auto succ : block->m_successors) {
+                if (not reachable[succ->m_id]) {
+                    reachable[succ->m_id] = true;
+                    work.push_back(succ);
+                }
+            }
+        }
+
+        std::vector<ir_block*> kept;
+        for (auto block : m_blocks) {
+            if (reachable[block->m_id]) {
+                kept.push_back(block);
+                continue;
+            }
+            while (not block->m_successors.empty()) {
+                remove_edge(block, block->m_successors.back());
+            }
+        }
+
+        m_blocks = kept;
+        for (size_t i = 0; i < m_blocks.size(); i++) {
+            m_blocks[i]->m_id = static_cast<int>(i);
+        }
+    }
+
+    void ir_function::dump(std::ostream& out) const
+    {
+        for (auto block : m_blocks) {
+            out << "block " << block->m_id << ":";
+            if (not block->m_predecessors.empty()) {
+                out << " ; preds";
+                for (auto pred : block->m_predecessors) {
+                    out << " " << pred->m_id;
+                }
+            }
+            out << std::endl;
+
+            for (auto instruction : block->m_instructions) {
+                out << "    ";
+                switch (instruction->m_op) {
+                    case ir_op::DEFINE_GLOBAL:
+                    case ir_op::SET_GLOBAL:
+                    case ir_op::PRINT:
+                    case ir_op::JUMP:
+                    case ir_op::BRANCH:
+                    case ir_op::RETURN:
+                        break;
+                    default:
+                        out << "v" << instruction->m_id << " = ";
+                        break;
+                }
+                out << op_name(instruction->m_op);
+
+                const char* separator = " ";
+                if (instruction->m_op == ir_op::CONSTANT) {
+                    out << separator << (instruction->m_constant.is_text() ?
+                        "\"" + instruction->m_constant.to_string() + "\"" :
+                        instruction->m_constant.to_string());
+                    separator = ", ";
+                }
+                if (instruction->m_op == ir_op::GET_GLOBAL ||
+                    instruction->m_op == ir_op::DEFINE_GLOBAL ||
+                    instruction->m_op == ir_op::SET_GLOBAL) {
+                    out << separator << instruction->m_constant.to_string();
+                    separator = ", ";
+                }
+                for (size_t i = 0; i < instruction->m_operands.size(); i++) {
+                    out << separator << "v" << instruction->m_operands[i]->m_id;
+                    if (instruction->m_op == ir_op::PHI) {
+                        out << " from " << block->m_predecessors[i]->m_id;
+                    }
+                    separator = ", ";
+                }
+                for (auto succ : block->m_successors) {
+                    if (instruction == block->terminator()) {
+                        out << separator << "block " << succ->m_id;
+                        separator = ", ";
+                    }
+                }
+                out << std::endl;
+            }
+        }
+    }
+
+    bool is_terminator(ir_op op)
+    {
+        return op == ir_op::JUMP || op == ir_op::BRANCH || op == ir_op::RETURN;
+    }
+
+    bool is_pure(ir_op op)
+    {
+        switch (op) {
+            case ir_op::CONSTANT:
+            case ir_op::PHI:
+            case ir_op::ADD:
+            case ir_op::SUBTRACT:
+            case ir_op::MULTIPLY:
+            case ir_op::DIVIDE:
+            case ir_op::EQUAL:
+            case ir_op::NOT_EQUAL:
+            case ir_op::GREATER:
+            case ir_op::GREATER_EQUAL:
+            case ir_op::LESS:
+            case ir_op::LESS_EQUAL:
+            case ir_op::NEGATE:
+            case ir_op::NOT:
+                return true;
+            default:
+                return false;
+        }
+    }
+
+    object evaluate_operator(ir_op op, const object& a, const object& b)
+    {
+        switch (op) {
+            case ir_op::ADD: return a + b;
+            case ir_op::SUBTRACT: return a - b;
+            case ir_op::MULTIPLY: return a * b;
+            case ir_op::DIVIDE: return a / b;
+            case ir_op::EQUAL: return a == b;
+            case ir_op::NOT_EQUAL: return a != b;
+            case ir_op::GREATER: return a > b;
+            case ir_op::GREATER_EQUAL: return a >= b;
+            case ir_op::LESS: return a < b;
+            case ir_op::LESS_EQUAL: return a <= b;
+            case ir_op::NEGATE: return -a;
+            case ir_op::NOT: return !a;
+            default: return object(nullptr);
+        }
+    }
+
+    const char* op_name(ir_op op)
+    {
+        switch (op) {
+            case ir_op::CONSTANT: return "const";
+            case ir_op::PHI: return "phi";
+            case ir_op::GET_GLOBAL: return "get_global";
+            case ir_op::DEFINE_GLOBAL: return "define_global";
+            case ir_op::SET_GLOBAL: return "set_global";
+            case ir_op::ADD: return "add";
+            case ir_op::SUBTRACT: return "sub";
+            case ir_op::MULTIPLY: return "mul";
+            case ir_op::DIVIDE: return "div";
+            case ir_op::EQUAL: return "eq";
+            case ir_op::NOT_EQUAL: return "ne";
+            case ir_op::GREATER: return "gt";
+            case ir_op::GREATER_EQUAL: return "ge";
+            case ir_op::LESS: return "lt";
+            case ir_op::LESS_EQUAL: return "le";
+            case ir_op::NEGATE: return "neg";
+            case ir_op::NOT: return "not";
+            case ir_op::CALL: return "call";
+            case ir_op::PRINT: return "print";
+            case ir_op::JUMP: return "jump";
+            case ir_op::BRANCH: return "branch";
+            case ir_op::RETURN: return "return";
+        }
+        return "?";
+    }
+}
@@ -0,0 +1,88 @@
+#pragma once
+#include <memory>
+#include <ostream>
+#include <vector>
+#include "../token.h"
+
+namespace lox
+{
+    enum class ir_op : uint8_t {
+        CONSTANT,
+        // one operand per predecessor of its block, in the same order
+        PHI,
+        // the global's interned name is held in m_constant
+        GET_GLOBAL, DEFINE_GLOBAL, SET_GLOBAL,
+        ADD, SUBTRACT, MULTIPLY, DIVIDE,
+        EQUAL, NOT_EQUAL, GREATER, GREATER_EQUAL, LESS, LESS_EQUAL,
+        NEGATE, NOT,
+        // callee first, then the arguments
+        CALL,
+        PRINT,
+        // terminators, the targets are the block's successors
+        JUMP, BRANCH, RETURN
+    };
+
+    struct ir_block;
+
+    // an instruction, and the ssa value it defines if it has one
+    struct ir_value
+    {
+        ir_op m_op;
+        // dense numbering used for register slots and by the dump
+        int m_id;
+        std::vector<ir_value*> m_operands;
+        // the value of a CONSTANT, the name of a global
+        object m_constant;
+        // runtime errors raised by this instruction are reported on this line
+        int m_line = 0;
+        ir_block* m_block = nullptr;
+    };
+
+    struct ir_block
+    {
+        int m_id;
+        // phis first, exactly one terminator last
+        std::vector<ir_value*> m_instructions;
+        std::vector<ir_block*> m_predecessors;
+        // a BRANCH goes to the first successor when its condition is truthy
+        std::vector<ir_block*> m_successors;
+
+        ir_value* terminator() const { return m_instructions.back(); }
+    };
+
+    // a whole program in ssa form. owns every block and value, dead ones included,
+    // so passes can drop them from the graph without worrying about who frees them
+    class ir_function
+    {
+        public:
+            ir_block* new_block();
+            ir_value* new_value(ir_op op, ir_block* block, int line);
+
+            // unlinks the edge and drops the matching operand from the target's phis
+            void remove_edge(ir_block* from, ir_block* to);
+            // drops blocks that are no longer reachable from the entry and renumbers
+            // what's left
+            void remove_unreachable();
+
+            ir_block* entry() const { return m_blocks.front(); }
+            const std::vector<ir_block*>& blocks() const { return m_blocks; }
+            // one past the largest value id, the size of the register file
+            int value_count() const { return static_cast<int>(m_values.size()); }
+
+            void dump(std::ostream& out) const;
+
+        private:
+            std::vector<ir_block*> m_blocks;
+            std::vector<std::unique_ptr<ir_block>> m_block_storage;
+            std::vector<std::unique_ptr<ir_value>> m_values;
+    };
+
+    bool is_terminator(ir_op op);
+    // no side effects, its result only depends on its operands
+    bool is_pure(ir_op op);
+    const char* op_name(ir_op op);
+
+    // the arithmetic, comparison and unary ops on already evaluated operands (b is
+    // ignored for the unary ones). throws std::logic_error like the object operators
+    object evaluate_operator(ir_op op, const object& a, const object& b);
+}
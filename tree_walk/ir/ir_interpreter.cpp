@@ -0,0 +1,135 @@
+#include "ir_interpreter.h"
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include "../lox_callable.h"
+#include "../native_funcs.h"
+#include "../tree_walk.h"
+
+namespace lox
+{
+    ir_interpreter::ir_interpreter()
+    {
+        for (auto& native : native_functions()) {
+            m_globals[object(native.first)] = native.second;
+        }
+    }
+
+    void ir_interpreter::interpret(const ir_function& function)
+    {
+        m_registers.assign(function.value_count(), object(nullptr));
+
+        try {
+            const ir_block* block = function.entry();
+            while (true) {
+                const ir_block* next = nullptr;
+                for (auto instruction : block->m_instructions) {
+                    auto& result = m_registers[instruction->m_id];
+                    auto operand = [this, instruction](size_t index) -> const object& {
+                        return m_registers[instruction->m_operands[index]->m_id];
+                    };
+
+                    switch (instruction->m_op) {
+                        case ir_op::CONSTANT:
+                            result = instruction->m_constant;
+                            break;
+                        case ir_op::PHI:
+                            // filled in when the edge into the block was taken
+                            break;
+
+                        case ir_op::GET_GLOBAL: {
+                            auto find_iter = m_globals.find(instruction->m_constant);
+                            if (find_iter == m_globals.end()) {
+                                runtime_error(instruction,
+                                    "Undefined variable '" + instruction->m_constant.as_text() + "'.");
+                            }
+                            result = find_iter->second;
+                            break;
+                        }
+                        case ir_op::DEFINE_GLOBAL:
+                            m_globals[instruction->m_constant] = operand(0);
+                            break;
+                        case ir_op::SET_GLOBAL: {
+                            auto find_iter = m_globals.find(instruction->m_constant);
+                            if (find_iter == m_globals.end()) {
+                                runtime_error(instruction,
+                                    "Undefined variable '" + instruction->m_constant.as_text() + "'.");
+                            }
+                            find_iter->second = operand(0);
+                            break;
+                        }
+
+                        case ir_op::CALL: {
+                            auto& callee = operand(0);
+                            std::vector<object> arguments;
+                            for (size_t i = 1; i < instruction->m_operands.size(); i++) {
+                                arguments.push_back(operand(i));
+                            }
+
+                            if (not callee.is_callable()) {
+                                runtime_error(instruction, "Can only call functions and classes.");
+                            }
+                            auto func = callee.as_callable();
+                            if (static_cast<int>(arguments.size()) != func->arity()) {
+                                runtime_error(instruction, "Expected " + std::to_string(func->arity()) +
+                                    " arguments but got " + std::to_string(arguments.size()) + ".");
+                            }
+                            result = func->call(nullptr, arguments);
+                            break;
+                        }
+
+                        case ir_op::PRINT:
+                            std::cout << operand(0).to_string() << std::endl;
+                            break;
+
+                        case ir_op::JUMP:
+                            next = block->m_successors[0];
+                            break;
+                        case ir_op::BRANCH:
+                            next = block->m_successors[operand(0) ? 0 : 1];
+                            break;
+                        case ir_op::RETURN:
+                            return;
+
+                        default:
+                            try {
+                                auto& left = operand(0);
+                                auto& right = instruction->m_operands.size() > 1 ? operand(1) : left;
+                                result = evaluate_operator(instruction->m_op, left, right);
+                            }
+                            catch (const std::logic_error& e) {
+                                runtime_error(instruction, e.what());
+                            }
+                            break;
+                    }
+                }
+
+                // every phi reads the values from before any of them is written
+                size_t edge = std::find(next->m_predecessors.begin(), next->m_predecessors.end(), block) -
+                    next->m_predecessors.begin();
+                m_phi_values.clear();
+                for (auto instruction : next->m_instructions) {
+                    if (instruction->m_op != ir_op::PHI) {
+                        break;
+                    }
+                    m_phi_values.push_back(m_registers[instruction->m_operands[edge]->m_id]);
+                }
+                for (size_t i = 0; i < m_phi_values.size(); i++) {
+                    m_registers[next->m_instructions[i]->m_id] = std::move(m_phi_values[i]);
+                }
+                block = next;
+            }
+        }
+        catch (const lox_runtime_exception& e) {
+            tree_walk::runtime_error(e);
+        }
+    }
+
+    void ir_interpreter::runtime_error(const ir_value* instruction, std::string message)
+    {
+        token where;
+        where.type = token_type::END_OF_FILE;
+        where.line = instruction->m_line;
+        throw lox_runtime_exception(where, message);
+    }
+}
@@ -0,0 +1,26 @@
+#pragma once
+#include <string>
+#include <vector>
+#include "ir.h"
+#include "../string_table.h"
+
+namespace lox
+{
+    // executes ssa form directly, every value gets its own register. globals persist
+    // between calls to interpret so it can back the interactive prompt
+    class ir_interpreter
+    {
+        public:
+            ir_interpreter();
+
+            void interpret(const ir_function& function);
+
+        private:
+            [[noreturn]] void runtime_error(const ir_value* instruction, std::string message);
+
+            std::vector<object> m_registers;
+            // holds phi results while they are copied in, they all read the old values
+            std::vector<object> m_phi_values;
+            interned_map<object> m_globals;
+    };
+}
@@ -0,0 +1,811 @@
+#include "passes.h"
+#include <algorithm>
+#include <chrono>
+#include <iomanip>
+#include <stdexcept>
+#include <unordered_map>
+#include <unordered_set>
+
+namespace lox
+{
+    namespace
+    {
+        using replacement_map = std::unordered_map<ir_value*, ir_value*>;
+
+        ir_value* resolve(const replacement_map& replacements, ir_value* value)
+        {
+            auto find_iter = replacements.find(value);
+            while (find_iter != replacements.end()) {
+                value = find_iter->second;
+                find_iter = replacements.find(value);
+            }
+            return value;
+        }
+
+        // rewrites every operand through replacements and drops the replaced instructions
+        void apply_replacements(ir_function& function, const replacement_map& replacements)
+        {
+            if (replacements.empty()) {
+                return;
+            }
+
+            for (auto block : function.blocks()) {
+                auto& instructions = block->m_instructions;
+                instructions.erase(std::remove_if(instructions.begin(), instructions.end(),
+                    [&replacements](ir_value* value) { return replacements.count(value) != 0; }),
+                    instructions.end());
+                for (auto instruction : instructions) {
+                    for (auto& operand : instruction->m_operands) {
+                        operand = resolve(replacements, operand);
+                    }
+                }
+            }
+        }
+
+        std::vector<std::vector<ir_value*>> find_users(const ir_function& function)
+        {
+            std::vector<std::vector<ir_value*>> users(function.value_count());
+            for (auto block : function.blocks()) {
+                for (auto instruction : block->m_instructions) {
+                    for (auto operand : instruction->m_operands) {
+                        users[operand->m_id].push_back(instruction);
+                    }
+                }
+            }
+            return users;
+        }
+
+        std::vector<ir_block*> reverse_postorder(const ir_function& function)
+        {
+            std::vector<ir_block*> order;
+            std::vector<bool> visited(function.blocks().size(), false);
+            // explicit stack, generated scripts can nest far deeper than the native stack
+            std::vector<std::pair<ir_block*, size_t>> stack = {{function.entry(), 0}};
+            visited[function.entry()->m_id] = true;
+            while (not stack.empty()) {
+                auto& top = stack.back();
+                if (top.second < top.first->m_successors.size()) {
+                    auto succ = top.first->m_successors[top.second++];
+                    if (not visited[succ->m_id]) {
+                        visited[succ->m_id] = true;
+                        stack.push_back({succ, 0});
+                    }
+                    continue;
+                }
+                order.push_back(top.first);
+                stack.pop_back();
+            }
+            std::reverse(order.begin(), order.end());
+            return order;
+        }
+
+        // immediate dominator of each block by id, from Cooper, Harvey and Kennedy,
+        // "A Simple, Fast Dominance Algorithm". the entry is its own dominator
+        std::vector<ir_block*> dominators(const ir_function& function, const std::vector<ir_block*>& order)
+        {
+            std::vector<int> position(function.blocks().size(), -1);
+            for (size_t i = 0; i < order.size(); i++) {
+                position[order[i]->m_id] = static_cast<int>(i);
+            }
+
+            std::vector<ir_block*> idom(function.blocks().size(), nullptr);
+            idom[function.entry()->m_id] = function.entry();
+
+            auto intersect = [&](ir_block* a, ir_block* b) {
+                while (a != b) {
+                    while (position[a->m_id] > position[b->m_id]) {
+                        a = idom[a->m_id];
+                    }
+                    while (position[b->m_id] > position[a->m_id]) {
+                        b = idom[b->m_id];
+                    }
+                }
+                return a;
+            };
+
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (size_t i = 1; i < order.size(); i++) {
+                    auto block = order[i];
+                    ir_block* new_idom = nullptr;
+                    for (auto pred : block->m_predecessors) {
+                        if (idom[pred->m_id] == nullptr) {
+                            continue;
+                        }
+                        new_idom = new_idom ? intersect(pred, new_idom) : pred;
+                    }
+                    if (idom[block->m_id] != new_idom) {
+                        idom[block->m_id] = new_idom;
+                        changed = true;
+                    }
+                }
+            }
+            return idom;
+        }
+
+        bool dominates(const std::vector<ir_block*>& idom, ir_block* a, ir_block* b)
+        {
+            while (true) {
+                if (a == b) {
+                    return true;
+                }
+                auto up = idom[b->m_id];
+                if (up == b) {
+                    return false;
+                }
+                b = up;
+            }
+        }
+
+        // the types a value can have when it is computed without an error
+        enum type_bits : uint8_t {
+            NIL_TYPE = 1 << 0,
+            BOOLEAN_TYPE = 1 << 1,
+            NUMBER_TYPE = 1 << 2,
+            TEXT_TYPE = 1 << 3,
+            CALLABLE_TYPE = 1 << 4,
+            ANY_TYPE = 0x1f
+        };
+
+        uint8_t type_of(const object& value)
+        {
+            switch (value.type()) {
+                case object::object_type::nil: return NIL_TYPE;
+                case object::object_type::boolean: return BOOLEAN_TYPE;
+                case object::object_type::number: return NUMBER_TYPE;
+                case object::object_type::text: return TEXT_TYPE;
+                default: return CALLABLE_TYPE;
+            }
+        }
+
+        std::vector<uint8_t> infer_types(const ir_function& function)
+        {
+            // starts from nothing and only ever adds types, so loops through phis settle
+            std::vector<uint8_t> types(function.value_count(), 0);
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (auto block : function.blocks()) {
+                    for (auto instruction : block->m_instructions) {
+                        uint8_t type = 0;
+                        switch (instruction->m_op) {
+                            case ir_op::CONSTANT:
+                                type = type_of(instruction->m_constant);
+                                break;
+                            case ir_op::PHI:
+                                for (auto operand : instruction->m_operands) {
+                                    type |= types[operand->m_id];
+                                }
+                                break;
+                            case ir_op::ADD: {
+                                uint8_t left = types[instruction->m_operands[0]->m_id];
+                                uint8_t right = types[instruction->m_operands[1]->m_id];
+                                type = (left | right) & (NUMBER_TYPE | TEXT_TYPE);
+                                break;
+                            }
+                            case ir_op::SUBTRACT:
+                            case ir_op::MULTIPLY:
+                            case ir_op::DIVIDE:
+                            case ir_op::NEGATE:
+                                type = NUMBER_TYPE;
+                                break;
+                            case ir_op::EQUAL:
+                            case ir_op::NOT_EQUAL:
+                            case ir_op::GREATER:
+                            case ir_op::GREATER_EQUAL:
+                            case ir_op::LESS:
+                            case ir_op::LESS_EQUAL:
+                            case ir_op::NOT:
+                                type = BOOLEAN_TYPE;
+                                break;
+                            case ir_op::GET_GLOBAL:
+                            case ir_op::CALL:
+                                type = ANY_TYPE;
+                                break;
+                            default:
+                                break;
+                        }
+                        if ((types[instruction->m_id] | type) != types[instruction->m_id]) {
+                            types[instruction->m_id] |= type;
+                            changed = true;
+                        }
+                    }
+                }
+            }
+            return types;
+        }
+
+        bool only(uint8_t type, uint8_t allowed)
+        {
+            return type != 0 && (type & ~allowed) == 0;
+        }
+
+        bool can_throw(const ir_value* value, const std::vector<uint8_t>& types)
+        {
+            auto operand_type = [&](size_t index) {
+                return types[value->m_operands[index]->m_id];
+            };
+
+            switch (value->m_op) {
+                case ir_op::CONSTANT:
+                case ir_op::PHI:
+                case ir_op::EQUAL:
+                case ir_op::NOT_EQUAL:
+                case ir_op::NOT:
+                case ir_op::DEFINE_GLOBAL:
+                case ir_op::PRINT:
+                case ir_op::JUMP:
+                case ir_op::BRANCH:
+                case ir_op::RETURN:
+                    return false;
+                case ir_op::ADD:
+                    return not ((only(operand_type(0), NUMBER_TYPE) && only(operand_type(1), NUMBER_TYPE)) ||
+                                (only(operand_type(0), TEXT_TYPE) && only(operand_type(1), TEXT_TYPE)));
+                case ir_op::SUBTRACT:
+                case ir_op::MULTIPLY:
+                case ir_op::DIVIDE:
+                case ir_op::GREATER:
+                case ir_op::GREATER_EQUAL:
+                case ir_op::LESS:
+                case ir_op::LESS_EQUAL:
+                    return not (only(operand_type(0), NUMBER_TYPE) && only(operand_type(1), NUMBER_TYPE));
+                case ir_op::NEGATE:
+                    return not only(operand_type(0), NUMBER_TYPE);
+                default:
+                    return true;
+            }
+        }
+
+        // block ids can change between passes, so everything is recomputed per pass
+        struct lattice {
+            enum { UNDEFINED, CONSTANT, OVERDEFINED } state = UNDEFINED;
+            object value;
+        };
+    }
+
+    void propagate_constants(ir_function& function)
+    {
+        auto users = find_users(function);
+        std::vector<lattice> cells(function.value_count());
+        std::vector<bool> reachable(function.blocks().size(), false);
+        // executable edges, by block id and successor index
+        std::vector<std::vector<bool>> executable(function.blocks().size());
+        for (auto block : function.blocks()) {
+            executable[block->m_id].assign(block->m_successors.size(), false);
+        }
+
+        std::vector<std::pair<ir_block*, size_t>> flow_work;
+        std::vector<ir_value*> value_work;
+
+        auto set_cell = [&](ir_value* value, const lattice& cell) {
+            auto& current = cells[value->m_id];
+            if (current.state == cell.state &&
+                (cell.state != lattice::CONSTANT || current.value.bits() == cell.value.bits())) {
+                return;
+            }
+            current = cell;
+            for (auto user : users[value->m_id]) {
+                value_work.push_back(user);
+            }
+        };
+
+        auto visit = [&](ir_value* value) {
+            auto block = value->m_block;
+            switch (value->m_op) {
+                case ir_op::CONSTANT:
+                    set_cell(value, {lattice::CONSTANT, value->m_constant});
+                    return;
+
+                case ir_op::PHI: {
+                    lattice result;
+                    for (size_t i = 0; i < value->m_operands.size(); i++) {
+                        auto pred = block->m_predecessors[i];
+                        auto edge = std::find(pred->m_successors.begin(), pred->m_successors.end(), block);
+                        if (not executable[pred->m_id][edge - pred->m_successors.begin()]) {
+                            continue;
+                        }
+                        auto& operand = cells[value->m_operands[i]->m_id];
+                        if (operand.state == lattice::UNDEFINED) {
+                            continue;
+                        }
+                        if (operand.state == lattice::OVERDEFINED ||
+                            (result.state == lattice::CONSTANT && result.value.bits() != operand.value.bits())) {
+                            result.state = lattice::OVERDEFINED;
+                            break;
+                        }
+                        result = operand;
+                    }
+                    set_cell(value, result);
+                    return;
+                }
+
+                case ir_op::JUMP:
+                    flow_work.push_back({block, 0});
+                    return;
+
+                case ir_op::BRANCH: {
+                    auto& condition = cells[value->m_operands[0]->m_id];
+                    if (condition.state == lattice::CONSTANT) {
+                        flow_work.push_back({block, condition.value ? 0u : 1u});
+                    }
+                    else if (condition.state == lattice::OVERDEFINED) {
+                        flow_work.push_back({block, 0});
+                        flow_work.push_back({block, 1});
+                    }
+                    return;
+                }
+
+                case ir_op::RETURN:
+                case ir_op::PRINT:
+                case ir_op::DEFINE_GLOBAL:
+                case ir_op::SET_GLOBAL:
+                    return;
+
+                case ir_op::GET_GLOBAL:
+                case ir_op::CALL:
+                    set_cell(value, {lattice::OVERDEFINED, object()});
+                    return;
+
+                default:
+                    break;
+            }
+
+            // an operator, constant only if every operand is and it doesn't throw
+            for (auto operand : value->m_operands) {
+                auto state = cells[operand->m_id].state;
+                if (state == lattice::OVERDEFINED) {
+                    set_cell(value, {lattice::OVERDEFINED, object()});
+                    return;
+                }
+                if (state == lattice::UNDEFINED) {
+                    return;
+                }
+            }
+            try {
+                auto& left = cells[value->m_operands[0]->m_id].value;
+                auto& right = value->m_operands.size() > 1 ? cells[value->m_operands[1]->m_id].value : left;
+                set_cell(value, {lattice::CONSTANT, evaluate_operator(value->m_op, left, right)});
+            }
+            catch (const std::logic_error&) {
+                // it will fail at runtime and has to stay to report that
+                set_cell(value, {lattice::OVERDEFINED, object()});
+            }
+        };
+
+        reachable[function.entry()->m_id] = true;
+        for (auto instruction : function.entry()->m_instructions) {
+            visit(instruction);
+        }
+
+        while (not flow_work.empty() || not value_work.empty()) {
+            while (not flow_work.empty()) {
+                auto edge = flow_work.back();
+                flow_work.pop_back();
+                auto from = edge.first;
+                if (executable[from->m_id][edge.second]) {
+                    continue;
+                }
+                executable[from->m_id][edge.second] = true;
+
+                auto to = from->m_successors[edge.second];
+                if (not reachable[to->m_id]) {
+                    reachable[to->m_id] = true;
+                    for (auto instruction : to->m_instructions) {
+                        visit(instruction);
+                    }
+                }
+                else {
+                    for (auto instruction : to->m_instructions) {
+                        if (instruction->m_op == ir_op::PHI) {
+                            visit(instruction);
+                        }
+                    }
+                }
+            }
+
+            while (not value_work.empty()) {
+                auto value = value_work.back();
+                value_work.pop_back();
+                if (reachable[value->m_block->m_id]) {
+                    visit(value);
+                }
+            }
+        }
+
+        for (auto block : function.blocks()) {
+            if (not reachable[block->m_id]) {
+                continue;
+            }
+
+            for (auto instruction : block->m_instructions) {
+                auto& cell = cells[instruction->m_id];
+                if (cell.state == lattice::CONSTANT && instruction->m_op != ir_op::CONSTANT &&
+                    is_pure(instruction->m_op)) {
+                    instruction->m_op = ir_op::CONSTANT;
+                    instruction->m_operands.clear();
+                    instruction->m_constant = cell.value;
+                }
+            }
+            // phis that became constants have to move out of the phi section
+            std::stable_partition(block->m_instructions.begin(), block->m_instructions.end(),
+                [](ir_value* value) { return value->m_op == ir_op::PHI; });
+
+            auto terminator = block->terminator();
+            if (terminator->m_op == ir_op::BRANCH) {
+                auto& condition = cells[terminator->m_operands[0]->m_id];
+                if (condition.state == lattice::CONSTANT) {
+                    auto dead = block->m_successors[condition.value ? 1 : 0];
+                    terminator->m_op = ir_op::JUMP;
+                    terminator->m_operands.clear();
+                    function.remove_edge(block, dead);
+                }
+            }
+        }
+        function.remove_unreachable();
+
+        // joins that lost a predecessor may be left with phis that pick a single value
+        replacement_map replacements;
+        for (auto block : function.blocks()) {
+            for (auto instruction : block->m_instructions) {
+                if (instruction->m_op != ir_op::PHI || instruction->m_operands.empty()) {
+                    continue;
+                }
+                auto first = resolve(replacements, instruction->m_operands.front());
+                bool same = std::all_of(instruction->m_operands.begin(), instruction->m_operands.end(),
+                    [&](ir_value* operand) {
+                        operand = resolve(replacements, operand);
+                        return operand == first || operand == instruction;
+                    });
+                if (same && first != instruction) {
+                    replacements[instruction] = first;
+                }
+            }
+        }
+        apply_replacements(function, replacements);
+    }
+
+    void eliminate_common_subexpressions(ir_function& function)
+    {
+        auto order = reverse_postorder(function);
+        auto idom = dominators(function, order);
+
+        std::vector<std::vector<ir_block*>> children(function.blocks().size());
+        for (auto block : order) {
+            if (block != function.entry()) {
+                children[idom[block->m_id]->m_id].push_back(block);
+            }
+        }
+
+        replacement_map replacements;
+        std::unordered_map<std::string, ir_value*> available;
+        std::vector<std::string> added;
+
+        auto key_of = [](ir_value* value) {
+            std::string key(1, static_cast<char>(value->m_op));
+            uint64_t bits = value->m_constant.bits();
+            key.append(reinterpret_cast<const char*>(&bits), sizeof(bits));
+            for (auto operand : value->m_operands) {
+                key.append(reinterpret_cast<const char*>(&operand->m_id), sizeof(operand->m_id));
+            }
+            return key;
+        };
+
+        // walks the dominator tree, values computed on the way down are visible to every
+        // block below. each stack entry remembers how much of `added` to undo on the way up
+        std::vector<std::pair<ir_block*, size_t>> stack = {{function.entry(), 0}};
+        std::vector<std::pair<size_t, size_t>> undo;
+        while (not stack.empty()) {
+            auto [block, child] = stack.back();
+            if (child == 0) {
+                undo.push_back({added.size(), 0});
+
+                std::unordered_map<uint64_t, ir_value*> globals;
+                for (auto instruction : block->m_instructions) {
+                    for (auto& operand : instruction->m_operands) {
+                        operand = resolve(replacements, operand);
+                    }
+
+                    switch (instruction->m_op) {
+                        case ir_op::GET_GLOBAL: {
+                            auto known = globals.find(instruction->m_constant.bits());
+                            if (known != globals.end()) {
+                                replacements[instruction] = known->second;
+                            }
+                            else {
+                                globals[instruction->m_constant.bits()] = instruction;
+                            }
+                            continue;
+                        }
+                        case ir_op::DEFINE_GLOBAL:
+                        case ir_op::SET_GLOBAL:
+                            globals[instruction->m_constant.bits()] = instruction->m_operands[0];
+                            continue;
+                        case ir_op::CALL:
+                            // a call could run code that assigns any global
+                            globals.clear();
+                            continue;
+                        case ir_op::PHI:
+                            continue;
+                        default:
+                            break;
+                    }
+
+                    if (not is_pure(instruction->m_op)) {
+                        continue;
+                    }
+                    auto key = key_of(instruction);
+                    auto found = available.find(key);
+                    if (found != available.end()) {
+                        replacements[instruction] = found->second;
+                    }
+                    else {
+                        available.emplace(key, instruction);
+                        added.push_back(key);
+                    }
+                }
+            }
+
+            if (child < children[block->m_id].size()) {
+                stack.back().second++;
+                stack.push_back({children[block->m_id][child], 0});
+                continue;
+            }
+
+            while (added.size() > undo.back().first) {
+                available.erase(added.back());
+                added.pop_back();
+            }
+            undo.pop_back();
+            stack.pop_back();
+        }
+
+        apply_replacements(function, replacements);
+    }
+
+    void hoist_loop_invariants(ir_function& function)
+    {
+        auto order = reverse_postorder(function);
+        auto idom = dominators(function, order);
+        auto types = infer_types(function);
+
+        std::vector<bool> in_loop(function.blocks().size());
+        std::vector<bool> defined_in_loop(function.value_count());
+
+        // innermost loops come last in reverse postorder, doing them first lets their
+        // invariants keep moving out through the enclosing loops
+        for (auto header_iter = order.rbegin(); header_iter != order.rend(); ++header_iter) {
+            auto header = *header_iter;
+
+            std::vector<ir_block*> body = {header};
+            std::fill(in_loop.begin(), in_loop.end(), false);
+            in_loop[header->m_id] = true;
+            for (auto pred : header->m_predecessors) {
+                if (dominates(idom, header, pred) && not in_loop[pred->m_id]) {
+                    in_loop[pred->m_id] = true;
+                    body.push_back(pred);
+                }
+            }
+            if (body.size() == 1 && std::find(header->m_predecessors.begin(),
+                    header->m_predecessors.end(), header) == header->m_predecessors.end()) {
+                continue;
+            }
+            for (size_t i = 1; i < body.size(); i++) {
+                for (auto pred : body[i]->m_predecessors) {
+                    if (not in_loop[pred->m_id]) {
+                        in_loop[pred->m_id] = true;
+                        body.push_back(pred);
+                    }
+                }
+            }
+
+            ir_block* preheader = nullptr;
+            int entries = 0;
+            for (auto pred : header->m_predecessors) {
+                if (not in_loop[pred->m_id]) {
+                    preheader = pred;
+                    entries++;
+                }
+            }
+            if (entries != 1 || preheader->m_successors.size() != 1) {
+                continue;
+            }
+
+            bool calls = false;
+            std::unordered_set<uint64_t> stored;
+            for (auto block : body) {
+                for (auto instruction : block->m_instructions) {
+                    defined_in_loop[instruction->m_id] = true;
+                    if (instruction->m_op == ir_op::CALL) {
+                        calls = true;
+                    }
+                    if (instruction->m_op == ir_op::SET_GLOBAL || instruction->m_op == ir_op::DEFINE_GLOBAL) {
+                        stored.insert(instruction->m_constant.bits());
+                    }
+                }
+            }
+
+            auto movable = [&](ir_value* value) {
+                if (value->m_op == ir_op::PHI) {
+                    return false;
+                }
+                if (value->m_op == ir_op::GET_GLOBAL) {
+                    return not calls && stored.count(value->m_constant.bits()) == 0;
+                }
+                return is_pure(value->m_op);
+            };
+
+            bool changed = true;
+            while (changed) {
+                changed = false;
+                for (auto block : body) {
+                    auto& instructions = block->m_instructions;
+                    for (size_t i = 0; i < instructions.size(); i++) {
+                        auto instruction = instructions[i];
+                        if (not movable(instruction)) {
+                            continue;
+                        }
+                        bool invariant = std::none_of(instruction->m_operands.begin(), instruction->m_operands.end(),
+                            [&](ir_value* operand) { return defined_in_loop[operand->m_id]; });
+                        if (not invariant) {
+                            continue;
+                        }
+
+                        // something that can fail may only move if it's the first thing the loop
+                        // does, then failing in the preheader happens at the same moment
+                        if (can_throw(instruction, types)) {
+                            bool first = block == header && std::all_of(instructions.begin(), instructions.begin() + i,
+                                [](ir_value* value) { return value->m_op == ir_op::PHI; });
+                            if (not first) {
+                                continue;
+                            }
+                        }
+
+                        instructions.erase(instructions.begin() + i);
+                        i--;
+                        auto& target = preheader->m_instructions;
+                        target.insert(target.end() - 1, instruction);
+                        instruction->m_block = preheader;
+                        defined_in_loop[instruction->m_id] = false;
+                        changed = true;
+                    }
+                }
+            }
+
+            for (auto block : body) {
+                for (auto instruction : block->m_instructions) {
+                    defined_in_loop[instruction->m_id] = false;
+                }
+            }
+        }
+    }
+
+    void eliminate_dead_stores(ir_function& function)
+    {
+        auto types = infer_types(function);
+        std::unordered_set<ir_value*> removed;
+
+        for (auto block : function.blocks()) {
+            // the last store to each name that nothing has looked at since, and that
+            // couldn't have failed - removing one that could would change the error
+            std::unordered_map<uint64_t, ir_value*> pending;
+            std::unordered_set<uint64_t> defined;
+
+            for (auto instruction : block->m_instructions) {
+                auto name = instruction->m_constant.bits();
+                switch (instruction->m_op) {
+                    case ir_op::GET_GLOBAL:
+                        pending.erase(name);
+                        if (defined.count(name) == 0) {
+                            // may fail on an undefined name, after which the stores are visible
+                            pending.clear();
+                            defined.insert(name);
+                        }
+                        break;
+
+                    case ir_op::DEFINE_GLOBAL:
+                    case ir_op::SET_GLOBAL: {
+                        auto earlier = pending.find(name);
+                        if (earlier != pending.end()) {
+                            // a define makes the name exist, so the store replacing it has to as well
+                            if (earlier->second->m_op == ir_op::DEFINE_GLOBAL) {
+                                instruction->m_op = ir_op::DEFINE_GLOBAL;
+                            }
+                            removed.insert(earlier->second);
+                        }
+                        else if (instruction->m_op == ir_op::SET_GLOBAL && defined.count(name) == 0) {
+                            pending.clear();
+                        }
+
+                        pending[name] = instruction;
+                        defined.insert(name);
+                        break;
+                    }
+
+                    default:
+                        if (instruction->m_op == ir_op::CALL || can_throw(instruction, types)) {
+                            pending.clear();
+                        }
+                        break;
+                }
+            }
+        }
+
+        for (auto block : function.blocks()) {
+            auto& instructions = block->m_instructions;
+            instructions.erase(std::remove_if(instructions.begin(), instructions.end(),
+                [&removed](ir_value* value) { return removed.count(value) != 0; }),
+                instructions.end());
+        }
+    }
+
+    void eliminate_dead_code(ir_function& function)
+    {
+        auto types = infer_types(function);
+        std::vector<int> use_counts(function.value_count(), 0);
+        for (auto block : function.blocks()) {
+            for (auto instruction : block->m_instructions) {
+                for (auto operand : instruction->m_operands) {
+                    use_counts[operand->m_id]++;
+                }
+            }
+        }
+
+        // removing a value can leave its operands unused, so go until nothing changes
+        bool changed = true;
+        while (changed) {
+            changed = false;
+            for (auto block : function.blocks()) {
+                auto& instructions = block->m_instructions;
+                for (size_t i = instructions.size(); i-- > 0;) {
+                    auto instruction = instructions[i];
+                    if (use_counts[instruction->m_id] != 0 || not is_pure(instruction->m_op) ||
+                        can_throw(instruction, types)) {
+                        continue;
+                    }
+                    for (auto operand : instruction->m_operands) {
+                        use_counts[operand->m_id]--;
+                    }
+                    instructions.erase(instructions.begin() + i);
+                    changed = true;
+                }
+            }
+        }
+    }
+
+    ir_pass_manager::ir_pass_manager()
+    {
+        m_passes = {
+            {"constant propagation", propagate_constants},
+            {"common subexpressions", eliminate_common_subexpressions},
+            {"loop invariant motion", hoist_loop_invariants},
+            {"dead stores", eliminate_dead_stores},
+            {"dead code", eliminate_dead_code},
+        };
+    }
+
+    void ir_pass_manager::run(ir_function& function)
+    {
+        for (auto& pass : m_passes) {
+            auto start = std::chrono::steady_clock::now();
+            pass.run(function);
+            std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+            pass.seconds += elapsed.count();
+        }
+        m_runs++;
+    }
+
+    void ir_pass_manager::report(std::ostream& out) const
+    {
+        double total = 0;
+        out << "pass timings over " << m_runs << (m_runs == 1 ? " run" : " runs") << ":" << std::endl;
+        for (auto& pass : m_passes) {
+            out << "  " << std::left << std::setw(24) << pass.name << std::right << std::fixed
+                << std::setprecision(3) << std::setw(10) << pass.seconds * 1000 << " ms" << std::endl;
+            total += pass.seconds;
+        }
+        out << "  " << std::left << std::setw(24) << "total" << std::right << std::fixed
+            << std::setprecision(3) << std::setw(10) << total * 1000 << " ms" << std::endl;
+        out.unsetf(std::ios::fixed);
+    }
+}
@@ -0,0 +1,43 @@
+#pragma once
+#include <ostream>
+#include <string>
+#include <vector>
+#include "ir.h"
+
+namespace lox
+{
+    // sparse conditional constant propagation (Wegman and Zadeck), replaces values that
+    // are constant on every path that can run and removes the blocks that can't
+    void propagate_constants(ir_function& function);
+    // reuses a pure value already computed in a dominating block, and forwards global
+    // loads from earlier loads and stores of the same name within a block
+    void eliminate_common_subexpressions(ir_function& function);
+    // moves loop invariant values into the block the loop is entered from. anything
+    // that could raise an error is only moved if it runs first thing in the loop anyway
+    void hoist_loop_invariants(ir_function& function);
+    // drops global stores that are overwritten later in the same block before anything
+    // could observe them
+    void eliminate_dead_stores(ir_function& function);
+    // drops values nothing uses, as long as computing them can't raise an error
+    void eliminate_dead_code(ir_function& function);
+
+    // runs every pass in order and keeps the time each one took, summed over runs
+    class ir_pass_manager
+    {
+        public:
+            ir_pass_manager();
+
+            void run(ir_function& function);
+            void report(std::ostream& out) const;
+
+        private:
+            struct pass {
+                std::string name;
+                void (*run)(ir_function&);
+                double seconds = 0;
+            };
+
+            std::vector<pass> m_passes;
+            int m_runs = 0;
+    };
+}
@@ -0,0 +1,189 @@
+#include "assembler.h"
+
+namespace lox
+{
+    namespace
+    {
+        constexpr uint8_t REX_W = 0x48;
+        constexpr uint8_t SSE_DOUBLE = 0xf2;
+        constexpr uint8_t SSE_PACKED = 0x66;
+
+        uint8_t register_modrm(uint8_t reg, uint8_t rm)
+        {
+            return 0xc0 | (reg << 3) | rm;
+        }
+    }
+
+    x64_assembler::label x64_assembler::new_label()
+    {
+        m_labels.push_back(-1);
+        return m_labels.size() - 1;
+    }
+
+    void x64_assembler::bind(label target)
+    {
+        m_labels[target] = m_code.size();
+    }
+
+    void x64_assembler::load(gp_register dst, gp_register base, int32_t displacement)
+    {
+        emit(REX_W);
+        emit(0x8b);
+        emit_memory(static_cast<uint8_t>(dst), base, displacement);
+    }
+
+    void x64_assembler::load_immediate(gp_register dst, uint64_t value)
+    {
+        emit(REX_W);
+        emit(0xb8 + static_cast<uint8_t>(dst));
+        emit32(static_cast<uint32_t>(value));
+        emit32(static_cast<uint32_t>(value >> 32));
+    }
+
+    void x64_assembler::load_double(xmm_register dst, gp_register base, int32_t displacement)
+    {
+        emit(SSE_DOUBLE);
+        emit(0x0f);
+        emit(0x10);
+        emit_memory(static_cast<uint8_t>(dst), base, displacement);
+    }
+
+    void x64_assembler::store_double(gp_register base, int32_t displacement, xmm_register src)
+    {
+        emit(SSE_DOUBLE);
+        emit(0x0f);
+        emit(0x11);
+        emit_memory(static_cast<uint8_t>(src), base, displacement);
+    }
+
+    void x64_assembler::move_to_xmm(xmm_register dst, gp_register src)
+    {
+        emit(SSE_PACKED);
+        emit(REX_W);
+        emit(0x0f);
+        emit(0x6e);
+        emit(register_modrm(static_cast<uint8_t>(dst), static_cast<uint8_t>(src)));
+    }
+
+    void x64_assembler::move_double(xmm_register dst, xmm_register src)
+    {
+        emit_sse(SSE_PACKED, 0x28, dst, src);
+    }
+
+    void x64_assembler::add_double(xmm_register dst, xmm_register src)
+    {
+        emit_sse(SSE_DOUBLE, 0x58, dst, src);
+    }
+
+    void x64_assembler::subtract_double(xmm_register dst, xmm_register src)
+    {
+        emit_sse(SSE_DOUBLE, 0x5c, dst, src);
+    }
+
+    void x64_assembler::multiply_double(xmm_register dst, xmm_register src)
+    {
+        emit_sse(SSE_DOUBLE, 0x59, dst, src);
+    }
+
+    void x64_assembler::divide_double(xmm_register dst, xmm_register src)
+    {
+        emit_sse(SSE_DOUBLE, 0x5e, dst, src);
+    }
+
+    void x64_assembler::xor_double(xmm_register dst, xmm_register src)
+    {
+        emit_sse(SSE_PACKED, 0x57, dst, src);
+    }
+
+    void x64_assembler::compare_double(xmm_register left, xmm_register right)
+    {
+        emit_sse(SSE_PACKED, 0x2e, left, right);
+    }
+
+    void x64_assembler::grow_stack(int8_t amount)
+    {
+        // sub rsp, imm8
+        emit(REX_W);
+        emit(0x83);
+        emit(register_modrm(5, static_cast<uint8_t>(gp_register::rsp)));
+        emit(static_cast<uint8_t>(amount));
+    }
+
+    void x64_assembler::shrink_stack(int8_t amount)
+    {
+        // add rsp, imm8
+        emit(REX_W);
+        emit(0x83);
+        emit(register_modrm(0, static_cast<uint8_t>(gp_register::rsp)));
+        emit(static_cast<uint8_t>(amount));
+    }
+
+    void x64_assembler::jump(label target)
+    {
+        emit(0xe9);
+        emit_jump_target(target);
+    }
+
+    void x64_assembler::jump_if(condition when, label target)
+    {
+        emit(0x0f);
+        emit(0x80 | static_cast<uint8_t>(when));
+        emit_jump_target(target);
+    }
+
+    void x64_assembler::ret()
+    {
+        emit(0xc3);
+    }
+
+    const std::vector<uint8_t>& x64_assembler::finish()
+    {
+        for (auto& fix : m_fixups) {
+            // relative to the end of the rel32, which is where the cpu will be
+            int64_t distance = m_labels[fix.target] - static_cast<int64_t>(fix.offset + 4);
+            auto value = static_cast<uint32_t>(static_cast<int32_t>(distance));
+            for (int i = 0; i < 4; i++) {
+                m_code[fix.offset + i] = static_cast<uint8_t>(value >> (i * 8));
+            }
+        }
+        m_fixups.clear();
+        return m_code;
+    }
+
+    void x64_assembler::emit(uint8_t byte)
+    {
+        m_code.push_back(byte);
+    }
+
+    void x64_assembler::emit32(uint32_t value)
+    {
+        for (int i = 0; i < 4; i++) {
+            emit(static_cast<uint8_t>(value >> (i * 8)));
+        }
+    }
+
+    void x64_assembler::emit_sse(uint8_t prefix, uint8_t opcode, xmm_register dst, xmm_register src)
+    {
+        emit(prefix);
+        emit(0x0f);
+        emit(opcode);
+        emit(register_modrm(static_cast<uint8_t>(dst), static_cast<uint8_t>(src)));
+    }
+
+    void x64_assembler::emit_memory(uint8_t reg, gp_register base, int32_t displacement)
+    {
+        // always the disp32 form, the code is short lived and simplicity wins
+        emit(0x80 | (reg << 3) | static_cast<uint8_t>(base));
+        if (base == gp_register::rsp) {
+            // rsp as a base needs a sib byte with no index
+            emit(0x24);
+        }
+        emit32(static_cast<uint32_t>(displacement));
+    }
+
+    void x64_assembler::emit_jump_target(label target)
+    {
+        m_fixups.push_back({m_code.size(), target});
+        emit32(0);
+    }
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace lox
+{
+    // the few x86-64 registers the jit uses, numbered as the encoding wants them
+    enum class gp_register : uint8_t { rax = 0, rcx = 1, rsp = 4, rsi = 6, rdi = 7 };
+    enum class xmm_register : uint8_t { xmm0 = 0, xmm1 = 1 };
+
+    // condition codes for jcc, the comments give the meaning after ucomisd
+    enum class condition : uint8_t {
+        below = 0x2,          // less than, or unordered
+        above_equal = 0x3,    // greater or equal, and ordered
+        equal = 0x4,          // equal, or unordered
+        not_equal = 0x5,      // not equal, and ordered
+        below_equal = 0x6,    // less or equal, or unordered
+        above = 0x7,          // greater than, and ordered
+        parity = 0xa,         // unordered
+    };
+
+    // writes machine code into a byte vector. only the instructions the loop jit
+    // needs are here, every memory operand is a base register plus a displacement
+    class x64_assembler
+    {
+        public:
+            using label = size_t;
+
+            label new_label();
+            // the label refers to the next instruction emitted
+            void bind(label target);
+
+            // mov dst, [base + displacement]
+            void load(gp_register dst, gp_register base, int32_t displacement);
+            // mov dst, imm64
+            void load_immediate(gp_register dst, uint64_t value);
+            // movsd dst, [base + displacement]
+            void load_double(xmm_register dst, gp_register base, int32_t displacement);
+            // movsd [base + displacement], src
+            void store_double(gp_register base, int32_t displacement, xmm_register src);
+            // movq dst, src
+            void move_to_xmm(xmm_register dst, gp_register src);
+            // movapd dst, src
+            void move_double(xmm_register dst, xmm_register src);
+
+            void add_double(xmm_register dst, xmm_register src);
+            void subtract_double(xmm_register dst, xmm_register src);
+            void multiply_double(xmm_register dst, xmm_register src);
+            void divide_double(xmm_register dst, xmm_register src);
+            // xorpd dst, src
+            void xor_double(xmm_register dst, xmm_register src);
+            // ucomisd left, right
+            void compare_double(xmm_register left, xmm_register right);
+
+            // add rsp, amount and sub rsp, amount
+            void grow_stack(int8_t amount);
+            void shrink_stack(int8_t amount);
+
+            void jump(label target);
+            void jump_if(condition when, label target);
+            void ret();
+
+            // resolves every jump, all labels have to be bound by now
+            const std::vector<uint8_t>& finish();
+
+        private:
+            void emit(uint8_t byte);
+            void emit32(uint32_t value);
+            void emit_sse(uint8_t prefix, uint8_t opcode, xmm_register dst, xmm_register src);
+            // modrm and sib for [base + displacement], reg is the other operand
+            void emit_memory(uint8_t reg, gp_register base, int32_t displacement);
+            void emit_jump_target(label target);
+
+            std::vector<uint8_t> m_code;
+            // the offset each label is bound to, or -1
+            std::vector<int64_t> m_labels;
+            // where a rel32 needs the distance to a label patched in
+            struct fixup {
+                size_t offset;
+                label target;
+            };
+            std::vector<fixup> m_fixups;
+    };
+}
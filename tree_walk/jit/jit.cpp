@@ -0,0 +1,440 @@
+#include "jit.h"
+#include <cstring>
+#include <map>
+#include <utility>
+#include "assembler.h"
+#include "../environment.h"
+
+#if defined(__x86_64__) && defined(__linux__)
+#include <sys/mman.h>
+#define LOX_JIT_SUPPORTED 1
+#else
+#define LOX_JIT_SUPPORTED 0
+#endif
+
+namespace lox
+{
+    namespace
+    {
+        // back edges before a loop is worth compiling
+        constexpr uint32_t HOT_LOOP = 1000;
+
+        constexpr uint64_t SIGN_BIT = 0x8000000000000000;
+
+        using gp = gp_register;
+        using xmm = xmm_register;
+
+        // lowers one loop to machine code. every value is a double: expressions leave
+        // theirs in xmm0, spilling to the stack while the other operand is worked out.
+        // rdi holds the table of outer variable addresses and rsi the inner locals
+        class loop_compiler
+        {
+            public:
+                loop_compiler(jit_loop& result) : m_result(result) {}
+
+                // false if anything in the loop is beyond the jit
+                bool compile(while_stmt* loop)
+                {
+                    if (not compile_loop(loop)) {
+                        return false;
+                    }
+                    m_asm.ret();
+                    return true;
+                }
+
+                const std::vector<uint8_t>& code()
+                {
+                    return m_asm.finish();
+                }
+
+            private:
+                bool compile_loop(while_stmt* loop)
+                {
+                    auto top = m_asm.new_label();
+                    auto exit = m_asm.new_label();
+
+                    m_asm.bind(top);
+                    if (not branch(loop->m_condition, false, exit) || not statement(loop->m_body)) {
+                        return false;
+                    }
+                    m_asm.jump(top);
+                    m_asm.bind(exit);
+                    return true;
+                }
+
+                bool statement(stmt* statement)
+                {
+                    if (auto expression = dynamic_cast<expression_stmt*>(statement)) {
+                        return number(expression->m_expression);
+                    }
+                    if (auto var = dynamic_cast<var_stmt*>(statement)) {
+                        // without an initializer the local would be nil
+                        if (m_blocks.empty() || var->m_initializer == nullptr ||
+                            not number(var->m_initializer)) {
+                            return false;
+                        }
+                        m_asm.store_double(gp::rsi, inner_offset(0, var->m_slot), xmm::xmm0);
+                        return true;
+                    }
+                    if (auto block = dynamic_cast<block_stmt*>(statement)) {
+                        if (block->is_scope()) {
+                            m_blocks.push_back(m_result.m_inner_count);
+                            m_result.m_inner_count += block->m_slot_names.size();
+                        }
+                        for (auto inner : block->m_statements) {
+                            if (not this->statement(inner)) {
+                                return false;
+                            }
+                        }
+                        if (block->is_scope()) {
+                            m_blocks.pop_back();
+                        }
+                        return true;
+                    }
+                    if (auto branch_stmt = dynamic_cast<if_stmt*>(statement)) {
+                        auto otherwise = m_asm.new_label();
+                        auto end = m_asm.new_label();
+                        if (not branch(branch_stmt->m_condition, false, otherwise) ||
+                            not this->statement(branch_stmt->m_then_branch)) {
+                            return false;
+                        }
+                        m_asm.jump(end);
+                        m_asm.bind(otherwise);
+                        if (branch_stmt->m_else_branch && not this->statement(branch_stmt->m_else_branch)) {
+                            return false;
+                        }
+                        m_asm.bind(end);
+                        return true;
+                    }
+                    if (auto loop = dynamic_cast<while_stmt*>(statement)) {
+                        return compile_loop(loop);
+                    }
+                    // prints, functions, returns
+                    return false;
+                }
+
+                // leaves the value in xmm0, only expressions that can only be numbers
+                bool number(expr* exp)
+                {
+                    if (auto literal = dynamic_cast<literal_expr*>(exp)) {
+                        if (not literal->m_value.is_number()) {
+                            return false;
+                        }
+                        m_asm.load_immediate(gp::rax, literal->m_value.bits());
+                        m_asm.move_to_xmm(xmm::xmm0, gp::rax);
+                        return true;
+                    }
+                    if (auto variable = dynamic_cast<variable_expr*>(exp)) {
+                        // captured variables are reached through the running function
+                        if (variable->m_upvalue != -1) {
+                            return false;
+                        }
+                        load(variable->m_depth, variable->m_slot, variable->m_name);
+                        return true;
+                    }
+                    if (auto assign = dynamic_cast<assign_expr*>(exp)) {
+                        if (assign->m_upvalue != -1 || not number(assign->m_value)) {
+                            return false;
+                        }
+                        store(assign->m_depth, assign->m_slot, assign->m_name);
+                        return true;
+                    }
+                    if (auto grouping = dynamic_cast<grouping_expr*>(exp)) {
+                        return number(grouping->m_expression);
+                    }
+                    if (auto unary = dynamic_cast<unary_expr*>(exp)) {
+                        if (unary->m_op.type != token_type::MINUS || not number(unary->m_right)) {
+                            return false;
+                        }
+                        m_asm.load_immediate(gp::rax, SIGN_BIT);
+                        m_asm.move_to_xmm(xmm::xmm1, gp::rax);
+                        m_asm.xor_double(xmm::xmm0, xmm::xmm1);
+                        return true;
+                    }
+                    if (auto binary = dynamic_cast<binary_expr*>(exp)) {
+                        switch (binary->m_op.type) {
+                            case token_type::PLUS:
+                            case token_type::MINUS:
+                            case token_type::STAR:
+                            case token_type::SLASH:
+                                break;
+                            default:
+                                // comparisons give booleans, only branches can use them
+                                return false;
+                        }
+                        if (not operands(binary)) {
+                            return false;
+                        }
+                        switch (binary->m_op.type) {
+                            case token_type::PLUS:
+                                m_asm.add_double(xmm::xmm0, xmm::xmm1);
+                                break;
+                            case token_type::MINUS:
+                                m_asm.subtract_double(xmm::xmm0, xmm::xmm1);
+                                break;
+                            case token_type::STAR:
+                                m_asm.multiply_double(xmm::xmm0, xmm::xmm1);
+                                break;
+                            default:
+                                m_asm.divide_double(xmm::xmm0, xmm::xmm1);
+                                break;
+                        }
+                        return true;
+                    }
+                    // strings, calls, logical values
+                    return false;
+                }
+
+                // left in xmm0 and right in xmm1, evaluated left first
+                bool operands(binary_expr* binary)
+                {
+                    if (not number(binary->m_left)) {
+                        return false;
+                    }
+                    m_asm.grow_stack(8);
+                    m_asm.store_double(gp::rsp, 0, xmm::xmm0);
+                    if (not number(binary->m_right)) {
+                        return false;
+                    }
+                    m_asm.move_double(xmm::xmm1, xmm::xmm0);
+                    m_asm.load_double(xmm::xmm0, gp::rsp, 0);
+                    m_asm.shrink_stack(8);
+                    return true;
+                }
+
+                // jumps to target when the truthiness of the expression is when
+                bool branch(expr* exp, bool when, x64_assembler::label target)
+                {
+                    if (auto literal = dynamic_cast<literal_expr*>(exp)) {
+                        if (static_cast<bool>(literal->m_value) == when) {
+                            m_asm.jump(target);
+                        }
+                        return true;
+                    }
+                    if (auto grouping = dynamic_cast<grouping_expr*>(exp)) {
+                        return branch(grouping->m_expression, when, target);
+                    }
+                    if (auto unary = dynamic_cast<unary_expr*>(exp)) {
+                        if (unary->m_op.type == token_type::BANG) {
+                            return branch(unary->m_right, not when, target);
+                        }
+                    }
+                    if (auto logical = dynamic_cast<logical_expr*>(exp)) {
+                        // and is false as soon as one side is, or true as soon as one side is
+                        bool decides = logical->m_op.type == token_type::OR;
+                        if (when == decides) {
+                            return branch(logical->m_left, when, target) &&
+                                   branch(logical->m_right, when, target);
+                        }
+                        auto skip = m_asm.new_label();
+                        if (not branch(logical->m_left, decides, skip) ||
+                            not branch(logical->m_right, when, target)) {
+                            return false;
+                        }
+                        m_asm.bind(skip);
+                        return true;
+                    }
+                    if (auto binary = dynamic_cast<binary_expr*>(exp)) {
+                        switch (binary->m_op.type) {
+                            case token_type::GREATER:
+                            case token_type::GREATER_EQUAL:
+                            case token_type::LESS:
+                            case token_type::LESS_EQUAL:
+                            case token_type::EQUAL_EQUAL:
+                            case token_type::BANG_EQUAL:
+                                return comparison(binary, when, target);
+                            default:
+                                break;
+                        }
+                    }
+
+                    // anything else has to be a number, and every number is truthy
+                    if (not number(exp)) {
+                        return false;
+                    }
+                    if (when) {
+                        m_asm.jump(target);
+                    }
+                    return true;
+                }
+
+                bool comparison(binary_expr* binary, bool when, x64_assembler::label target)
+                {
+                    if (not operands(binary)) {
+                        return false;
+                    }
+
+                    // unordered, a NaN on either side, makes every comparison but != false.
+                    // less than is tested as greater than with the operands swapped so
+                    // that the unordered case always lands on the false side
+                    switch (binary->m_op.type) {
+                        case token_type::GREATER:
+                            m_asm.compare_double(xmm::xmm0, xmm::xmm1);
+                            m_asm.jump_if(when ? condition::above : condition::below_equal, target);
+                            return true;
+                        case token_type::GREATER_EQUAL:
+                            m_asm.compare_double(xmm::xmm0, xmm::xmm1);
+                            m_asm.jump_if(when ? condition::above_equal : condition::below, target);
+                            return true;
+                        case token_type::LESS:
+                            m_asm.compare_double(xmm::xmm1, xmm::xmm0);
+                            m_asm.jump_if(when ? condition::above : condition::below_equal, target);
+                            return true;
+                        case token_type::LESS_EQUAL:
+                            m_asm.compare_double(xmm::xmm1, xmm::xmm0);
+                            m_asm.jump_if(when ? condition::above_equal : condition::below, target);
+                            return true;
+                        default:
+                            break;
+                    }
+
+                    m_asm.compare_double(xmm::xmm0, xmm::xmm1);
+                    bool jump_when_equal = (binary->m_op.type == token_type::EQUAL_EQUAL) == when;
+                    if (jump_when_equal) {
+                        auto skip = m_asm.new_label();
+                        m_asm.jump_if(condition::parity, skip);
+                        m_asm.jump_if(condition::equal, target);
+                        m_asm.bind(skip);
+                    }
+                    else {
+                        m_asm.jump_if(condition::parity, target);
+                        m_asm.jump_if(condition::not_equal, target);
+                    }
+                    return true;
+                }
+
+                void load(int depth, int slot, const token& name)
+                {
+                    if (is_inner(depth)) {
+                        m_asm.load_double(xmm::xmm0, gp::rsi, inner_offset(depth, slot));
+                        return;
+                    }
+                    m_asm.load(gp::rax, gp::rdi, outer_offset(depth, slot, name));
+                    m_asm.load_double(xmm::xmm0, gp::rax, 0);
+                }
+
+                void store(int depth, int slot, const token& name)
+                {
+                    if (is_inner(depth)) {
+                        m_asm.store_double(gp::rsi, inner_offset(depth, slot), xmm::xmm0);
+                        return;
+                    }
+                    m_asm.load(gp::rax, gp::rdi, outer_offset(depth, slot, name));
+                    m_asm.store_double(gp::rax, 0, xmm::xmm0);
+                }
+
+                bool is_inner(int depth)
+                {
+                    return depth != -1 && depth < static_cast<int>(m_blocks.size());
+                }
+
+                int32_t inner_offset(int depth, int slot)
+                {
+                    size_t index = m_blocks[m_blocks.size() - 1 - depth] + slot;
+                    return static_cast<int32_t>(index * sizeof(double));
+                }
+
+                // the variable's entry in the address table, adding it the first time
+                int32_t outer_offset(int depth, int slot, const token& name)
+                {
+                    std::pair<int, int> key{-1, -1};
+                    std::string text;
+                    if (depth == -1) {
+                        text = std::string(name.lexeme);
+                    }
+                    else {
+                        // relative to the environment the loop started in
+                        key = {depth - static_cast<int>(m_blocks.size()), slot};
+                    }
+
+                    auto& index = m_outer_indices[{key, text}];
+                    if (index == 0) {
+                        m_result.m_outer.push_back({key.first, key.second,
+                            depth == -1 ? name.value : object()});
+                        index = m_result.m_outer.size();
+                    }
+                    return static_cast<int32_t>((index - 1) * sizeof(object*));
+                }
+
+                jit_loop& m_result;
+                x64_assembler m_asm;
+                // the first inner local of every block inside the loop, innermost last
+                std::vector<size_t> m_blocks;
+                // one more than each outer variable's index in the address table
+                std::map<std::pair<std::pair<int, int>, std::string>, size_t> m_outer_indices;
+        };
+
+        std::shared_ptr<jit_loop> compile(while_stmt* loop)
+        {
+            auto result = std::make_shared<jit_loop>();
+#if LOX_JIT_SUPPORTED
+            loop_compiler compiler(*result);
+            if (not compiler.compile(loop)) {
+                return result;
+            }
+
+            auto& code = compiler.code();
+            void* memory = mmap(nullptr, code.size(), PROT_READ | PROT_WRITE,
+                                MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (memory == MAP_FAILED) {
+                return result;
+            }
+            std::memcpy(memory, code.data(), code.size());
+            // never writable and executable at once
+            if (mprotect(memory, code.size(), PROT_READ | PROT_EXEC) != 0) {
+                munmap(memory, code.size());
+                return result;
+            }
+
+            result->m_code = memory;
+            result->m_code_size = code.size();
+            result->m_supported = true;
+#endif
+            return result;
+        }
+    }
+
+    jit_loop::~jit_loop()
+    {
+#if LOX_JIT_SUPPORTED
+        if (m_code != nullptr) {
+            munmap(m_code, m_code_size);
+        }
+#endif
+    }
+
+    loop_jit::loop_jit(jit_mode mode) :
+        m_threshold(mode == jit_mode::always ? 0 : HOT_LOOP)
+    {
+    }
+
+    bool loop_jit::run(while_stmt* loop, environment& locals, environment& globals)
+    {
+        if (loop->m_jit_loop == nullptr) {
+            loop->m_jit_loop = compile(loop);
+            if (not loop->m_jit_loop->m_supported) {
+                return false;
+            }
+        }
+        auto& compiled = *loop->m_jit_loop;
+
+        // the code assumes every variable it touches is a number, if one isn't
+        // the interpreter runs the loop instead
+        m_addresses.clear();
+        for (auto& variable : compiled.m_outer) {
+            object* address = variable.m_depth == -1 ?
+                globals.find(variable.m_name) :
+                locals.slot_address(variable.m_depth, variable.m_slot);
+            if (address == nullptr || not address->is_number()) {
+                return false;
+            }
+            m_addresses.push_back(address);
+        }
+        m_inner.assign(compiled.m_inner_count, 0.0);
+
+        // an object holding a number is just the double, so the code reads and writes them in place
+        auto code = reinterpret_cast<void (*)(object**, double*)>(compiled.m_code);
+        code(m_addresses.data(), m_inner.data());
+        return true;
+    }
+}
@@ -0,0 +1,73 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "../stmt.h"
+
+namespace lox
+{
+    class environment;
+
+    // off never compiles, on compiles loops once they are hot and always compiles
+    // every loop the first time it runs, which is how the jit is tested
+    enum class jit_mode { off, on, always };
+
+    // a while loop compiled to x86-64, or the record that it couldn't be. the code
+    // works on raw doubles, so it only covers loops doing arithmetic on numbers:
+    // no calls, prints, strings or values other than numbers and conditions
+    class jit_loop
+    {
+        public:
+            jit_loop() = default;
+            ~jit_loop();
+
+            jit_loop(const jit_loop&) = delete;
+            jit_loop& operator=(const jit_loop&) = delete;
+
+            // a variable declared outside the loop, the code is handed its address
+            struct outer_variable {
+                // a depth of -1 means the variable is a global, found by name
+                int m_depth;
+                int m_slot;
+                object m_name;
+            };
+
+            bool m_supported = false;
+            std::vector<outer_variable> m_outer;
+            // locals declared inside the loop body, the code keeps these itself
+            size_t m_inner_count = 0;
+
+            // void code(object** outer, double* inner)
+            void* m_code = nullptr;
+            size_t m_code_size = 0;
+    };
+
+    // runs hot while loops as machine code for the interpreter
+    class loop_jit
+    {
+        public:
+            loop_jit(jit_mode mode);
+
+            // called before a loop's first trip and after every back edge. when the loop
+            // is hot and compiled, and the variables it uses all hold numbers, the rest
+            // of the loop runs natively and this returns true. otherwise the interpreter
+            // carries on, so a type the code can't handle just means it isn't used
+            bool enter(while_stmt* loop, environment& locals, environment& globals)
+            {
+                if (loop->m_back_edges < m_threshold) {
+                    loop->m_back_edges++;
+                    return false;
+                }
+                if (loop->m_jit_loop != nullptr && not loop->m_jit_loop->m_supported) {
+                    return false;
+                }
+                return run(loop, locals, globals);
+            }
+
+        private:
+            bool run(while_stmt* loop, environment& locals, environment& globals);
+
+            uint32_t m_threshold;
+            std::vector<object*> m_addresses;
+            std::vector<double> m_inner;
+    };
+}
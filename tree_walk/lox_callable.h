@@ -1,14 +1,19 @@
 #pragma once
 #include "token.h"
 #include "interpreter.h"
+#include <string>
 #include <vector>
 
 namespace lox
 {
-    class lox_callable
+    class lox_callable : public heap_object
     {
         public:
+            explicit lox_callable(bool collected = false) : heap_object(heap_type::callable, collected) {}
+
             virtual int arity() = 0;
-            virtual object call(interpreter* interpreter, std::vector<object> arguments) = 0; 
+            virtual object call(interpreter* interpreter, const std::vector<object>& arguments) = 0; 
+            // what print shows
+            virtual std::string to_string() { return "<native fn>"; }
     };
-}
\ No newline at end of file
+}
@@ -0,0 +1,55 @@
+#pragma once
+#include "lox_callable.h"
+#include "collector.h"
+#include "environment.h"
+#include "stmt.h"
+#include <string>
+#include <vector>
+
+namespace lox
+{
+    // a function declared in the script, a flat closure over just the upvalues its
+    // declaration asked for rather than the whole scope it was declared in. it can
+    // end up referring to itself through them, so it belongs to the collector
+    class lox_function : public lox_callable, public traced
+    {
+        public:
+            // the upvalues are added once it's made, see interpreter::visit_function
+            explicit lox_function(function_stmt* declaration) :
+                lox_callable(true), m_declaration(declaration) {}
+
+            int arity() override
+            {
+                return static_cast<int>(m_declaration->m_params.size());
+            }
+
+            object call(interpreter* interpreter, const std::vector<object>& arguments) override
+            {
+                return interpreter->call(this, arguments);
+            }
+
+            std::string to_string() override
+            {
+                return "<fn " + std::string(m_declaration->m_name.lexeme) + ">";
+            }
+
+            traced* as_traced() override { return this; }
+
+            void trace(collector& gc) override
+            {
+                for (auto captured : m_upvalues) {
+                    gc.mark(captured);
+                }
+            }
+
+            size_t size() const override
+            {
+                return sizeof(lox_function) + m_upvalues.size() * sizeof(upvalue*);
+            }
+
+            // lives in the arena of the run that declared it, see tree_walk::run
+            function_stmt* m_declaration;
+            // indexed by the variables' m_upvalue
+            std::vector<upvalue*> m_upvalues;
+    };
+}
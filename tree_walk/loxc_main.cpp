@@ -0,0 +1,69 @@
+#include "aot/transpiler.h"
+#include "constant_folder.h"
+#include "parser.h"
+#include "resolver.h"
+#include "scanner.h"
+#include "source_file.h"
+#include "tree_walk.h"
+
+#include <fstream>
+#include <iostream>
+#include <string>
+
+// compiles a script to c++ ahead of time, e.g.
+//   ./loxc script.lox && g++ -std=c++2a -O2 -I . script.cpp aot/lox_runtime.a -o script
+int main(int num_args, char ** args)
+{
+    if (num_args != 2 && num_args != 3) {
+        std::cout << "Usage: loxc script [output]" << std::endl;
+        return 64;
+    }
+
+    std::string path = args[1];
+    std::string output_path;
+    if (num_args == 3) {
+        output_path = args[2];
+    }
+    else {
+        output_path = path.substr(0, path.rfind(".lox")) + ".cpp";
+    }
+
+    lox::source_file file(path);
+    if (not file.is_open()) {
+        std::cerr << "Could not open " << path << std::endl;
+        return 66;
+    }
+
+    // the same front end tree_walk::run uses, so the program reports the same errors
+    lox::scanner scanner(file.text());
+    auto tokens = scanner.scan_tokens();
+    lox::arena nodes;
+    lox::parser psr(std::move(tokens), nodes);
+    auto statements = psr.parse();
+    if (lox::tree_walk::had_error) {
+        return 65;
+    }
+
+    lox::resolver resolver;
+    resolver.resolve(statements);
+    if (lox::tree_walk::had_error) {
+        return 65;
+    }
+
+    lox::constant_folder folder(nodes);
+    folder.fold(statements);
+
+    lox::transpiler transpiler;
+    auto code = transpiler.transpile(statements, path);
+    if (lox::tree_walk::had_error) {
+        return 65;
+    }
+
+    std::ofstream output(output_path);
+    output << code;
+    if (not output) {
+        std::cerr << "Could not write " << output_path << std::endl;
+        return 74;
+    }
+    return 0;
+}
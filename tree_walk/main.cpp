@@ -1,16 +1,91 @@
+#include <cstdlib>
 #include <iostream>
+#include <string>
 #include "tree_walk.h"
 
+namespace
+{
+    // the positive number in an option like --name=value
+    bool number_option(const std::string& option, const std::string& name, double& value)
+    {
+        auto prefix = name + "=";
+        if (option.rfind(prefix, 0) != 0) {
+            return false;
+        }
+        auto text = option.c_str() + prefix.size();
+        char* end;
+        value = std::strtod(text, &end);
+        return end != text && *end == '\0' && value > 0;
+    }
+}
+
 int main(int num_args, char ** args) {
-    if (num_args == 2) {
-        lox::tree_walk::run_file(args[1]);
+    // options come before the script, e.g. lox --engine=vm script.lox
+    int arg = 1;
+    for (; arg < num_args; arg++) {
+        std::string option = args[arg];
+        double value;
+        if (option.rfind("--", 0) != 0) {
+            break;
+        }
+
+        if (option == "--engine=vm") {
+            lox::tree_walk::set_engine(lox::engine_type::vm);
+        }
+        else if (option == "--engine=interpreter") {
+            lox::tree_walk::set_engine(lox::engine_type::interpreter);
+        }
+        else if (option == "--engine=closure") {
+            lox::tree_walk::set_engine(lox::engine_type::closure);
+        }
+        else if (option == "--engine=ir") {
+            lox::tree_walk::set_engine(lox::engine_type::ir);
+        }
+        else if (option == "--dump-ir") {
+            lox::tree_walk::set_dump_ir(true);
+        }
+        else if (option == "--time-passes") {
+            lox::tree_walk::set_time_passes(true);
+        }
+        else if (option == "--jit=off") {
+            lox::tree_walk::set_jit(lox::jit_mode::off);
+        }
+        else if (option == "--jit=on") {
+            lox::tree_walk::set_jit(lox::jit_mode::on);
+        }
+        else if (option == "--jit=always") {
+            lox::tree_walk::set_jit(lox::jit_mode::always);
+        }
+        else if (number_option(option, "--max-frames", value)) {
+            lox::tree_walk::set_max_frames(static_cast<size_t>(value));
+        }
+        else if (number_option(option, "--gc-nursery", value)) {
+            lox::tree_walk::set_gc_nursery(static_cast<size_t>(value));
+        }
+        else if (number_option(option, "--gc-growth", value)) {
+            lox::tree_walk::set_gc_growth(value);
+        }
+        else if (option == "--gc-stats") {
+            lox::tree_walk::set_gc_stats(true);
+        }
+        else if (option == "--stream") {
+            lox::tree_walk::set_streaming(true);
+        }
+        else {
+            std::cout << "Unknown option " << option << std::endl;
+            return 64;
+        }
+    }
+
+    if (num_args - arg == 1) {
+        lox::tree_walk::run_file(args[arg]);
     }
-    else if (num_args == 1) {
+    else if (num_args - arg == 0) {
         lox::tree_walk::run_prompt();
     }
     else {
-        std::cout << "Usage: lox [script]" << std::endl;
+        std::cout << "Usage: lox [--engine=interpreter|vm|ir|closure] [--jit=off|on|always] [--max-frames=n] [--gc-nursery=bytes] [--gc-growth=factor] [--gc-stats] [--stream] [--dump-ir] [--time-passes] [script]" << std::endl;
     }
 
     return 0;
-}
\ No newline at end of file
+}
@@ -1,6 +1,8 @@
 #pragma once
 #include "lox_callable.h"
 #include <chrono>
+#include <map>
+#include <string>
 
 namespace lox
 {
@@ -12,7 +14,7 @@ namespace lox
                 return 0;
             }
 
-            object call(interpreter* interpreter, std::vector<object> arguments) override
+            object call(interpreter* interpreter, const std::vector<object>& arguments) override
             {
                 auto now = std::chrono::system_clock::now();
                 auto ms_since_epoch = std::chrono::duration_cast<std::chrono::milliseconds>
@@ -20,4 +22,12 @@ namespace lox
                 return object(static_cast<double>(ms_since_epoch));
             }
     };
+
+    // everything the runtime defines as a global before a script runs
+    inline std::map<std::string, object> native_functions()
+    {
+        return {
+            {"clock", object(new clock())}
+        };
+    }
 }
\ No newline at end of file
@@ -1,52 +1,77 @@
 #include "parser.h"
 #include "tree_walk.h"
+#include <array>
 #include <iostream>
 
 namespace lox
 {
-    parser::parser(std::vector<token> tokens) {
-        m_tokens = tokens;
+    parser::parser(token_buffer tokens, arena& nodes) :
+        m_tokens(std::move(tokens)),
+        m_arena(nodes)
+    {
+    }
+
+    parser::parser(scanner& source, arena& nodes) :
+        m_tokens(source.source()),
+        m_source(&source),
+        m_arena(nodes)
+    {
     }
 
-    std::vector<std::shared_ptr<stmt>> parser::parse()
+    std::vector<stmt*> parser::parse()
     {
-        std::vector<std::shared_ptr<stmt>> statements;
+        std::vector<stmt*> statements;
         while (not is_at_end()) {
             statements.push_back(declaration());
         }
         return statements;
     }
 
-    std::shared_ptr<stmt> parser::declaration()
+    stmt* parser::next_declaration()
+    {
+        // a new declaration never looks back at the last one's tokens
+        m_tokens.discard(m_current);
+        m_current = 0;
+        return declaration();
+    }
+
+    bool parser::done()
+    {
+        return is_at_end();
+    }
+
+    stmt* parser::declaration()
     {
         try {
-            if (match({token_type::FUN})) {
+            if (match(token_type::FUN)) {
                 return function("function");
             }
-            if (match({token_type::VAR})) {
+            if (match(token_type::VAR)) {
                 return var_declaration();
             }
             return statement();
         }
         catch (const std::runtime_error& e){
+            // a call that was being parsed may have left arguments behind
+            m_arguments.clear();
             synchronize();
             return nullptr;
         }
     }
 
-    std::shared_ptr<stmt> parser::var_declaration()
+    stmt* parser::var_declaration()
     {
         auto name = consume(token_type::IDENTIFIER, "Expect variable name.");
-        std::shared_ptr<expr> initializer = nullptr;
-        if (match({token_type::EQUAL})) {
+        expr* initializer = nullptr;
+        if (match(token_type::EQUAL)) {
             initializer = expression();
         }
 
         consume(token_type::SEMICOLON, "Expect ';' after variable declaration.");
-        return std::make_shared<var_stmt>(name, initializer);
+        return m_arena.make<var_stmt>(m_tokens.get(name), initializer);
     }
 
-    std::shared_ptr<stmt> parser::function(std::string kind) {
+    stmt* parser::function(std::string kind) {
         auto name = consume(token_type::IDENTIFIER, "Expect " + kind + " name.");
 
         consume(token_type::LEFT_PAREN, "Expect '(' after " + kind + " name.");
@@ -57,45 +82,50 @@ namespace lox
                     error(peek(), "Can't have more than 255 parameters");
                 }
                 parameters.push_back(
-                    consume(token_type::IDENTIFIER, "Expect parameter name")
+                    m_tokens.get(consume(token_type::IDENTIFIER, "Expect parameter name"))
                 );
             }
-            while(match({token_type::COMMA}));
+            while(match(token_type::COMMA));
         }
         consume(token_type::RIGHT_PAREN, "Expect ')' after parameters.");
         consume(token_type::LEFT_BRACE, "Expect '{' before " + kind + " body.");
         auto body = block();
-        return std::make_shared<function_stmt>(name, parameters, body);
+        return m_arena.make<function_stmt>(m_tokens.get(name),
+            m_arena.make_list(parameters), m_arena.make_list(body));
     }
 
-    std::shared_ptr<stmt> parser::statement()
+    stmt* parser::statement()
     {
-        if (match({token_type::FOR})) {
+        if (match(token_type::FOR)) {
             return for_statement();
         }
 
-        if (match({token_type::IF})) {
+        if (match(token_type::IF)) {
             return if_statement();
         }
 
-        if (match({token_type::PRINT})) {
+        if (match(token_type::PRINT)) {
             return print_statement();
         }
 
-        if (match({token_type::WHILE})) {
+        if (match(token_type::RETURN)) {
+            return return_statement();
+        }
+
+        if (match(token_type::WHILE)) {
             return while_statement();
         }
 
-        if (match({token_type::LEFT_BRACE})) {
-            return std::make_shared<block_stmt>(block());
+        if (match(token_type::LEFT_BRACE)) {
+            return m_arena.make<block_stmt>(m_arena.make_list(block()));
         }
 
         return expr_statement();
     }
 
-    std::vector<std::shared_ptr<stmt>> parser::block()
+    std::vector<stmt*> parser::block()
     {
-        std::vector<std::shared_ptr<stmt>> statements;
+        std::vector<stmt*> statements;
 
         while (not check(token_type::RIGHT_BRACE) && not is_at_end()) {
             statements.push_back(declaration());
@@ -105,67 +135,78 @@ namespace lox
         return statements;
     }
     
-    std::shared_ptr<stmt> parser::if_statement()
+    stmt* parser::if_statement()
     {
         consume(token_type::LEFT_PAREN, "Expect '(' after 'if'.");
         auto condition = expression();
         consume(token_type::RIGHT_PAREN, "Expect ')' after if condition.");
 
         auto then_branch = statement();
-        std::shared_ptr<stmt> else_branch = nullptr;
-        if (match({token_type::ELSE})) {
+        stmt* else_branch = nullptr;
+        if (match(token_type::ELSE)) {
             else_branch = statement();
         }
 
-        return std::make_shared<if_stmt>(condition, then_branch, else_branch);
+        return m_arena.make<if_stmt>(condition, then_branch, else_branch);
     }
 
-    std::shared_ptr<stmt> parser::expr_statement()
+    stmt* parser::expr_statement()
     {
         auto exp = expression();
         consume(token_type::SEMICOLON, "Expect ';' after expression.");
-        return std::make_shared<expression_stmt>(exp);
+        return m_arena.make<expression_stmt>(exp);
     }
     
-    std::shared_ptr<stmt> parser::print_statement()
+    stmt* parser::print_statement()
     {
         auto exp = expression();
         consume(token_type::SEMICOLON, "Expect ';' after expression.");
-        return std::make_shared<print_stmt>(exp);
+        return m_arena.make<print_stmt>(exp);
     }
 
-    std::shared_ptr<stmt> parser::while_statement()
+    stmt* parser::return_statement()
+    {
+        auto keyword = previous();
+        expr* value = nullptr;
+        if (not check(token_type::SEMICOLON)) {
+            value = expression();
+        }
+        consume(token_type::SEMICOLON, "Expect ';' after return value.");
+        return m_arena.make<return_stmt>(m_tokens.get(keyword), value);
+    }
+
+    stmt* parser::while_statement()
     {
         consume(token_type::LEFT_PAREN, "Expect '(' adter 'while'.");
         auto condition = expression();
         consume(token_type::RIGHT_PAREN, "Expect ')' after condition.");
         auto body = statement();
 
-        return std::make_shared<while_stmt>(condition, body);
+        return m_arena.make<while_stmt>(condition, body);
     }
 
-    std::shared_ptr<stmt> parser::for_statement()
+    stmt* parser::for_statement()
     {
         consume(token_type::LEFT_PAREN, "Expect '(' after 'for'.");
 
-        std::shared_ptr<stmt> initializer;
-        if (match({token_type::SEMICOLON})) {
+        stmt* initializer;
+        if (match(token_type::SEMICOLON)) {
             initializer = nullptr;
         }
-        else if (match({token_type::VAR})) {
+        else if (match(token_type::VAR)) {
             initializer = var_declaration();
         }
         else {
             initializer = expr_statement();
         }
 
-        std::shared_ptr<expr> condition = nullptr;
+        expr* condition = nullptr;
         if (not check(token_type::SEMICOLON)) {
             condition = expression();
         }
         consume(token_type::SEMICOLON, "Expect ';' after loop condition.");
 
-        std::shared_ptr<expr> increment = nullptr;
+        expr* increment = nullptr;
         if (not check(token_type::RIGHT_PAREN)) {
             increment = expression();
         }
@@ -177,45 +218,45 @@ namespace lox
         // now we synthesize a for loop out a while loop - aka desugaring
 
         if (increment) {
-            std::vector<std::shared_ptr<stmt>> statements;
+            std::vector<stmt*> statements;
             statements.push_back(body);
-            statements.push_back(std::make_shared<expression_stmt>(increment));
-            body = std::make_shared<block_stmt>(statements);
+            statements.push_back(m_arena.make<expression_stmt>(increment));
+            body = m_arena.make<block_stmt>(m_arena.make_list(statements));
         }
 
         if (condition == nullptr) {
-            condition = std::make_shared<literal_expr>(true);
+            condition = m_arena.make<literal_expr>(true);
         }
-        body = std::make_shared<while_stmt>(condition, body);
+        body = m_arena.make<while_stmt>(condition, body);
 
         if (initializer) {
-            std::vector<std::shared_ptr<stmt>> statements;
+            std::vector<stmt*> statements;
 
             statements.push_back(initializer);
             statements.push_back(body);
-            body = std::make_shared<block_stmt>(statements);
+            body = m_arena.make<block_stmt>(m_arena.make_list(statements));
         }
 
         return body;
     }
 
-    std::shared_ptr<expr> parser::expression()
+    expr* parser::expression()
     {
         return assignment();
     }
 
-    std::shared_ptr<expr> parser::assignment()
+    expr* parser::assignment()
     {
-        auto exp = logic_or();
+        auto exp = parse_precedence(precedence::OR);
 
-        if (match({token_type::EQUAL})) {
+        if (match(token_type::EQUAL)) {
             auto equals = previous();
             auto value = assignment();
 
-            variable_expr* var_exp = dynamic_cast<variable_expr*>(exp.get());
+            variable_expr* var_exp = dynamic_cast<variable_expr*>(exp);
             if (var_exp){
                 auto name = var_exp->m_name;
-                return std::make_shared<assign_expr>(name, value);
+                return m_arena.make<assign_expr>(name, value);
             }
 
             error(equals, "Invalid assignment target.");
@@ -224,163 +265,141 @@ namespace lox
         return exp;
     }
 
-    std::shared_ptr<expr> parser::logic_or()
-    {
-        auto expr = logic_and();
-
-        while (match({token_type::OR})) {
-            auto op = previous();
-            auto right = logic_and();
-            expr = std::make_shared<logical_expr>(expr, op, right);
-        }
-
-        return expr;
-    }
-
-    std::shared_ptr<expr> parser::logic_and()
+    const parser::parse_rule& parser::rule(token_type type)
     {
-        auto expr = equality();
-
-        while (match({token_type::AND})) {
-            auto op = previous();
-            auto right = equality();
-            expr = std::make_shared<logical_expr>(expr, op, right);
-        }
-
-        return expr;
-    }
-
-    std::shared_ptr<expr> parser::equality()
+        static const auto rules = [] {
+            std::array<parse_rule, static_cast<size_t>(token_type::END_OF_FILE) + 1> table{};
+            auto set = [&table](token_type type, prefix_fn prefix, infix_fn infix, precedence prec) {
+                table[static_cast<size_t>(type)] = {prefix, infix, prec};
+            };
+
+            set(token_type::LEFT_PAREN, &parser::grouping, &parser::finish_call, precedence::CALL);
+            set(token_type::MINUS, &parser::unary, &parser::binary, precedence::TERM);
+            set(token_type::PLUS, nullptr, &parser::binary, precedence::TERM);
+            set(token_type::SLASH, nullptr, &parser::binary, precedence::FACTOR);
+            set(token_type::STAR, nullptr, &parser::binary, precedence::FACTOR);
+            set(token_type::BANG, &parser::unary, nullptr, precedence::NONE);
+            set(token_type::BANG_EQUAL, nullptr, &parser::binary, precedence::EQUALITY);
+            set(token_type::EQUAL_EQUAL, nullptr, &parser::binary, precedence::EQUALITY);
+            set(token_type::GREATER, nullptr, &parser::binary, precedence::COMPARISON);
+            set(token_type::GREATER_EQUAL, nullptr, &parser::binary, precedence::COMPARISON);
+            set(token_type::LESS, nullptr, &parser::binary, precedence::COMPARISON);
+            set(token_type::LESS_EQUAL, nullptr, &parser::binary, precedence::COMPARISON);
+            set(token_type::IDENTIFIER, &parser::variable, nullptr, precedence::NONE);
+            set(token_type::STRING, &parser::literal, nullptr, precedence::NONE);
+            set(token_type::NUMBER, &parser::literal, nullptr, precedence::NONE);
+            set(token_type::AND, nullptr, &parser::logical, precedence::AND);
+            set(token_type::OR, nullptr, &parser::logical, precedence::OR);
+            set(token_type::FALSE, &parser::literal, nullptr, precedence::NONE);
+            set(token_type::TRUE, &parser::literal, nullptr, precedence::NONE);
+            set(token_type::NIL, &parser::literal, nullptr, precedence::NONE);
+            return table;
+        }();
+
+        return rules[static_cast<size_t>(type)];
+    }
+
+    expr* parser::parse_precedence(precedence lowest)
     {
-        auto expr = comparison();
-        while (match({token_type::BANG_EQUAL, token_type::EQUAL_EQUAL})) {
-            token op = previous();
-            auto right = comparison();
-            expr = std::make_shared<binary_expr>(expr, op, right);
+        auto prefix = rule(m_tokens.type(peek())).prefix;
+        if (prefix == nullptr) {
+            throw error(peek(), "Expect expression.");
         }
-        return expr;
-    }
+        advance();
+        auto left = (this->*prefix)();
 
-    std::shared_ptr<expr> parser::comparison()
-    {
-        auto expr = term();
-        while (match({token_type::GREATER, token_type::GREATER_EQUAL, token_type::LESS, token_type::LESS_EQUAL})) {
-            token op = previous();
-            auto right = term();
-            expr = std::make_shared<binary_expr>(expr, op, right);
+        // keep folding operators into left while they bind at least as tightly as lowest
+        while (true) {
+            auto& next = rule(m_tokens.type(peek()));
+            if (next.infix == nullptr || next.prec < lowest) {
+                return left;
+            }
+            advance();
+            left = (this->*next.infix)(left);
         }
-        return expr;
     }
 
-    std::shared_ptr<expr> parser::term()
+    parser::precedence parser::tighter(precedence prec)
     {
-        auto expr = factor();
-        while (match({token_type::MINUS, token_type::PLUS})) {
-            token op = previous();
-            auto right = factor();
-            expr = std::make_shared<binary_expr>(expr, op, right);
-        }
-        return expr;
+        return static_cast<precedence>(static_cast<uint8_t>(prec) + 1);
     }
 
-    std::shared_ptr<expr> parser::factor()
+    expr* parser::binary(expr* left)
     {
-        auto expr = unary();
-        while (match({token_type::SLASH, token_type::STAR})) {
-            token op = previous();
-            auto right = unary();
-            expr = std::make_shared<binary_expr>(expr, op, right);
-        }
-        return expr;
+        token op = m_tokens.get(previous());
+        // operands of the same precedence associate to the left
+        auto right = parse_precedence(tighter(rule(op.type).prec));
+        return m_arena.make<binary_expr>(left, op, right);
     }
 
-    std::shared_ptr<expr> parser::unary()
+    expr* parser::logical(expr* left)
     {
-        if (match({token_type::BANG, token_type::MINUS})){
-            token op = previous();
-            auto right = unary();
-            return std::make_shared<unary_expr>(op,right);
-        }
-
-        return call();
+        token op = m_tokens.get(previous());
+        auto right = parse_precedence(tighter(rule(op.type).prec));
+        return m_arena.make<logical_expr>(left, op, right);
     }
 
-    std::shared_ptr<expr> parser::call()
+    expr* parser::unary()
     {
-        auto expr = primary();
-
-        while (true) {
-            if (match({token_type::LEFT_PAREN})) {
-                expr = finish_call(expr);
-            } 
-            else {
-                break;
-            }
-        }
-
-        return expr;
+        token op = m_tokens.get(previous());
+        auto right = parse_precedence(precedence::UNARY);
+        return m_arena.make<unary_expr>(op, right);
     }
 
-    std::shared_ptr<expr> parser::finish_call(std::shared_ptr<expr> callee)
+    expr* parser::finish_call(expr* callee)
     {
-        std::vector<std::shared_ptr<expr>> arguments;
+        // arguments of nested calls stack up above ours, so nothing is allocated per call
+        size_t first = m_arguments.size();
         if (not check(token_type::RIGHT_PAREN)) {
             do {
-                if (arguments.size() >= 255) {
-                    error(peek(), "Can't have more than 255 arguments.");        
+                if (m_arguments.size() - first >= 255) {
+                    error(peek(), "Can't have more than 255 arguments.");
                 }
-                arguments.push_back(expression());
+                auto argument = expression();
+                m_arguments.push_back(argument);
             }
-            while (match({token_type::COMMA}));
+            while (match(token_type::COMMA));
         }
 
         auto paren = consume(token_type::RIGHT_PAREN,
                             "Expect ')' after arguments.");
 
-        return std::make_shared<call_expr>(callee, paren, arguments);
+        auto arguments = m_arena.make_list(m_arguments.data() + first, m_arguments.size() - first);
+        m_arguments.resize(first);
+        return m_arena.make<call_expr>(callee, m_tokens.get(paren), arguments);
     }
 
-    std::shared_ptr<expr> parser::primary()
+    expr* parser::grouping()
     {
-        if (match({token_type::FALSE}))
-        {
-            return std::make_shared<literal_expr>(object(false));
-        }
-
-        if (match({token_type::TRUE}))
-        {
-            return std::make_shared<literal_expr>(object(true));
-        }
-
-        if (match({token_type::NIL}))
-        {
-            return std::make_shared<literal_expr>(object(nullptr));
-        }
-
-        if (match({token_type::NUMBER, token_type::STRING})) {
-            return std::make_shared<literal_expr>(previous().value);
-        }
-
-        if (match({token_type::IDENTIFIER})) {
-            return std::make_shared<variable_expr>(previous());
-        }
+        auto expr = expression();
+        consume(token_type::RIGHT_PAREN, "Expect ')' after expression.");
+        return m_arena.make<grouping_expr>(expr);
+    }
 
-        if (match({token_type::LEFT_PAREN})) {
-            auto expr = expression();
-            consume(token_type::RIGHT_PAREN, "Expect ')' after expression.");
-            return std::make_shared<grouping_expr>(expr);
+    expr* parser::literal()
+    {
+        switch (m_tokens.type(previous())) {
+            case token_type::FALSE:
+                return m_arena.make<literal_expr>(object(false));
+            case token_type::TRUE:
+                return m_arena.make<literal_expr>(object(true));
+            case token_type::NIL:
+                return m_arena.make<literal_expr>(object(nullptr));
+            default:
+                return m_arena.make<literal_expr>(m_tokens.value(previous()));
         }
+    }
 
-        throw error(peek(), "Expect expression.");
+    expr* parser::variable()
+    {
+        return m_arena.make<variable_expr>(m_tokens.get(previous()));
     }
 
-    bool parser::match(std::vector<token_type> types)
+    bool parser::match(token_type type)
     {
-        for (auto type : types) {
-            if (check(type)) {
-                advance();
-                return true;
-            }
+        if (check(type)) {
+            advance();
+            return true;
         }
         return false;
     }
@@ -390,10 +409,10 @@ namespace lox
         if (is_at_end()){
             return false;
         }
-        return peek().type == type;
+        return m_tokens.type(peek()) == type;
     }
 
-    token parser::advance()
+    token_handle parser::advance()
     {
         if (not is_at_end()) {
             m_current++;
@@ -401,19 +420,22 @@ namespace lox
         return previous();
     }
 
-    token parser::peek()
+    token_handle parser::peek()
     {
-        return m_tokens[m_current];
+        if (m_source != nullptr && m_current >= m_tokens.size()) {
+            m_source->next_token(m_tokens);
+        }
+        return m_current;
     }
 
-    token parser::previous()
+    token_handle parser::previous()
     {
-        return m_tokens[m_current - 1];
+        return m_current - 1;
     }
 
     bool parser::is_at_end()
     {
-        return peek().type == token_type::END_OF_FILE;
+        return m_tokens.type(peek()) == token_type::END_OF_FILE;
     }
 
     // consume all tokens until we hit the end of a statement
@@ -422,11 +444,11 @@ namespace lox
     {
         advance();
         while(not is_at_end()) {
-            if (previous().type == token_type::SEMICOLON) {
+            if (m_tokens.type(previous()) == token_type::SEMICOLON) {
                 return;
             }
 
-            switch(peek().type) {
+            switch(m_tokens.type(peek())) {
                 case token_type::CLASS:
                 case token_type::FOR:
                 case token_type::FUN:
@@ -443,7 +465,7 @@ namespace lox
         }
     }
 
-    token parser::consume(token_type type, std::string message)
+    token_handle parser::consume(token_type type, std::string_view message)
     {
         if (check(type)) {
             return advance();
@@ -452,9 +474,9 @@ namespace lox
         throw error(peek(), message);
     }
 
-    std::runtime_error parser::error(token token, std::string message)
+    std::runtime_error parser::error(token_handle handle, std::string_view message)
     {
-        tree_walk::error(token, message);
-        return std::runtime_error(message);
+        tree_walk::error(m_tokens.get(handle), std::string(message));
+        return std::runtime_error(std::string(message));
     }
 }
\ No newline at end of file
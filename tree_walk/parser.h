@@ -1,90 +1,126 @@
 #pragma once
 #include <vector>
-#include <memory>
 #include <exception>
 #include "token.h"
 #include "expr.h"
 #include "stmt.h"
+#include "scanner.h"
+#include "token_buffer.h"
 
 namespace lox
 {
     class parser
     {
         public:
-            parser(std::vector<token> tokens);
-            std::vector<std::shared_ptr<stmt>> parse();
+            // the nodes of the parsed program are allocated in, and owned by, nodes
+            parser(token_buffer tokens, arena& nodes);
+            // pulls tokens from source only as they are needed, see next_declaration
+            parser(scanner& source, arena& nodes);
+            std::vector<stmt*> parse();
+
+            // parses one top-level declaration, dropping the tokens of the previous one.
+            // returns nullptr after a syntax error
+            stmt* next_declaration();
+            bool done();
 
         private:
             // declaration -> var_declaration | statement | function_declaration
-            std::shared_ptr<stmt> declaration();
+            stmt* declaration();
             // var_declaration -> "var" IDENTIFER ( "=" expression )? ";"
-            std::shared_ptr<stmt> var_declaration();
+            stmt* var_declaration();
 
             // function_declaration -> "fun" function
             // function -> IDENTIFIER "(" parameters? ")" block
             // parameters -> IDENTIFIER ( "," IDENTIFIER )*
-            std::shared_ptr<stmt> function(std::string kind);
+            stmt* function(std::string kind);
 
-            // statement -> expr_stmt | print_statement |
+            // statement -> expr_stmt | print_statement | return_statement |
             //              block | if_statement | while_statement |
             //              for_statement
-            std::shared_ptr<stmt> statement();
+            stmt* statement();
             // block -> "{" declaration* "}"
-            std::vector<std::shared_ptr<stmt>> block();
+            std::vector<stmt*> block();
             // if_statement -> "if" "(" expression ")" statement
             //                  ( "else" statment )?
-            std::shared_ptr<stmt> if_statement();
+            stmt* if_statement();
             // expr_statement -> expression ";"
-            std::shared_ptr<stmt> expr_statement();
+            stmt* expr_statement();
             // print_statement -> "print" expression ";"
-            std::shared_ptr<stmt> print_statement();
+            stmt* print_statement();
+            // return_statement -> "return" expression? ";"
+            stmt* return_statement();
             // while_statement -> "while" "(" expression ")" statement
-            std::shared_ptr<stmt> while_statement();
+            stmt* while_statement();
 
             // for_statement -> "for" "(" (var_declaration | expr_statement ";" )
             //                  expression? ";"
             //                  expression? ")" statement
-            std::shared_ptr<stmt> for_statement();
+            stmt* for_statement();
 
             // expression -> assignment
-            std::shared_ptr<expr> expression();
+            expr* expression();
             // assignment -> IDENTIFIER "=" assignment | logic_or
-            std::shared_ptr<expr> assignment();
+            expr* assignment();
             
+            // everything below assignment is parsed by precedence climbing over a table
+            // of rules, one per token type. binding from loosest to tightest:
             // logic_or -> logic_and ( "or" logic_and )*
-            std::shared_ptr<expr> logic_or();
             // logic_and -> equality ( "and" equality )*
-            std::shared_ptr<expr> logic_and();
-
             // equality -> comparison ( ("!=" | "==") comparison )*
-            std::shared_ptr<expr> equality();
             // comparison -> term ( ( ">" | ">= " | "<" | "<=" ) term )*
-            std::shared_ptr<expr> comparison();
             // term -> factor ( ( "-" | "+" ) factor )*
-            std::shared_ptr<expr> term();
             // factor -> unary ( ( "/" | "*" ) unary )*
-            std::shared_ptr<expr> factor();
             // unary -> ( "!" | "-" ) unary | call
-            std::shared_ptr<expr> unary();
             // call -> primary ( "(" arguments? ")")*
-            std::shared_ptr<expr> call();
-            // arguments/finish_call -> expression ( "," expression )*
-            std::shared_ptr<expr> finish_call(std::shared_ptr<expr> callee);
             // primary -> NUMBER | STRING | "true" | "false" | "nil" | "(" expression ")"
-            std::shared_ptr<expr> primary();
+            enum class precedence : uint8_t {
+                NONE, OR, AND, EQUALITY, COMPARISON, TERM, FACTOR, UNARY, CALL
+            };
+
+            // prefix rules run with their token just consumed, infix rules also get
+            // the expression to the left of it
+            using prefix_fn = expr* (parser::*)();
+            using infix_fn = expr* (parser::*)(expr* left);
+
+            struct parse_rule {
+                prefix_fn prefix = nullptr;
+                infix_fn infix = nullptr;
+                precedence prec = precedence::NONE;
+            };
+
+            static const parse_rule& rule(token_type type);
+            static precedence tighter(precedence prec);
+
+            // parses an expression made of operators that bind at least as tightly as lowest
+            expr* parse_precedence(precedence lowest);
+
+            expr* binary(expr* left);
+            expr* logical(expr* left);
+            expr* unary();
+            // arguments/finish_call -> expression ( "," expression )*
+            expr* finish_call(expr* callee);
+            expr* grouping();
+            expr* literal();
+            expr* variable();
 
-            bool match(std::vector<token_type> types);
+            bool match(token_type type);
             bool check(token_type type);
-            token advance();
-            token peek();
-            token previous();
-            token consume(token_type type, std::string message);
+            token_handle advance();
+            token_handle peek();
+            token_handle previous();
+            token_handle consume(token_type type, std::string_view message);
             bool is_at_end();
             void synchronize();
 
-            std::runtime_error error(token token, std::string message);
+            std::runtime_error error(token_handle handle, std::string_view message);
 
-            std::vector<token> m_tokens;
-            int m_current = 0;
+            // tokens stay in the buffer's compact form, a token is only built for ast nodes
+            token_buffer m_tokens;
+            token_handle m_current = 0;
+            // call arguments being parsed, shared by nested calls
+            std::vector<expr*> m_arguments;
+            // null when every token was handed over up front
+            scanner* m_source = nullptr;
+            arena& m_arena;
     };
 }
\ No newline at end of file
@@ -0,0 +1,71 @@
+#include "parser.h"
+#include "scanner.h"
+#include "source_file.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    // expression heavy lox repeated up to the requested size
+    std::string make_source(size_t bytes)
+    {
+        const std::string sample =
+            "var total = (1 + 2) * 3 - 4 / 5 + -6;\n"
+            "var ready = total >= 10 and total != 12 or !(total < 2);\n"
+            "total = total * (total - 1) / (total + 1) + clock();\n"
+            "if (ready == true and total <= 100) print \"ready\" + \"!\";\n"
+            "{ var a = 1; var b = a * 2 + a * 3 - a / 4; print a + b; }\n";
+
+        std::string source;
+        source.reserve(bytes + sample.size());
+        while (source.size() < bytes) {
+            source += sample;
+        }
+        return source;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 2) {
+        std::cout << "Usage: parser_bench [script]" << std::endl;
+        return 64;
+    }
+
+    std::string generated;
+    std::string_view source;
+    lox::source_file file(argc == 2 ? argv[1] : "");
+    if (argc == 2) {
+        if (not file.is_open()) {
+            std::cout << "Could not open " << argv[1] << std::endl;
+            return 74;
+        }
+        source = file.text();
+    }
+    else {
+        generated = make_source(8 * 1024 * 1024);
+        source = generated;
+    }
+
+    lox::scanner scn(source);
+    auto tokens = scn.scan_tokens();
+
+    // only the parse is timed, not copying the tokens in or freeing the tree
+    const int repeats = 5;
+    std::chrono::duration<double> elapsed{0};
+    for (int i = 0; i < repeats; i++) {
+        lox::arena nodes;
+        lox::parser psr(tokens, nodes);
+
+        auto start = std::chrono::steady_clock::now();
+        auto statements = psr.parse();
+        elapsed += std::chrono::steady_clock::now() - start;
+    }
+
+    double millions = static_cast<double>(tokens.size()) * repeats / 1e6;
+    std::cout << tokens.size() << " tokens, "
+        << millions / elapsed.count() << " M tokens/s" << std::endl;
+    return 0;
+}
@@ -0,0 +1,298 @@
+#include "resolver.h"
+#include "native_funcs.h"
+#include "tree_walk.h"
+#include <algorithm>
+
+namespace lox
+{
+    namespace
+    {
+        bool declares_anything(const block_stmt* block)
+        {
+            return std::any_of(block->m_statements.begin(), block->m_statements.end(), [](stmt* inner) {
+                return dynamic_cast<var_stmt*>(inner) || dynamic_cast<function_stmt*>(inner);
+            });
+        }
+    }
+
+    resolver::resolver()
+    {
+        for (auto& native : native_functions()) {
+            m_globals.insert(native.first);
+        }
+    }
+
+    void resolver::resolve(const std::vector<stmt*>& statements)
+    {
+        // globals can be used before they are declared (from inside a function body),
+        // so collect them all before checking any references
+        for (auto& statement : statements) {
+            if (auto declaration = dynamic_cast<var_stmt*>(statement)) {
+                m_globals.emplace(declaration->m_name.lexeme);
+            }
+            else if (auto declaration = dynamic_cast<function_stmt*>(statement)) {
+                m_globals.emplace(declaration->m_name.lexeme);
+            }
+        }
+
+        for (auto& statement : statements) {
+            resolve(statement);
+        }
+    }
+
+    void resolver::defer_global_checks(bool defer)
+    {
+        m_defer_global_checks = defer;
+    }
+
+    object resolver::visit_assign(assign_expr* exp)
+    {
+        resolve(exp->m_value);
+        resolve_local(exp->m_name, exp->m_depth, exp->m_slot, exp->m_upvalue);
+        return object(nullptr);
+    }
+
+    object resolver::visit_binary(binary_expr* exp)
+    {
+        resolve(exp->m_left);
+        resolve(exp->m_right);
+        return object(nullptr);
+    }
+
+    object resolver::visit_grouping(grouping_expr* exp)
+    {
+        resolve(exp->m_expression);
+        return object(nullptr);
+    }
+
+    object resolver::visit_literal(literal_expr* exp)
+    {
+        return object(nullptr);
+    }
+
+    object resolver::visit_variable(variable_expr* exp)
+    {
+        resolve_local(exp->m_name, exp->m_depth, exp->m_slot, exp->m_upvalue);
+        return object(nullptr);
+    }
+
+    object resolver::visit_unary(unary_expr* exp)
+    {
+        resolve(exp->m_right);
+        return object(nullptr);
+    }
+
+    object resolver::visit_logical(logical_expr* exp)
+    {
+        resolve(exp->m_left);
+        resolve(exp->m_right);
+        return object(nullptr);
+    }
+
+    object resolver::visit_call(call_expr* exp)
+    {
+        resolve(exp->m_callee);
+        for (auto& argument : exp->m_arguments) {
+            resolve(argument);
+        }
+        return object(nullptr);
+    }
+
+    void resolver::visit_print(print_stmt* statement)
+    {
+        resolve(statement->m_expression);
+    }
+
+    void resolver::visit_expression(expression_stmt* statement)
+    {
+        resolve(statement->m_expression);
+    }
+
+    void resolver::visit_var(var_stmt* statement)
+    {
+        // the initializer is evaluated before the variable is defined, so
+        // `var a = a;` in a block reads the a from the enclosing scope
+        if (statement->m_initializer) {
+            resolve(statement->m_initializer);
+        }
+        statement->m_slot = declare(statement->m_name);
+    }
+
+    void resolver::visit_block(block_stmt* statement)
+    {
+        // a block that declares nothing isn't given a scope, so it needs no environment
+        // and doesn't count towards the depth of anything inside it
+        if (not declares_anything(statement)) {
+            for (auto& inner : statement->m_statements) {
+                resolve(inner);
+            }
+            statement->m_slot_names.clear();
+            statement->m_captured = false;
+            return;
+        }
+
+        begin_scope();
+        for (auto& inner : statement->m_statements) {
+            resolve(inner);
+        }
+        statement->m_captured = m_captured.back();
+        statement->m_slot_names = end_scope();
+    }
+
+    void resolver::visit_if(if_stmt* statement)
+    {
+        resolve(statement->m_condition);
+        resolve(statement->m_then_branch);
+        if (statement->m_else_branch) {
+            resolve(statement->m_else_branch);
+        }
+    }
+
+    void resolver::visit_while(while_stmt* statement)
+    {
+        resolve(statement->m_condition);
+        resolve(statement->m_body);
+    }
+
+    void resolver::visit_function(function_stmt* statement)
+    {
+        // declared first so the body can call itself
+        statement->m_slot = declare(statement->m_name);
+        statement->m_upvalues.clear();
+        m_functions.push_back({statement, m_scopes.size()});
+
+        // parameters and the body share one scope, same as in crafting interpreters
+        begin_scope();
+        int index = 0;
+        for (auto& param : statement->m_params) {
+            if (declare(param) != index++) {
+                tree_walk::error(param, "Already a variable with this name in this scope.");
+            }
+        }
+        for (auto& inner : statement->m_body) {
+            resolve(inner);
+        }
+        statement->m_captured = m_captured.back();
+        statement->m_slot_names = end_scope();
+        m_functions.pop_back();
+    }
+
+    void resolver::visit_return(return_stmt* statement)
+    {
+        if (m_functions.empty()) {
+            tree_walk::error(statement->m_keyword, "Can't return from top-level code.");
+        }
+        if (statement->m_value) {
+            resolve(statement->m_value);
+
+            auto value = statement->m_value;
+            while (auto grouping = dynamic_cast<grouping_expr*>(value)) {
+                value = grouping->m_expression;
+            }
+            if (auto call = dynamic_cast<call_expr*>(value)) {
+                call->m_tail = true;
+            }
+        }
+    }
+
+    void resolver::resolve(expr* exp)
+    {
+        exp->accept(this);
+    }
+
+    void resolver::resolve(stmt* statement)
+    {
+        statement->accept(this);
+    }
+
+    void resolver::begin_scope()
+    {
+        m_scopes.emplace_back();
+        m_captured.push_back(false);
+    }
+
+    std::vector<std::string> resolver::end_scope()
+    {
+        auto& scope = m_scopes.back();
+        std::vector<std::string> slot_names(scope.size());
+        for (auto& entry : scope) {
+            slot_names[entry.second] = entry.first;
+        }
+
+        m_scopes.pop_back();
+        m_captured.pop_back();
+        return slot_names;
+    }
+
+    int resolver::declare(const token& name)
+    {
+        if (m_scopes.empty()) {
+            m_globals.emplace(name.lexeme);
+            return -1;
+        }
+
+        // redeclaring in the same block reuses the slot, the environment would
+        // just overwrite the existing entry
+        auto& scope = m_scopes.back();
+        auto find_iter = scope.find(name.lexeme);
+        if (find_iter != scope.end()) {
+            return find_iter->second;
+        }
+
+        int slot = static_cast<int>(scope.size());
+        scope.emplace(name.lexeme, slot);
+        return slot;
+    }
+
+    void resolver::resolve_local(const token& name, int& depth, int& slot, int& upvalue)
+    {
+        upvalue = -1;
+        for (int i = static_cast<int>(m_scopes.size()) - 1; i >= 0; i--) {
+            auto find_iter = m_scopes[i].find(name.lexeme);
+            if (find_iter != m_scopes[i].end()) {
+                depth = static_cast<int>(m_scopes.size()) - 1 - i;
+                slot = find_iter->second;
+                // outside the current function, so it has to be captured
+                if (not m_functions.empty() && static_cast<size_t>(i) < m_functions.back().m_scope_base) {
+                    upvalue = resolve_upvalue(m_functions.size() - 1, i, slot);
+                }
+                return;
+            }
+        }
+
+        depth = -1;
+        slot = -1;
+        if (not m_defer_global_checks && m_globals.find(name.lexeme) == m_globals.end()) {
+            tree_walk::error(name, "Undefined variable '" + std::string(name.lexeme) + "'.");
+        }
+    }
+
+    int resolver::resolve_upvalue(size_t function, size_t scope, int slot)
+    {
+        auto& current = m_functions[function];
+
+        // either the function the declaration is in owns the variable, or that
+        // function has to capture it too so this one can take it from there
+        function_stmt::capture capture;
+        size_t enclosing_base = function == 0 ? 0 : m_functions[function - 1].m_scope_base;
+        if (scope >= enclosing_base) {
+            capture = {true, static_cast<int>(current.m_scope_base - 1 - scope), slot, -1};
+            m_captured[scope] = true;
+        }
+        else {
+            capture = {false, -1, -1, resolve_upvalue(function - 1, scope, slot)};
+        }
+
+        // every use of a variable shares one upvalue
+        auto& upvalues = current.m_function->m_upvalues;
+        for (size_t i = 0; i < upvalues.size(); i++) {
+            auto& existing = upvalues[i];
+            if (existing.m_is_local == capture.m_is_local && existing.m_depth == capture.m_depth &&
+                existing.m_slot == capture.m_slot && existing.m_index == capture.m_index) {
+                return static_cast<int>(i);
+            }
+        }
+        upvalues.push_back(capture);
+        return static_cast<int>(upvalues.size() - 1);
+    }
+}
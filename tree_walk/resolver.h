@@ -0,0 +1,76 @@
+#pragma once
+#include <map>
+#include <set>
+#include <string>
+#include <vector>
+#include "expr.h"
+#include "stmt.h"
+
+namespace lox
+{
+    // runs between the parser and the interpreter, binding every variable reference
+    // to the scope it will be found in at runtime so lookups don't have to search for it
+    class resolver : public expr_visitor, stmt_visitor
+    {
+        public:
+            resolver();
+
+            // annotates the statements in place, reports unresolvable names as errors
+            void resolve(const std::vector<stmt*>& statements);
+
+            // when the program arrives a declaration at a time a global may be declared
+            // further on, so unknown names are left for the runtime to report
+            void defer_global_checks(bool defer);
+
+            object visit_assign(assign_expr* exp) override;
+            object visit_binary(binary_expr* exp) override;
+            object visit_grouping(grouping_expr* exp) override;
+            object visit_literal(literal_expr* exp) override;
+            object visit_variable(variable_expr* exp) override;
+            object visit_unary(unary_expr* exp) override;
+            object visit_logical(logical_expr* exp) override;
+            object visit_call(call_expr* exp) override;
+
+            void visit_print(print_stmt* statement) override;
+            void visit_expression(expression_stmt* statement) override;
+            void visit_var(var_stmt* statement) override;
+            void visit_block(block_stmt* statement) override;
+            void visit_if(if_stmt* statement) override;
+            void visit_while(while_stmt* statement) override;
+            void visit_function(function_stmt* statement) override;
+            void visit_return(return_stmt* statement) override;
+
+        private:
+            void resolve(expr* exp);
+            void resolve(stmt* statement);
+
+            void begin_scope();
+            // returns the slot name of each variable declared in the scope
+            std::vector<std::string> end_scope();
+            // returns the slot the name was given, -1 for globals
+            int declare(const token& name);
+            // sets depth and slot, both stay -1 when the name is a global. upvalue is set
+            // when the variable belongs to a function enclosing the current one
+            void resolve_local(const token& name, int& depth, int& slot, int& upvalue);
+            // the current function's upvalue for a variable in scope, adding it and the
+            // upvalues of the functions in between when they don't have it yet
+            int resolve_upvalue(size_t function, size_t scope, int slot);
+
+            // name -> slot for every block currently being resolved, innermost last
+            std::vector<std::map<std::string, int, std::less<>>> m_scopes;
+            // whether a closure captures any variable of the scope at the same index
+            std::vector<bool> m_captured;
+
+            // the functions being resolved, innermost last, with the index in m_scopes
+            // of each one's own scope
+            struct function_scope {
+                function_stmt* m_function;
+                size_t m_scope_base;
+            };
+            std::vector<function_scope> m_functions;
+
+            // every global the program could define, kept between runs for the prompt
+            std::set<std::string, std::less<>> m_globals;
+            bool m_defer_global_checks = false;
+    };
+}
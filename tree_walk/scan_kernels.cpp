@@ -0,0 +1,279 @@
+#include "scan_kernels.h"
+
+#if defined(__x86_64__)
+#include <immintrin.h>
+#endif
+
+namespace lox
+{
+    namespace
+    {
+        const char* scalar_skip_whitespace(const char* begin, const char* end, size_t& newlines)
+        {
+            while (begin < end && (CHAR_CLASSES[static_cast<uint8_t>(*begin)] & WHITESPACE)) {
+                newlines += *begin == '\n';
+                begin++;
+            }
+            return begin;
+        }
+
+        const char* scalar_find_line_end(const char* begin, const char* end)
+        {
+            while (begin < end && *begin != '\n') {
+                begin++;
+            }
+            return begin;
+        }
+
+        const char* scalar_find_string_end(const char* begin, const char* end, size_t& newlines)
+        {
+            while (begin < end && *begin != '"') {
+                newlines += *begin == '\n';
+                begin++;
+            }
+            return begin;
+        }
+
+        const char* scalar_find_identifier_end(const char* begin, const char* end)
+        {
+            while (begin < end && (CHAR_CLASSES[static_cast<uint8_t>(*begin)] & (ALPHA | DIGIT))) {
+                begin++;
+            }
+            return begin;
+        }
+
+#if defined(__x86_64__)
+        // the bits of mask below index, index is at most 31
+        inline uint32_t bits_before(uint32_t mask, int index)
+        {
+            return mask & ((1u << index) - 1);
+        }
+
+        // --- sse2, always available on x86-64 ---
+
+        inline __m128i sse2_in_range(__m128i chars, char low, char high)
+        {
+            // unsigned (c - low) <= (high - low) done with a signed compare
+            __m128i shifted = _mm_xor_si128(_mm_sub_epi8(chars, _mm_set1_epi8(low)), _mm_set1_epi8(-128));
+            __m128i limit = _mm_set1_epi8(static_cast<char>((high - low) ^ 0x80));
+            return _mm_andnot_si128(_mm_cmpgt_epi8(shifted, limit), _mm_set1_epi8(-1));
+        }
+
+        const char* sse2_skip_whitespace(const char* begin, const char* end, size_t& newlines)
+        {
+            while (end - begin >= 16) {
+                __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+                __m128i lines = _mm_cmpeq_epi8(chars, _mm_set1_epi8('\n'));
+                __m128i space = _mm_or_si128(
+                    _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8(' ')), lines),
+                    _mm_or_si128(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\t')),
+                                 _mm_cmpeq_epi8(chars, _mm_set1_epi8('\r'))));
+
+                uint32_t line_mask = _mm_movemask_epi8(lines);
+                uint32_t other = ~_mm_movemask_epi8(space) & 0xffff;
+                if (other != 0) {
+                    int index = __builtin_ctz(other);
+                    newlines += __builtin_popcount(bits_before(line_mask, index));
+                    return begin + index;
+                }
+                newlines += __builtin_popcount(line_mask);
+                begin += 16;
+            }
+            return scalar_skip_whitespace(begin, end, newlines);
+        }
+
+        const char* sse2_find_line_end(const char* begin, const char* end)
+        {
+            while (end - begin >= 16) {
+                __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+                uint32_t found = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')));
+                if (found != 0) {
+                    return begin + __builtin_ctz(found);
+                }
+                begin += 16;
+            }
+            return scalar_find_line_end(begin, end);
+        }
+
+        const char* sse2_find_string_end(const char* begin, const char* end, size_t& newlines)
+        {
+            while (end - begin >= 16) {
+                __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+                uint32_t quotes = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('"')));
+                uint32_t line_mask = _mm_movemask_epi8(_mm_cmpeq_epi8(chars, _mm_set1_epi8('\n')));
+                if (quotes != 0) {
+                    int index = __builtin_ctz(quotes);
+                    newlines += __builtin_popcount(bits_before(line_mask, index));
+                    return begin + index;
+                }
+                newlines += __builtin_popcount(line_mask);
+                begin += 16;
+            }
+            return scalar_find_string_end(begin, end, newlines);
+        }
+
+        const char* sse2_find_identifier_end(const char* begin, const char* end)
+        {
+            while (end - begin >= 16) {
+                __m128i chars = _mm_loadu_si128(reinterpret_cast<const __m128i*>(begin));
+                // setting 0x20 folds upper case letters onto lower case
+                __m128i letters = sse2_in_range(_mm_or_si128(chars, _mm_set1_epi8(0x20)), 'a', 'z');
+                __m128i digits = sse2_in_range(chars, '0', '9');
+                __m128i underscores = _mm_cmpeq_epi8(chars, _mm_set1_epi8('_'));
+                __m128i identifier = _mm_or_si128(_mm_or_si128(letters, digits), underscores);
+
+                uint32_t other = ~_mm_movemask_epi8(identifier) & 0xffff;
+                if (other != 0) {
+                    return begin + __builtin_ctz(other);
+                }
+                begin += 16;
+            }
+            return scalar_find_identifier_end(begin, end);
+        }
+
+        // --- avx2, only used when the cpu reports it ---
+
+        __attribute__((target("avx2,popcnt")))
+        inline __m256i avx2_in_range(__m256i chars, char low, char high)
+        {
+            __m256i shifted = _mm256_xor_si256(_mm256_sub_epi8(chars, _mm256_set1_epi8(low)), _mm256_set1_epi8(-128));
+            __m256i limit = _mm256_set1_epi8(static_cast<char>((high - low) ^ 0x80));
+            return _mm256_andnot_si256(_mm256_cmpgt_epi8(shifted, limit), _mm256_set1_epi8(-1));
+        }
+
+        __attribute__((target("avx2,popcnt")))
+        const char* avx2_skip_whitespace(const char* begin, const char* end, size_t& newlines)
+        {
+            while (end - begin >= 32) {
+                __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+                __m256i lines = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n'));
+                __m256i space = _mm256_or_si256(
+                    _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8(' ')), lines),
+                    _mm256_or_si256(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\t')),
+                                    _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\r'))));
+
+                uint32_t line_mask = _mm256_movemask_epi8(lines);
+                uint32_t other = ~static_cast<uint32_t>(_mm256_movemask_epi8(space));
+                if (other != 0) {
+                    int index = __builtin_ctz(other);
+                    newlines += __builtin_popcount(bits_before(line_mask, index));
+                    return begin + index;
+                }
+                newlines += __builtin_popcount(line_mask);
+                begin += 32;
+            }
+            return sse2_skip_whitespace(begin, end, newlines);
+        }
+
+        __attribute__((target("avx2,popcnt")))
+        const char* avx2_find_line_end(const char* begin, const char* end)
+        {
+            while (end - begin >= 32) {
+                __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+                uint32_t found = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n')));
+                if (found != 0) {
+                    return begin + __builtin_ctz(found);
+                }
+                begin += 32;
+            }
+            return sse2_find_line_end(begin, end);
+        }
+
+        __attribute__((target("avx2,popcnt")))
+        const char* avx2_find_string_end(const char* begin, const char* end, size_t& newlines)
+        {
+            while (end - begin >= 32) {
+                __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+                uint32_t quotes = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('"')));
+                uint32_t line_mask = _mm256_movemask_epi8(_mm256_cmpeq_epi8(chars, _mm256_set1_epi8('\n')));
+                if (quotes != 0) {
+                    int index = __builtin_ctz(quotes);
+                    newlines += __builtin_popcount(bits_before(line_mask, index));
+                    return begin + index;
+                }
+                newlines += __builtin_popcount(line_mask);
+                begin += 32;
+            }
+            return sse2_find_string_end(begin, end, newlines);
+        }
+
+        __attribute__((target("avx2,popcnt")))
+        const char* avx2_find_identifier_end(const char* begin, const char* end)
+        {
+            while (end - begin >= 32) {
+                __m256i chars = _mm256_loadu_si256(reinterpret_cast<const __m256i*>(begin));
+                __m256i letters = avx2_in_range(_mm256_or_si256(chars, _mm256_set1_epi8(0x20)), 'a', 'z');
+                __m256i digits = avx2_in_range(chars, '0', '9');
+                __m256i underscores = _mm256_cmpeq_epi8(chars, _mm256_set1_epi8('_'));
+                __m256i identifier = _mm256_or_si256(_mm256_or_si256(letters, digits), underscores);
+
+                uint32_t other = ~static_cast<uint32_t>(_mm256_movemask_epi8(identifier));
+                if (other != 0) {
+                    return begin + __builtin_ctz(other);
+                }
+                begin += 32;
+            }
+            return sse2_find_identifier_end(begin, end);
+        }
+#endif
+    }
+
+    const scan_kernels& scalar_scan_kernels()
+    {
+        static const scan_kernels kernels = {
+            "scalar",
+            scalar_skip_whitespace,
+            scalar_find_line_end,
+            scalar_find_string_end,
+            scalar_find_identifier_end
+        };
+        return kernels;
+    }
+
+    const scan_kernels* sse2_scan_kernels()
+    {
+#if defined(__x86_64__)
+        static const scan_kernels kernels = {
+            "sse2",
+            sse2_skip_whitespace,
+            sse2_find_line_end,
+            sse2_find_string_end,
+            sse2_find_identifier_end
+        };
+        return &kernels;
+#else
+        return nullptr;
+#endif
+    }
+
+    const scan_kernels* avx2_scan_kernels()
+    {
+#if defined(__x86_64__)
+        static const scan_kernels kernels = {
+            "avx2",
+            avx2_skip_whitespace,
+            avx2_find_line_end,
+            avx2_find_string_end,
+            avx2_find_identifier_end
+        };
+        if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("popcnt")) {
+            return &kernels;
+        }
+#endif
+        return nullptr;
+    }
+
+    const scan_kernels& best_scan_kernels()
+    {
+        static const scan_kernels& kernels = []() -> const scan_kernels& {
+            if (auto avx2 = avx2_scan_kernels()) {
+                return *avx2;
+            }
+            if (auto sse2 = sse2_scan_kernels()) {
+                return *sse2;
+            }
+            return scalar_scan_kernels();
+        }();
+        return kernels;
+    }
+}
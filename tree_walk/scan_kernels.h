@@ -0,0 +1,59 @@
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+
+namespace lox
+{
+    enum char_class : uint8_t {
+        DIGIT = 1 << 0,
+        ALPHA = 1 << 1,
+        WHITESPACE = 1 << 2
+    };
+
+    constexpr std::array<uint8_t, 256> make_char_classes()
+    {
+        std::array<uint8_t, 256> classes{};
+        for (int c = '0'; c <= '9'; c++) {
+            classes[c] |= DIGIT;
+        }
+        for (int c = 'a'; c <= 'z'; c++) {
+            classes[c] |= ALPHA;
+        }
+        for (int c = 'A'; c <= 'Z'; c++) {
+            classes[c] |= ALPHA;
+        }
+        classes['_'] |= ALPHA;
+        classes[' '] |= WHITESPACE;
+        classes['\t'] |= WHITESPACE;
+        classes['\r'] |= WHITESPACE;
+        classes['\n'] |= WHITESPACE;
+        return classes;
+    }
+
+    inline constexpr std::array<uint8_t, 256> CHAR_CLASSES = make_char_classes();
+
+    // the scanner's inner loops, each returns a pointer to the first character
+    // that isn't part of the run (or end) and never reads past end
+    struct scan_kernels
+    {
+        const char* name;
+
+        // spaces, tabs, carriage returns and newlines, counting the newlines
+        const char* (*skip_whitespace)(const char* begin, const char* end, size_t& newlines);
+        // the '\n' that ends a comment
+        const char* (*find_line_end)(const char* begin, const char* end);
+        // the closing '"' of a string, counting the newlines inside it
+        const char* (*find_string_end)(const char* begin, const char* end, size_t& newlines);
+        // the first character that can't continue an identifier
+        const char* (*find_identifier_end)(const char* begin, const char* end);
+    };
+
+    const scan_kernels& scalar_scan_kernels();
+    // these return nullptr when the cpu or the build doesn't support them
+    const scan_kernels* sse2_scan_kernels();
+    const scan_kernels* avx2_scan_kernels();
+
+    // the fastest set the cpu supports, picked once per process
+    const scan_kernels& best_scan_kernels();
+}
@@ -1,22 +1,132 @@
 #include "scanner.h"
 #include "tree_walk.h"
+#include "string_table.h"
+#include "scan_kernels.h"
+#include <algorithm>
+#include <array>
+#include <charconv>
+#include <cstdint>
 
 namespace lox
 {
-    scanner::scanner(std::string source) :
-        m_source(source)
+    namespace
     {
+        struct keyword {
+            std::string_view text;
+            token_type type;
+        };
+
+        constexpr keyword KEYWORDS[] = {
+            {"and", token_type::AND},
+            {"class", token_type::CLASS},
+            {"else", token_type::ELSE},
+            {"false", token_type::FALSE},
+            {"for", token_type::FOR},
+            {"fun", token_type::FUN},
+            {"if", token_type::IF},
+            {"nil", token_type::NIL},
+            {"or", token_type::OR},
+            {"print", token_type::PRINT},
+            {"return", token_type::RETURN},
+            {"super", token_type::SUPER},
+            {"this", token_type::THIS},
+            {"true", token_type::TRUE},
+            {"var", token_type::VAR},
+            {"while", token_type::WHILE}
+        };
+
+        // the first character, last character and length are enough to tell all
+        // sixteen keywords apart, so this is a perfect hash into a 32 entry table
+        constexpr size_t KEYWORD_TABLE_SIZE = 32;
+
+        constexpr size_t keyword_hash(std::string_view text)
+        {
+            return (static_cast<uint8_t>(text.front()) +
+                    static_cast<uint8_t>(text.back()) * 5 +
+                    text.size()) & (KEYWORD_TABLE_SIZE - 1);
+        }
+
+        constexpr std::array<keyword, KEYWORD_TABLE_SIZE> make_keyword_table()
+        {
+            std::array<keyword, KEYWORD_TABLE_SIZE> table{};
+            for (auto& entry : table) {
+                entry = {"", token_type::IDENTIFIER};
+            }
+            for (auto& entry : KEYWORDS) {
+                table[keyword_hash(entry.text)] = entry;
+            }
+            return table;
+        }
+
+        constexpr std::array<keyword, KEYWORD_TABLE_SIZE> KEYWORD_TABLE = make_keyword_table();
+
+        constexpr bool keyword_hash_is_perfect()
+        {
+            for (auto& entry : KEYWORDS) {
+                if (KEYWORD_TABLE[keyword_hash(entry.text)].text != entry.text) {
+                    return false;
+                }
+            }
+            return true;
+        }
+
+        static_assert(keyword_hash_is_perfect(), "two keywords share a slot, pick a new hash");
+
+        token_type identifier_type(std::string_view text)
+        {
+            // keywords are two to six characters long
+            if (text.size() < 2 || text.size() > 6) {
+                return token_type::IDENTIFIER;
+            }
+
+            auto& entry = KEYWORD_TABLE[keyword_hash(text)];
+            return entry.text == text ? entry.type : token_type::IDENTIFIER;
+        }
     }
 
-    std::vector<token> scanner::scan_tokens()
+    scanner::scanner(std::string_view source) :
+        scanner(source, best_scan_kernels())
     {
+    }
+
+    scanner::scanner(std::string_view source, const scan_kernels& kernels) :
+        m_source(source),
+        m_kernels(kernels)
+    {
+    }
+
+    token_buffer scanner::scan_tokens()
+    {
+        token_buffer tokens(m_source);
+        // typical scripts average a token every six or seven bytes, guessing
+        // up front saves most of the regrowth on large inputs
+        tokens.reserve(m_source.size() / 6 + 1);
+        m_tokens = &tokens;
+
         while (not is_at_end()) {
             m_start = m_current;
             scan_token();
         }
 
+        m_start = m_current;
         add_token(token_type::END_OF_FILE);
-        return m_tokens;
+        m_tokens = nullptr;
+        return tokens;
+    }
+
+    void scanner::next_token(token_buffer& tokens)
+    {
+        m_tokens = &tokens;
+        size_t count = tokens.size();
+        while (tokens.size() == count) {
+            m_start = m_current;
+            if (is_at_end()) {
+                add_token(token_type::END_OF_FILE);
+                break;
+            }
+            scan_token();
+        }
+        m_tokens = nullptr;
     }
 
     bool scanner::is_at_end()
@@ -59,20 +169,14 @@ namespace lox
         return true;
     }
 
-    void scanner::add_token(token_type type, object value) {
-                token token;
-                token.type = type;
-                token.lexeme = type != token_type::END_OF_FILE ? 
-                    m_source.substr(m_start,m_current-m_start) : "";
-                token.line =  m_line;
-                token.value = value;
-
-                m_tokens.push_back(token);
-            }
+    void scanner::add_token(token_type type, object value)
+    {
+        m_tokens->push(type, m_start, m_current - m_start, std::move(value));
+    }
 
     void scanner::add_token(token_type type)
     {
-        add_token(type, object(nullptr));
+        m_tokens->push(type, m_start, m_current - m_start);
     }
 
     void scanner::scan_token()
@@ -131,9 +235,7 @@ namespace lox
             // longer lexemes
             case '/':
                 if (match('/')) {
-                    while(peek() != '\n' && not is_at_end()) {
-                        advance();
-                    }
+                    m_current = offset_of(m_kernels.find_line_end(position(), source_end()));
                 } else {
                     add_token(token_type::SLASH);
                 }
@@ -145,13 +247,18 @@ namespace lox
                 break;
 
             // whitespace
+            case '\n':
+                m_line++;
+                [[fallthrough]];
             case ' ':
             case '\r':
             case '\t':
-                break;
-
-            case '\n':
-                m_line++;
+                // single spaces between tokens are common, only runs are worth a kernel call
+                if (CHAR_CLASSES[static_cast<uint8_t>(peek())] & WHITESPACE) {
+                    size_t newlines = 0;
+                    m_current = offset_of(m_kernels.skip_whitespace(position(), source_end(), newlines));
+                    m_line += newlines;
+                }
                 break;
 
             default:
@@ -170,12 +277,9 @@ namespace lox
     }
 
     void scanner::scan_string() {
-        while (peek() != '"' && not is_at_end()) {
-            if (peek() == '\n') {
-                m_line++;
-            }
-            advance();
-        }
+        size_t newlines = 0;
+        m_current = offset_of(m_kernels.find_string_end(position(), source_end(), newlines));
+        m_line += newlines;
 
         if (is_at_end()) {
             tree_walk::error(m_line, "Unterminated string.");
@@ -189,7 +293,7 @@ namespace lox
         int start = m_start + 1;
         int length = m_current - start;
         
-        object value(m_source.substr(start, length - 1));
+        object value(string_table::intern(m_source.substr(start, length - 1)));
         add_token(token_type::STRING, value);
     }
 
@@ -208,59 +312,58 @@ namespace lox
             }
         }
 
-        int length = m_current - m_start;
-        double value = std::stod(m_source.substr(m_start, length));
+        // from_chars parses straight out of the source without building a string
+        double value = 0;
+        std::from_chars(m_source.data() + m_start, m_source.data() + m_current, value);
         add_token(token_type::NUMBER, object(value));
     }
 
     void scanner::scan_identifier()
     {
-        while(is_alphanumeric(peek())) {
-            advance();
+        // most names are short enough that a call into a kernel costs more than it saves
+        size_t inline_end = std::min(m_current + 8, m_source.size());
+        while (m_current < inline_end && is_alphanumeric(m_source[m_current])) {
+            m_current++;
+        }
+        if (m_current == inline_end) {
+            m_current = offset_of(m_kernels.find_identifier_end(position(), source_end()));
         }
 
-        token_type type = token_type::IDENTIFIER;
         int length = m_current - m_start;
-        std::string text = m_source.substr(m_start, length);
-        auto find_iter = KEYWORDS.find(text);
-        if (find_iter != KEYWORDS.end()) {
-            type = find_iter->second;
-        }
+        std::string_view text = m_source.substr(m_start, length);
+        token_type type = identifier_type(text);
 
+        // identifiers are interned when the parser asks for their token
         add_token(type);
     }
 
+    const char* scanner::position()
+    {
+        return m_source.data() + m_current;
+    }
+
+    const char* scanner::source_end()
+    {
+        return m_source.data() + m_source.size();
+    }
+
+    size_t scanner::offset_of(const char* position)
+    {
+        return position - m_source.data();
+    }
+
     bool scanner::is_alpha(char c)
     {
-        return (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || c == '_';
+        return CHAR_CLASSES[static_cast<uint8_t>(c)] & ALPHA;
     }
 
     bool scanner::is_digit(char c)
     {
-        return c >= '0' && c <= '9';
+        return CHAR_CLASSES[static_cast<uint8_t>(c)] & DIGIT;
     }
 
     bool scanner::is_alphanumeric(char c)
     {
-        return is_alpha(c) || is_digit(c);
+        return CHAR_CLASSES[static_cast<uint8_t>(c)] & (ALPHA | DIGIT);
     }
-
-    const std::map<std::string, token_type> scanner::KEYWORDS = {
-        {"and", token_type::AND},
-        {"class", token_type::CLASS},
-        {"else", token_type::ELSE},
-        {"false", token_type::FALSE},
-        {"for", token_type::FOR},
-        {"fun", token_type::FUN},
-        {"if", token_type::IF},
-        {"nil", token_type::NIL},
-        {"or", token_type::OR},
-        {"print", token_type::PRINT},
-        {"return", token_type::RETURN},
-        {"super", token_type::SUPER},
-        {"this", token_type::THIS},
-        {"true", token_type::TRUE},
-        {"var", token_type::VAR},
-        {"while", token_type::WHILE}
-    };
 }
\ No newline at end of file
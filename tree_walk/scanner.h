@@ -1,17 +1,26 @@
 #pragma once
 #include <string>
+#include <string_view>
 #include <vector>
-#include <map>
 #include <memory>
 
 #include "token.h"
+#include "token_buffer.h"
+#include "scan_kernels.h"
 
 namespace lox {
     class scanner
     {
         public:
-            scanner(std::string source);
-            std::vector<token> scan_tokens();
+            // the scanner doesn't copy the source, tokens point straight into it
+            scanner(std::string_view source);
+            // lets benchmarks pin a kernel set instead of the one picked for this cpu
+            scanner(std::string_view source, const scan_kernels& kernels);
+            token_buffer scan_tokens();
+            // appends just the next token, END_OF_FILE once the source runs out
+            void next_token(token_buffer& tokens);
+
+            std::string_view source() const { return m_source; }
 
         private:
             bool is_at_end();
@@ -29,17 +38,21 @@ namespace lox {
             void scan_number();
             void scan_identifier();
 
+            const char* position();
+            const char* source_end();
+            size_t offset_of(const char* position);
+
             bool is_digit(char c);
             bool is_alpha(char c);
             bool is_alphanumeric(char c);
 
-            std::string m_source;
-            std::vector<token> m_tokens;
+            std::string_view m_source;
+            const scan_kernels& m_kernels;
+            // where add_token writes, only set while scanning
+            token_buffer* m_tokens = nullptr;
             
             size_t m_start = 0;
             size_t m_current = 0;
             size_t m_line = 1;
-
-            static const std::map<std::string, token_type> KEYWORDS;
     };
 }
\ No newline at end of file
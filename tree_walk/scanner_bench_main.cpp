@@ -0,0 +1,81 @@
+#include "scanner.h"
+#include "scan_kernels.h"
+#include "source_file.h"
+
+#include <chrono>
+#include <iostream>
+#include <string>
+
+namespace
+{
+    // a few hundred bytes of typical lox repeated up to the requested size
+    std::string make_source(size_t bytes)
+    {
+        const std::string sample =
+            "// running totals for the benchmark\n"
+            "var counter_total = 0;\n"
+            "var message = \"the quick brown fox jumps over the lazy dog\";\n"
+            "while (counter_total < 1000000) {\n"
+            "    if (counter_total >= 500 and message != nil) {\n"
+            "        print message;\n"
+            "    }\n"
+            "    counter_total = counter_total + 1.5;\n"
+            "}\n"
+            "\n";
+
+        std::string source;
+        source.reserve(bytes + sample.size());
+        while (source.size() < bytes) {
+            source += sample;
+        }
+        return source;
+    }
+
+    void bench(std::string_view source, const lox::scan_kernels& kernels, int repeats)
+    {
+        size_t tokens = 0;
+        auto start = std::chrono::steady_clock::now();
+        for (int i = 0; i < repeats; i++) {
+            lox::scanner scn(source, kernels);
+            tokens = scn.scan_tokens().size();
+        }
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+
+        double megabytes = static_cast<double>(source.size()) * repeats / (1024 * 1024);
+        std::cout << kernels.name << ": " << tokens << " tokens, "
+            << megabytes / elapsed.count() << " MB/s" << std::endl;
+    }
+}
+
+int main(int argc, char* argv[])
+{
+    if (argc > 2) {
+        std::cout << "Usage: scanner_bench [script]" << std::endl;
+        return 64;
+    }
+
+    std::string generated;
+    std::string_view source;
+    lox::source_file file(argc == 2 ? argv[1] : "");
+    if (argc == 2) {
+        if (not file.is_open()) {
+            std::cout << "Could not open " << argv[1] << std::endl;
+            return 74;
+        }
+        source = file.text();
+    }
+    else {
+        generated = make_source(16 * 1024 * 1024);
+        source = generated;
+    }
+
+    const int repeats = 5;
+    bench(source, lox::scalar_scan_kernels(), repeats);
+    if (auto sse2 = lox::sse2_scan_kernels()) {
+        bench(source, *sse2, repeats);
+    }
+    if (auto avx2 = lox::avx2_scan_kernels()) {
+        bench(source, *avx2, repeats);
+    }
+    return 0;
+}
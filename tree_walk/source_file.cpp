@@ -0,0 +1,56 @@
+#include "source_file.h"
+#include <fstream>
+#include <sstream>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace lox
+{
+    source_file::source_file(const std::string& path)
+    {
+        int fd = open(path.c_str(), O_RDONLY);
+        if (fd == -1) {
+            return;
+        }
+
+        struct stat info;
+        if (fstat(fd, &info) == 0 && S_ISREG(info.st_mode)) {
+            m_open = true;
+            if (info.st_size == 0) {
+                // mmap refuses empty mappings, an empty view is just as good
+                close(fd);
+                return;
+            }
+
+            void* mapping = mmap(nullptr, info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+            if (mapping != MAP_FAILED) {
+                // the scanner reads the file front to back
+                madvise(mapping, info.st_size, MADV_SEQUENTIAL);
+                m_mapping = mapping;
+                m_mapping_size = info.st_size;
+                m_text = std::string_view(static_cast<const char*>(mapping), m_mapping_size);
+                close(fd);
+                return;
+            }
+        }
+        close(fd);
+
+        std::ifstream file(path, std::ifstream::in | std::ifstream::binary);
+        if (file.is_open()) {
+            std::stringstream contents;
+            contents << file.rdbuf();
+            m_fallback = contents.str();
+            m_text = m_fallback;
+            m_open = true;
+        }
+    }
+
+    source_file::~source_file()
+    {
+        if (m_mapping != nullptr) {
+            munmap(m_mapping, m_mapping_size);
+        }
+    }
+}
@@ -0,0 +1,29 @@
+#pragma once
+#include <string>
+#include <string_view>
+
+namespace lox
+{
+    // a script mapped read-only into memory, the scanner and parser work on
+    // views of the mapping so the file's contents are never copied
+    class source_file
+    {
+        public:
+            source_file(const std::string& path);
+            ~source_file();
+
+            source_file(const source_file&) = delete;
+            source_file& operator=(const source_file&) = delete;
+
+            bool is_open() const { return m_open; }
+            std::string_view text() const { return m_text; }
+
+        private:
+            bool m_open = false;
+            void* m_mapping = nullptr;
+            size_t m_mapping_size = 0;
+            // used when the file can't be mapped, e.g. it's a pipe
+            std::string m_fallback;
+            std::string_view m_text;
+    };
+}
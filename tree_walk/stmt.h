@@ -1,8 +1,10 @@
 #pragma once
 #include <memory>
+#include <string>
 #include <vector>
 #include "token.h"
 #include "expr.h"
+#include "arena.h"
 
 namespace lox
 {
@@ -13,6 +15,8 @@ namespace lox
     class if_stmt;
     class while_stmt;
     class function_stmt;
+    class return_stmt;
+    class jit_loop;
 
     class stmt_visitor
     {
@@ -24,6 +28,7 @@ namespace lox
             virtual void visit_if(if_stmt*) = 0;
             virtual void visit_while(while_stmt*) = 0;
             virtual void visit_function(function_stmt*) = 0;
+            virtual void visit_return(return_stmt*) = 0;
     };
 
     class stmt
@@ -35,7 +40,7 @@ namespace lox
     class expression_stmt : public stmt
     {
         public:
-            expression_stmt(std::shared_ptr<expr> expression) {
+            expression_stmt(expr* expression) {
                 m_expression = expression;
             }
 
@@ -44,13 +49,13 @@ namespace lox
                 visitor->visit_expression(this);
             }
 
-            std::shared_ptr<expr> m_expression;
+            expr* m_expression;
     };
 
     class print_stmt : public stmt
     {
         public:
-            print_stmt(std::shared_ptr<expr> expression) {
+            print_stmt(expr* expression) {
                 m_expression = expression;
             }
 
@@ -59,13 +64,13 @@ namespace lox
                 visitor->visit_print(this);
             }
 
-            std::shared_ptr<expr> m_expression;
+            expr* m_expression;
     };
 
     class var_stmt : public stmt
     {
         public:
-            var_stmt(token token, std::shared_ptr<expr> initializer)
+            var_stmt(token token, expr* initializer)
             {
                 m_name = token;
                 m_initializer = initializer;
@@ -77,13 +82,16 @@ namespace lox
             }
 
             token m_name;
-            std::shared_ptr<expr> m_initializer;
+            expr* m_initializer;
+
+            // set by the resolver, -1 for globals
+            int m_slot = -1;
     };
 
     class block_stmt : public stmt
     {
         public:
-            block_stmt(std::vector<std::shared_ptr<stmt>> statements)
+            block_stmt(node_list<stmt*> statements)
             {
                 m_statements = statements;
             }
@@ -93,15 +101,24 @@ namespace lox
                 visitor->visit_block(this);
             }
 
-            std::vector<std::shared_ptr<stmt>> m_statements;
+            node_list<stmt*> m_statements;
+
+            // set by the resolver, the name of each variable the block declares by slot.
+            // a block that declares nothing isn't a scope at all, so every pass that
+            // follows depth and slot numbers has to skip it
+            std::vector<std::string> m_slot_names;
+            // set by the resolver when a closure captures one of the block's variables
+            bool m_captured = false;
+
+            bool is_scope() const { return not m_slot_names.empty(); }
     };
 
     class if_stmt : public stmt
     {
         public:
-            if_stmt(std::shared_ptr<expr> condition,
-                    std::shared_ptr<stmt> then_branch,
-                    std::shared_ptr<stmt> else_branch) {
+            if_stmt(expr* condition,
+                    stmt* then_branch,
+                    stmt* else_branch) {
                         m_condition = condition;
                         m_then_branch = then_branch;
                         m_else_branch = else_branch;
@@ -112,15 +129,15 @@ namespace lox
                 visitor->visit_if(this);
             }
 
-            std::shared_ptr<expr> m_condition;
-            std::shared_ptr<stmt> m_then_branch;
-            std::shared_ptr<stmt> m_else_branch;
+            expr* m_condition;
+            stmt* m_then_branch;
+            stmt* m_else_branch;
     };
 
     class while_stmt : public stmt
     {
         public:
-            while_stmt(std::shared_ptr<expr> condition, std::shared_ptr<stmt> body)
+            while_stmt(expr* condition, stmt* body)
             {
                 m_condition = condition;
                 m_body = body;
@@ -131,14 +148,19 @@ namespace lox
                 visitor->visit_while(this);
             }
 
-            std::shared_ptr<expr> m_condition;
-            std::shared_ptr<stmt> m_body;
+            expr* m_condition;
+            stmt* m_body;
+
+            // used by the interpreter's jit, trips round the loop so far and the
+            // machine code once it has been compiled
+            uint32_t m_back_edges = 0;
+            std::shared_ptr<jit_loop> m_jit_loop;
     };
 
     class function_stmt : public stmt
     {
         public:
-            function_stmt(token name, std::vector<token> params, std::vector<std::shared_ptr<stmt>> body)
+            function_stmt(token name, node_list<token> params, node_list<stmt*> body)
             {
                 m_name = name;
                 m_params = params;
@@ -151,7 +173,46 @@ namespace lox
             }
 
             token m_name;
-            std::vector<token> m_params;
-            std::vector<std::shared_ptr<stmt>> m_body;
+            node_list<token> m_params;
+            node_list<stmt*> m_body;
+
+            // set by the resolver, the slot the function is declared in or -1 for a global
+            int m_slot = -1;
+            // the parameters followed by the locals the body declares outside any block
+            std::vector<std::string> m_slot_names;
+            // set by the resolver when a closure captures a parameter or one of those locals
+            bool m_captured = false;
+
+            // a variable of an enclosing function that the body uses. when it is local to
+            // the function the declaration is in, it's found at depth and slot from where
+            // the declaration runs, otherwise it's that function's upvalue number index
+            struct capture {
+                bool m_is_local;
+                int m_depth;
+                int m_slot;
+                int m_index;
+            };
+            // set by the resolver, only the variables the body and the functions nested in
+            // it actually use, numbered as the variables' m_upvalue
+            std::vector<capture> m_upvalues;
+    };
+
+    class return_stmt : public stmt
+    {
+        public:
+            return_stmt(token keyword, expr* value)
+            {
+                m_keyword = keyword;
+                m_value = value;
+            }
+
+            void accept(stmt_visitor* visitor) override
+            {
+                visitor->visit_return(this);
+            }
+
+            token m_keyword;
+            // nullptr when the function returns nil
+            expr* m_value;
     };
 }
\ No newline at end of file
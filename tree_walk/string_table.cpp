@@ -0,0 +1,114 @@
+#include "string_table.h"
+
+namespace lox
+{
+    static string_object* const TOMBSTONE = reinterpret_cast<string_object*>(1);
+
+    string_table::string_table() :
+        m_slots(64, nullptr)
+    {
+    }
+
+    string_table& string_table::instance()
+    {
+        // never destroyed - strings held by globals can outlive static destruction
+        static string_table* table = new string_table();
+        return *table;
+    }
+
+    string_object* string_table::intern(std::string_view text)
+    {
+        auto& table = instance();
+        uint32_t text_hash = hash(text);
+
+        string_object** slot = table.find_slot(text, text_hash);
+        if (*slot != nullptr && *slot != TOMBSTONE) {
+            return *slot;
+        }
+
+        // keep the load factor under 3/4, counting tombstones as used
+        if (*slot == nullptr && (table.m_used + 1) * 4 > table.m_slots.size() * 3) {
+            table.grow();
+            slot = table.find_slot(text, text_hash);
+        }
+
+        if (*slot == nullptr) {
+            table.m_used++;
+        }
+        *slot = new string_object(std::string(text), text_hash);
+        return *slot;
+    }
+
+    void string_table::remove(string_object* text)
+    {
+        auto& table = instance();
+        string_object** slot = table.find_slot(text->m_value, text->m_hash);
+        if (*slot == text) {
+            *slot = TOMBSTONE;
+        }
+    }
+
+    // FNV-1a
+    uint32_t string_table::hash(std::string_view text)
+    {
+        uint32_t result = 2166136261u;
+        for (char c : text) {
+            result ^= static_cast<uint8_t>(c);
+            result *= 16777619u;
+        }
+        return result;
+    }
+
+    string_object** string_table::find_slot(std::string_view text, uint32_t hash)
+    {
+        size_t mask = m_slots.size() - 1;
+        size_t index = hash & mask;
+        string_object** first_tombstone = nullptr;
+
+        while (true) {
+            string_object*& entry = m_slots[index];
+            if (entry == nullptr) {
+                // reuse a tombstone we passed on the way if there was one
+                return first_tombstone != nullptr ? first_tombstone : &entry;
+            }
+
+            if (entry == TOMBSTONE) {
+                if (first_tombstone == nullptr) {
+                    first_tombstone = &entry;
+                }
+            }
+            else if (entry->m_hash == hash && entry->m_value == text) {
+                return &entry;
+            }
+
+            index = (index + 1) & mask;
+        }
+    }
+
+    void string_table::grow()
+    {
+        size_t live = 0;
+        for (string_object* entry : m_slots) {
+            if (entry != nullptr && entry != TOMBSTONE) {
+                live++;
+            }
+        }
+
+        // if it's mostly tombstones rehashing at the same size is enough
+        size_t size = m_slots.size();
+        if ((live + 1) * 2 > size) {
+            size *= 2;
+        }
+
+        std::vector<string_object*> old_slots(size, nullptr);
+        old_slots.swap(m_slots);
+        m_used = 0;
+
+        for (string_object* entry : old_slots) {
+            if (entry != nullptr && entry != TOMBSTONE) {
+                *find_slot(entry->m_value, entry->m_hash) = entry;
+                m_used++;
+            }
+        }
+    }
+}
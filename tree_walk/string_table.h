@@ -0,0 +1,55 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include "token.h"
+
+namespace lox
+{
+    // every string_object is created through here so there is only ever one
+    // object per distinct string, that makes string equality a pointer compare
+    class string_table
+    {
+        public:
+            // returns the existing object for the text or creates it
+            static string_object* intern(std::string_view text);
+
+            // called by the string_object destructor once nothing refers to it
+            static void remove(string_object* text);
+
+            static uint32_t hash(std::string_view text);
+
+        private:
+            string_table();
+
+            static string_table& instance();
+
+            string_object** find_slot(std::string_view text, uint32_t hash);
+            void grow();
+
+            // open addressing, a slot holds nullptr when empty or TOMBSTONE once removed
+            std::vector<string_object*> m_slots;
+            size_t m_used = 0;
+    };
+
+    // for containers keyed by interned strings, the key object keeps the string alive
+    struct interned_hash
+    {
+        size_t operator()(const object& text) const
+        {
+            return text.as_string()->m_hash;
+        }
+    };
+
+    struct interned_equal
+    {
+        bool operator()(const object& left, const object& right) const
+        {
+            return left.as_string() == right.as_string();
+        }
+    };
+
+    template <typename T>
+    using interned_map = std::unordered_map<object, T, interned_hash, interned_equal>;
+}
@@ -1,247 +1,235 @@
 #include "token.h"
+#include <cstring>
 #include <iostream>
 #include <sstream>
 #include "lox_callable.h"
+#include "string_table.h"
 
 namespace lox
 {
+    static_assert(sizeof(object) == 8, "objects should fit in a register");
+
     const std::string MISMATCH_MSG = "Operand type mismatch.";
     const std::string MUST_BE_NUMBERS_MSG = "Operands must be numbers.";
     const std::string MUST_BE_NUMBERS_OR_STRINGS_MSG = "Operands must be both numbers or both strings.";
     const std::string UNSUPPORTED_MSG = "Unknown operand error";
 
-    object::object()
+    string_object::~string_object()
     {
-        m_type = object_type::nil;
+        string_table::remove(this);
     }
 
-    object::object(std::nullptr_t)
+    object::object(std::string value) :
+        object(string_table::intern(value))
     {
-        m_type = object_type::nil;
     }
 
-    object::object(bool value)
+    object::object(const char* value) :
+        object(string_table::intern(value))
     {
-        m_type = object_type::boolean;
-        m_boolean_value = value;
     }
 
-    object::object(double value)
+    object::object(string_object* text) :
+        object(static_cast<heap_object*>(text))
     {
-        m_type = object_type::number;
-        m_number_value = value;
     }
 
-    object::object(std::string value)
+    object::object(lox_callable* callable) :
+        object(static_cast<heap_object*>(callable))
     {
-        m_type = object_type::text;
-        m_text_value = value;
     }
 
-    object::object(std::shared_ptr<lox_callable> callable)
+    object::object(heap_object* heap)
     {
-        m_type = object_type::callable;
-        m_callable = callable;
+        m_bits = SIGN_BIT | QNAN | reinterpret_cast<uint64_t>(heap);
+        if (heap->m_collected) {
+            m_bits |= COLLECTED_BIT;
+        }
+        retain();
     }
 
-    // in the crafting interpreters book this is the equivalent of the isTruthy function
-    object::operator bool() const
+    object::object_type object::type() const
     {
-        if (m_type == object_type::nil) {
-            return false;
+        if (is_number()) {
+            return object_type::number;
         }
-        else if (m_type == object_type::boolean) {
-            return m_boolean_value;
+        if (is_nil()) {
+            return object_type::nil;
         }
-
-        return true;
+        if (is_boolean()) {
+            return object_type::boolean;
+        }
+        return is_text() ? object_type::text : object_type::callable;
     }
 
-    object object::operator!()
+    const std::string& object::as_text() const
     {
-        bool result = true;
-        switch (m_type) {
-            case object_type::nil:
-            {
-                result = false;
-            } break;
-            case object_type::boolean:
-            {
-                result = m_boolean_value;
-            } break;
-            default:
-                result = true;
-        }
+        return as_string()->m_value;
+    }
 
-        return object(!result);
+    string_object* object::as_string() const
+    {
+        return static_cast<string_object*>(as_heap());
     }
 
-    object object::operator-()
+    lox_callable* object::as_callable() const
     {
-        switch (m_type) {
-            case object_type::number:
-                return object(-m_number_value);
-            default:
-                throw std::logic_error(MUST_BE_NUMBERS_MSG);
-        }
+        return static_cast<lox_callable*>(as_heap());
     }
 
-    object object::operator>(const object& right)
+    // in the crafting interpreters book this is the equivalent of the isTruthy function
+    object object::operator!() const
     {
-        if (m_type != right.m_type) {
-            throw std::logic_error(MISMATCH_MSG);
-        }
+        return object(not static_cast<bool>(*this));
+    }
 
-        switch (m_type) {
-            case object_type::number:
-                return object(m_number_value > right.m_number_value);
-            default:
-                throw std::logic_error(MUST_BE_NUMBERS_MSG);
+    object object::operator-() const
+    {
+        if (is_number()) {
+            return object(-as_number());
         }
+        throw std::logic_error(MUST_BE_NUMBERS_MSG);
     }
 
-    object object::operator>=(const object& right)
+    // the comparison and arithmetic operators check for the common case of two
+    // numbers first, only falling back to inspecting the types when that fails
+    object object::operator>(const object& right) const
     {
-        if (m_type != right.m_type) {
-            throw std::logic_error(MISMATCH_MSG);
+        if (is_number() && right.is_number()) {
+            return object(as_number() > right.as_number());
         }
-
-        switch (m_type) {
-            case object_type::number:
-                return object(m_number_value >= right.m_number_value);
-            default:
-                throw std::logic_error(MUST_BE_NUMBERS_MSG);
+        if (type() != right.type()) {
+            throw std::logic_error(MISMATCH_MSG);
         }
+        throw std::logic_error(MUST_BE_NUMBERS_MSG);
     }
 
-    object object::operator<(const object& right)
+    object object::operator>=(const object& right) const
     {
-        if (m_type != right.m_type) {
-            throw std::logic_error(MISMATCH_MSG);
+        if (is_number() && right.is_number()) {
+            return object(as_number() >= right.as_number());
         }
-
-        switch (m_type) {
-            case object_type::number:
-                return object(m_number_value < right.m_number_value);
-            default:
-                throw std::logic_error(MUST_BE_NUMBERS_MSG);
+        if (type() != right.type()) {
+            throw std::logic_error(MISMATCH_MSG);
         }
+        throw std::logic_error(MUST_BE_NUMBERS_MSG);
     }
 
-    object object::operator<=(const object& right)
+    object object::operator<(const object& right) const
     {
-        if (m_type != right.m_type) {
+        if (is_number() && right.is_number()) {
+            return object(as_number() < right.as_number());
+        }
+        if (type() != right.type()) {
             throw std::logic_error(MISMATCH_MSG);
         }
+        throw std::logic_error(MUST_BE_NUMBERS_MSG);
+    }
 
-        switch (m_type) {
-            case object_type::number:
-                return object(m_number_value <= right.m_number_value);
-            default:
-                throw std::logic_error(MUST_BE_NUMBERS_MSG);
+    object object::operator<=(const object& right) const
+    {
+        if (is_number() && right.is_number()) {
+            return object(as_number() <= right.as_number());
+        }
+        if (type() != right.type()) {
+            throw std::logic_error(MISMATCH_MSG);
         }
+        throw std::logic_error(MUST_BE_NUMBERS_MSG);
     }
 
-    object object::operator==(const object& right)
+    object object::operator==(const object& right) const
     {
-        if (m_type != right.m_type) {
+        if (is_number() && right.is_number()) {
+            return object(as_number() == right.as_number());
+        }
+
+        auto left_type = type();
+        if (left_type != right.type()) {
             return object(false);
         }
 
-        switch (m_type) {
-            case object_type::number:
-                return object(m_number_value == right.m_number_value);
+        switch (left_type) {
+            // strings are interned so equal text means the same object
             case object_type::boolean:
-                return object(m_boolean_value == right.m_boolean_value);
-            case object_type::text:
-                return object(m_text_value == right.m_text_value);
             case object_type::nil:
-                return object(true);
+            case object_type::text:
+                return object(m_bits == right.m_bits);
             // should be unreachable
             default:
                 throw std::logic_error(UNSUPPORTED_MSG);
         }
     }
 
-    object object::operator!=(const object& right)
+    object object::operator!=(const object& right) const
     {
         return !((*this)==right);
     }
 
-    object object::operator-(const object& right)
+    object object::operator-(const object& right) const
     {
-        if (m_type != right.m_type) {
-            throw std::logic_error(MISMATCH_MSG);
+        if (is_number() && right.is_number()) {
+            return object(as_number() - right.as_number());
         }
-
-        switch (m_type) {
-            case object_type::number:
-                return object(m_number_value - right.m_number_value);
-            default:
-                throw std::logic_error(MUST_BE_NUMBERS_MSG);
+        if (type() != right.type()) {
+            throw std::logic_error(MISMATCH_MSG);
         }
+        throw std::logic_error(MUST_BE_NUMBERS_MSG);
     }
 
-    object object::operator+(const object& right)
+    object object::operator+(const object& right) const
     {
-        if (m_type != right.m_type) {
+        if (is_number() && right.is_number()) {
+            return object(as_number() + right.as_number());
+        }
+        if (type() != right.type()) {
             throw std::logic_error(MISMATCH_MSG);
         }
-
-        switch (m_type) {
-            case object_type::number:
-                return object(m_number_value + right.m_number_value);
-            case object_type::text:
-                return object(m_text_value + right.m_text_value);
-            default:
-                throw std::logic_error(MUST_BE_NUMBERS_OR_STRINGS_MSG);
+        if (is_text()) {
+            return object(as_text() + right.as_text());
         }
+        throw std::logic_error(MUST_BE_NUMBERS_OR_STRINGS_MSG);
     }
 
-    object object::operator*(const object& right)
+    object object::operator*(const object& right) const
     {
-        if (m_type != right.m_type) {
-            throw std::logic_error(MISMATCH_MSG);
+        if (is_number() && right.is_number()) {
+            return object(as_number() * right.as_number());
         }
-
-        switch (m_type) {
-            case object_type::number:
-                return object(m_number_value * right.m_number_value);
-            default:
-                throw std::logic_error(MUST_BE_NUMBERS_MSG);
+        if (type() != right.type()) {
+            throw std::logic_error(MISMATCH_MSG);
         }
+        throw std::logic_error(MUST_BE_NUMBERS_MSG);
     }
 
-    object object::operator/(const object& right)
+    object object::operator/(const object& right) const
     {
-        if (m_type != right.m_type) {
-            throw std::logic_error(MISMATCH_MSG);
+        if (is_number() && right.is_number()) {
+            return object(as_number() / right.as_number());
         }
-
-        switch (m_type) {
-            case object_type::number:
-                return object(m_number_value / right.m_number_value);
-            default:
-                throw std::logic_error(MUST_BE_NUMBERS_MSG);
+        if (type() != right.type()) {
+            throw std::logic_error(MISMATCH_MSG);
         }
+        throw std::logic_error(MUST_BE_NUMBERS_MSG);
     }
 
-    std::string object::to_string() 
+    std::string object::to_string() const
     {
-        switch (m_type)
+        switch (type())
         {
             case object_type::boolean:
-                return m_boolean_value ? "true" : "false";
+                return as_boolean() ? "true" : "false";
             case object_type::number:
             {
                 std::stringstream stream;
-                stream << m_number_value;
+                stream << as_number();
                 return stream.str();
             } break;
             case object_type::text:
-                return m_text_value;
+                return as_text();
+            case object_type::callable:
+                return as_callable()->to_string();
             default:
                 return "nil";
         }
     }
-}
\ No newline at end of file
+}
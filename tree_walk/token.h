@@ -1,10 +1,14 @@
 #pragma once
+#include <cstdint>
+#include <cstring>
 #include <memory>
 #include <string>
+#include <string_view>
 #include <exception>
 
 namespace lox {
     class lox_callable;
+    class traced;
 
     enum class token_type {
         // single-character tokens
@@ -25,55 +29,183 @@ namespace lox {
         END_OF_FILE
     };
 
+    // anything an object can point to - strings and callables live on the heap
+    // and are reference counted by the objects that hold them, unless they belong
+    // to the collector, which frees them once nothing reachable holds them
+    class heap_object
+    {
+        public:
+            enum class heap_type : uint8_t {text, callable};
+
+            heap_object(heap_type type, bool collected = false) : m_type(type), m_collected(collected) {}
+            virtual ~heap_object() = default;
+
+            // the collector's view of it, when m_collected is set
+            virtual traced* as_traced() { return nullptr; }
+
+            const heap_type m_type;
+            const bool m_collected;
+            uint32_t m_ref_count = 0;
+    };
+
+    // immutable and interned, only string_table::intern should create these
+    class string_object : public heap_object
+    {
+        public:
+            string_object(std::string value, uint32_t hash) :
+                heap_object(heap_type::text), m_value(std::move(value)), m_hash(hash) {}
+            ~string_object();
+
+            const std::string m_value;
+            const uint32_t m_hash;
+    };
+
+    // a NaN-boxed value - numbers are stored as themselves, every other type
+    // is packed into the unused bits of a quiet NaN so an object is only 8 bytes
     class object
     {
         public:
-            object();
-            object(std::nullptr_t);
-            object(bool value);
-            object(double value);
+            // the unboxed types are built inline, the interpreter's number paths depend on it
+            object() : m_bits(NIL_BITS) {}
+            object(std::nullptr_t) : m_bits(NIL_BITS) {}
+            object(bool value) : m_bits(value ? TRUE_BITS : FALSE_BITS) {}
+            object(double value) { std::memcpy(&m_bits, &value, sizeof(value)); }
             object(std::string value);
-            object(std::shared_ptr<lox_callable> callable);
+            object(const char* value);
+            object(string_object* text);
+            object(lox_callable* callable);
 
-            enum class object_type {nil, boolean, number, text, callable} m_type = object_type::nil;
+            object(const object& other) : m_bits(other.m_bits)
+            {
+                retain();
+            }
 
-            bool m_boolean_value;
-            double m_number_value;
-            std::string m_text_value;
-            std::shared_ptr<lox_callable> m_callable;
+            object(object&& other) noexcept : m_bits(other.m_bits)
+            {
+                other.m_bits = NIL_BITS;
+            }
 
-            operator bool() const;
+            object& operator=(const object& other)
+            {
+                other.retain();
+                release();
+                m_bits = other.m_bits;
+                return *this;
+            }
 
-            object operator!();
+            object& operator=(object&& other) noexcept
+            {
+                if (this != &other) {
+                    release();
+                    m_bits = other.m_bits;
+                    other.m_bits = NIL_BITS;
+                }
+                return *this;
+            }
 
-            object operator-();
+            ~object()
+            {
+                release();
+            }
 
-            object operator>(const object& right);
+            enum class object_type {nil, boolean, number, text, callable};
+            object_type type() const;
 
-            object operator>=(const object& right);
+            bool is_nil() const { return m_bits == NIL_BITS; }
+            bool is_boolean() const { return (m_bits | 1) == TRUE_BITS; }
+            bool is_number() const { return (m_bits & QNAN) != QNAN; }
+            bool is_text() const { return is_heap() && as_heap()->m_type == heap_object::heap_type::text; }
+            bool is_callable() const { return is_heap() && as_heap()->m_type == heap_object::heap_type::callable; }
+            // belongs to the collector, copying it or letting it go doesn't touch the heap
+            bool is_collected() const
+            {
+                return (m_bits & (QNAN | SIGN_BIT | COLLECTED_BIT)) == (QNAN | SIGN_BIT | COLLECTED_BIT);
+            }
+
+            bool as_boolean() const { return m_bits == TRUE_BITS; }
+            double as_number() const
+            {
+                double value;
+                std::memcpy(&value, &m_bits, sizeof(value));
+                return value;
+            }
+            const std::string& as_text() const;
+            string_object* as_string() const;
+            lox_callable* as_callable() const;
+            traced* as_traced() const { return as_heap()->as_traced(); }
+
+            operator bool() const { return m_bits != NIL_BITS && m_bits != FALSE_BITS; }
+
+            object operator!() const;
+
+            object operator-() const;
+
+            object operator>(const object& right) const;
+
+            object operator>=(const object& right) const;
+
+            object operator<(const object& right) const;
+
+            object operator<=(const object& right) const;
 
-            object operator<(const object& right);
+            object operator==(const object& right) const;
 
-            object operator<=(const object& right);
+            object operator!=(const object& right) const;
 
-            object operator==(const object& right);
+            object operator-(const object& right) const;
 
-            object operator!=(const object& right);
+            object operator+(const object& right) const;
 
-            object operator-(const object& right);
+            object operator*(const object& right) const;
 
-            object operator+(const object& right);
+            object operator/(const object& right) const;
 
-            object operator*(const object& right);
+            std::string to_string() const;
 
-            object operator/(const object& right);
+            // equal bits mean the same value, strings included since they're interned
+            uint64_t bits() const { return m_bits; }
+
+        private:
+            static const uint64_t SIGN_BIT = 0x8000000000000000;
+            static const uint64_t QNAN = 0x7ffc000000000000;
+            static const uint64_t NIL_BITS = QNAN | 1;
+            static const uint64_t FALSE_BITS = QNAN | 2;
+            static const uint64_t TRUE_BITS = QNAN | 3;
+            // set alongside the heap bits for a pointer to a collected object, a pointer
+            // only takes the low 48 bits
+            static const uint64_t COLLECTED_BIT = 0x0001000000000000;
+
+            explicit object(heap_object* heap);
+
+            bool is_heap() const { return (m_bits & (QNAN | SIGN_BIT)) == (QNAN | SIGN_BIT); }
+            heap_object* as_heap() const
+            {
+                return reinterpret_cast<heap_object*>(m_bits & ~(QNAN | SIGN_BIT | COLLECTED_BIT));
+            }
+            // reference counted rather than collected
+            bool is_counted() const { return (m_bits & (QNAN | SIGN_BIT | COLLECTED_BIT)) == (QNAN | SIGN_BIT); }
+
+            void retain() const
+            {
+                if (is_counted()) {
+                    as_heap()->m_ref_count++;
+                }
+            }
+
+            void release() const
+            {
+                if (is_counted() && --as_heap()->m_ref_count == 0) {
+                    delete as_heap();
+                }
+            }
 
-            std::string to_string();
+            uint64_t m_bits;
     };
 
     struct token {
         token_type type;
-        std::string lexeme;
+        // a view into the source, which has to outlive the token
+        std::string_view lexeme;
         object value = object(nullptr);
         int line;
     };
@@ -0,0 +1,127 @@
+#include "token_buffer.h"
+#include "string_table.h"
+
+#include <algorithm>
+#include <cstring>
+#include <limits>
+#include <stdexcept>
+
+namespace lox
+{
+    token_buffer::token_buffer(std::string_view source) :
+        m_source(source)
+    {
+    }
+
+    void token_buffer::push(token_type type, size_t offset, size_t length)
+    {
+        if (offset - m_base > std::numeric_limits<uint32_t>::max() ||
+            length > std::numeric_limits<uint32_t>::max()) {
+            throw std::runtime_error("Source too large to scan in one piece, try --stream.");
+        }
+
+        m_types.push_back(static_cast<uint8_t>(type));
+        m_offsets.push_back(static_cast<uint32_t>(offset - m_base));
+        m_lengths.push_back(static_cast<uint32_t>(length));
+    }
+
+    void token_buffer::push(token_type type, size_t offset, size_t length, object literal)
+    {
+        push(type, offset, length);
+        m_literal_handles.push_back(static_cast<token_handle>(size() - 1));
+        m_literals.push_back(std::move(literal));
+    }
+
+    void token_buffer::reserve(size_t count)
+    {
+        m_types.reserve(count);
+        m_offsets.reserve(count);
+        m_lengths.reserve(count);
+    }
+
+    void token_buffer::discard(size_t count)
+    {
+        if (count == 0) {
+            return;
+        }
+
+        count = std::min(count, size());
+        size_t new_base = count < size() ? offset(count) : m_source.size();
+
+        m_types.erase(m_types.begin(), m_types.begin() + count);
+        m_offsets.erase(m_offsets.begin(), m_offsets.begin() + count);
+        m_lengths.erase(m_lengths.begin(), m_lengths.begin() + count);
+        for (auto& relative : m_offsets) {
+            relative -= static_cast<uint32_t>(new_base - m_base);
+        }
+        m_base = new_base;
+
+        auto first_kept = std::lower_bound(m_literal_handles.begin(), m_literal_handles.end(), count);
+        size_t dropped = first_kept - m_literal_handles.begin();
+        m_literal_handles.erase(m_literal_handles.begin(), first_kept);
+        m_literals.erase(m_literals.begin(), m_literals.begin() + dropped);
+        for (auto& handle : m_literal_handles) {
+            handle -= static_cast<token_handle>(count);
+        }
+
+        // nothing left can be before new_base, so neither can any line we're asked about
+        auto first_newline = std::lower_bound(m_newlines.begin(), m_newlines.end(), new_base);
+        m_discarded_lines += first_newline - m_newlines.begin();
+        m_newlines.erase(m_newlines.begin(), first_newline);
+    }
+
+    std::string_view token_buffer::lexeme(token_handle handle) const
+    {
+        return m_source.substr(offset(handle), m_lengths[handle]);
+    }
+
+    object token_buffer::value(token_handle handle) const
+    {
+        switch (type(handle)) {
+            case token_type::NUMBER:
+            case token_type::STRING: {
+                auto iter = std::lower_bound(m_literal_handles.begin(), m_literal_handles.end(), handle);
+                return m_literals[iter - m_literal_handles.begin()];
+            }
+            case token_type::IDENTIFIER:
+                return object(string_table::intern(lexeme(handle)));
+            default:
+                return object(nullptr);
+        }
+    }
+
+    int token_buffer::line(token_handle handle) const
+    {
+        // a token's line is the one it ends on, which matters for multi-line strings
+        size_t position = offset(handle) + std::max<size_t>(m_lengths[handle], 1) - 1;
+        if (m_indexed_to <= position) {
+            size_t from = m_indexed_to;
+            const char* text = m_source.data();
+            // index a good way past what was asked for so this isn't redone per token
+            size_t to = std::min(m_source.size(), std::max(position + 1, from + 64 * 1024));
+            while (from < to) {
+                auto found = static_cast<const char*>(std::memchr(text + from, '\n', to - from));
+                if (found == nullptr) {
+                    break;
+                }
+                from = found - text;
+                m_newlines.push_back(from);
+                from++;
+            }
+            m_indexed_to = to;
+        }
+
+        auto newlines_before = std::lower_bound(m_newlines.begin(), m_newlines.end(), position) - m_newlines.begin();
+        return static_cast<int>(m_discarded_lines + newlines_before + 1);
+    }
+
+    token token_buffer::get(token_handle handle) const
+    {
+        token result;
+        result.type = type(handle);
+        result.lexeme = lexeme(handle);
+        result.value = value(handle);
+        result.line = line(handle);
+        return result;
+    }
+}
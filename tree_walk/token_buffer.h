@@ -0,0 +1,64 @@
+#pragma once
+#include <cstdint>
+#include <string_view>
+#include <vector>
+
+#include "token.h"
+
+namespace lox
+{
+    // index of a token in a token_buffer
+    using token_handle = uint32_t;
+
+    // the scanner's output stored as parallel arrays, 9 bytes a token instead of a
+    // full token struct. lexemes are views into the source, which has to outlive
+    // the buffer. a token struct is only built when an ast node needs one
+    class token_buffer
+    {
+        public:
+            token_buffer(std::string_view source);
+
+            void push(token_type type, size_t offset, size_t length);
+            // for NUMBER and STRING tokens
+            void push(token_type type, size_t offset, size_t length, object literal);
+
+            // drops the first count tokens, used to release tokens while streaming
+            void discard(size_t count);
+
+            void reserve(size_t count);
+            size_t size() const { return m_types.size(); }
+
+            token_type type(token_handle handle) const
+            {
+                return static_cast<token_type>(m_types[handle]);
+            }
+            std::string_view lexeme(token_handle handle) const;
+            // the literal of a NUMBER or STRING token, an identifier's interned name,
+            // nil for everything else
+            object value(token_handle handle) const;
+            int line(token_handle handle) const;
+
+            token get(token_handle handle) const;
+
+        private:
+            size_t offset(token_handle handle) const { return m_base + m_offsets[handle]; }
+
+            std::string_view m_source;
+
+            std::vector<uint8_t> m_types;
+            // relative to m_base so the offsets stay 32 bit while streaming huge sources
+            std::vector<uint32_t> m_offsets;
+            std::vector<uint32_t> m_lengths;
+            size_t m_base = 0;
+
+            // side table for the few tokens that carry a literal, sorted by handle
+            std::vector<token_handle> m_literal_handles;
+            std::vector<object> m_literals;
+
+            // offset of every newline before m_indexed_to, built as lines are asked for.
+            // m_discarded_lines counts the newlines that were dropped from the front
+            mutable std::vector<size_t> m_newlines;
+            mutable size_t m_indexed_to = 0;
+            size_t m_discarded_lines = 0;
+    };
+}
@@ -5,31 +5,141 @@
 
 #include <iostream>
 #include <fstream>
+#include <list>
+#include <memory>
 #include <vector>
 #include <exception>
 
 #include "scanner.h"
+#include "source_file.h"
+#include "resolver.h"
+#include "constant_folder.h"
+#include "type_inference.h"
+#include "vm/compiler.h"
+#include "vm/vm.h"
+#include "ir/builder.h"
+#include "ir/passes.h"
+#include "ir/ir_interpreter.h"
+#include "closure/closure_engine.h"
 
 namespace lox {    
     bool tree_walk::had_error = false;
     bool tree_walk::had_runtime_error = false;
+    engine_type tree_walk::m_engine = engine_type::interpreter;
+    bool tree_walk::m_streaming = false;
+    bool tree_walk::m_dump_ir = false;
+    bool tree_walk::m_time_passes = false;
+    jit_mode tree_walk::m_jit = jit_mode::on;
+    size_t tree_walk::m_max_frames = interpreter::default_max_frames;
+    size_t tree_walk::m_gc_nursery = 0;
+    double tree_walk::m_gc_growth = 0;
+    bool tree_walk::m_gc_stats = false;
+    resolver* tree_walk::m_resolver = nullptr;
     interpreter* tree_walk::m_interpreter = nullptr;
+    vm* tree_walk::m_vm = nullptr;
+    ir_pass_manager* tree_walk::m_passes = nullptr;
+    ir_interpreter* tree_walk::m_ir_interpreter = nullptr;
+    closure_engine* tree_walk::m_closure_engine = nullptr;
+    std::vector<std::unique_ptr<arena>> tree_walk::m_kept_nodes;
 
-    void tree_walk::run(std::string source) {
+    namespace
+    {
+        // the first function declared outside of any function body, or nullptr
+        function_stmt* find_function(stmt* statement)
+        {
+            if (auto function = dynamic_cast<function_stmt*>(statement)) {
+                return function;
+            }
+            if (auto block = dynamic_cast<block_stmt*>(statement)) {
+                for (auto inner : block->m_statements) {
+                    if (auto function = find_function(inner)) {
+                        return function;
+                    }
+                }
+            }
+            else if (auto branch = dynamic_cast<if_stmt*>(statement)) {
+                if (auto function = find_function(branch->m_then_branch)) {
+                    return function;
+                }
+                return find_function(branch->m_else_branch);
+            }
+            else if (auto loop = dynamic_cast<while_stmt*>(statement)) {
+                return find_function(loop->m_body);
+            }
+            return nullptr;
+        }
+
+        function_stmt* find_function(const std::vector<stmt*>& statements)
+        {
+            for (auto statement : statements) {
+                if (auto function = find_function(statement)) {
+                    return function;
+                }
+            }
+            return nullptr;
+        }
+    }
+
+    void tree_walk::run(std::string_view source) {
         try {
             scanner scanner(source);
             auto tokens = scanner.scan_tokens();
-            parser psr(tokens);
+            // every node of this run's tree is freed in one go when nodes goes out of scope
+            auto nodes = std::make_unique<arena>();
+            parser psr(std::move(tokens), *nodes);
             auto statements = psr.parse();
 
             if (tree_walk::had_error){
                 return;
             }
-            
-            if (m_interpreter == nullptr) {
-                m_interpreter = new interpreter();
+
+            execute(statements, *nodes);
+
+            // unless a function was declared, which runs its declaration's nodes when called
+            if (find_function(statements)) {
+                m_kept_nodes.push_back(std::move(nodes));
+            }
+        }
+        catch (const std::runtime_error& e)
+        {
+            std::cerr << e.what() << std::endl;
+        }
+    }
+
+    void tree_walk::run_streaming(std::string_view source) {
+        try {
+            scanner scanner(source);
+            // reset after every declaration, so it only ever holds one of them
+            arena nodes;
+            parser psr(scanner, nodes);
+
+            if (m_resolver == nullptr) {
+                m_resolver = new resolver();
+            }
+            m_resolver->defer_global_checks(true);
+
+            // a function runs its declaration's nodes whenever it's called, so once
+            // one has been declared they're kept until the end of the script
+            bool keep_nodes = false;
+            while (not psr.done()) {
+                if (not keep_nodes) {
+                    nodes.reset();
+                }
+                auto statement = psr.next_declaration();
+
+                // after a syntax error keep parsing so the rest get reported, but stop running
+                if (tree_walk::had_error) {
+                    continue;
+                }
+
+                std::vector<stmt*> statements{statement};
+                execute(statements, nodes);
+                keep_nodes = keep_nodes || find_function(statement);
+                if (tree_walk::had_runtime_error) {
+                    break;
+                }
             }
-            m_interpreter->interpret(statements);
+            m_resolver->defer_global_checks(false);
         }
         catch (const std::runtime_error& e)
         {
@@ -37,13 +147,100 @@ namespace lox {
         }
     }
 
+    void tree_walk::execute(std::vector<stmt*>& statements, arena& nodes) {
+        if (m_resolver == nullptr) {
+            m_resolver = new resolver();
+        }
+        m_resolver->resolve(statements);
+
+        if (tree_walk::had_error){
+            return;
+        }
+
+        constant_folder folder(nodes);
+        folder.fold(statements);
+
+        if (m_engine != engine_type::interpreter) {
+            if (auto function = find_function(statements)) {
+                error(function->m_name, "Functions only run with --engine=interpreter so far.");
+                return;
+            }
+        }
+
+        if (m_engine == engine_type::ir || m_dump_ir) {
+            ir_builder builder;
+            auto function = builder.build(statements);
+
+            if (m_passes == nullptr) {
+                m_passes = new ir_pass_manager();
+            }
+            m_passes->run(*function);
+
+            if (m_dump_ir) {
+                function->dump(std::cout);
+            }
+
+            if (m_engine == engine_type::ir) {
+                if (m_ir_interpreter == nullptr) {
+                    m_ir_interpreter = new ir_interpreter();
+                }
+                m_ir_interpreter->interpret(*function);
+                return;
+            }
+        }
+
+        if (m_engine == engine_type::vm) {
+            chunk script;
+            compiler cmp;
+            if (not cmp.compile(statements, &script)) {
+                return;
+            }
+
+            if (m_vm == nullptr) {
+                m_vm = new vm();
+            }
+            m_vm->interpret(script);
+            return;
+        }
+
+        type_inference types;
+        types.infer(statements);
+
+        if (m_engine == engine_type::closure) {
+            if (m_closure_engine == nullptr) {
+                m_closure_engine = new closure_engine();
+            }
+            m_closure_engine->interpret(statements);
+            return;
+        }
+
+        if (m_interpreter == nullptr) {
+            m_interpreter = new interpreter();
+            m_interpreter->set_jit(m_jit);
+            m_interpreter->set_max_frames(m_max_frames);
+            // zero leaves the collector's default
+            if (m_gc_nursery != 0) {
+                m_interpreter->heap().set_nursery_size(m_gc_nursery);
+            }
+            if (m_gc_growth != 0) {
+                m_interpreter->heap().set_growth_factor(m_gc_growth);
+            }
+        }
+        m_interpreter->interpret(statements);
+    }
+
     void tree_walk::run_prompt() {
+        // the tokens of a function declared at the prompt point into its line
+        std::list<std::string> lines;
         while(true) {
             std::cout << "> ";
             std::string line;
             std::getline(std::cin, line);
             if (not line.empty()) {
-                tree_walk::run(line);
+                lines.push_back(std::move(line));
+                tree_walk::run(lines.back());
+                report_pass_timings();
+                report_gc_stats();
                 // we don't want to kill the interactive prompt if there is an error
                 tree_walk::had_error = false;
             }
@@ -51,20 +248,16 @@ namespace lox {
     }
 
     void tree_walk::run_file(std::string path) {
-        std::ifstream file;
-        file.open(path, std::ifstream::in);
+        source_file file(path);
         if (file.is_open()) {
-            file.seekg(0, file.end);
-            int length = file.tellg();
-            file.seekg(0, file.beg);
-
-            std::vector<char> data(length);
-            file.read(data.data(), length);
-            file.close();
-
-            std::string script(data.begin(), data.end());
-
-            tree_walk::run(script);
+            if (m_streaming) {
+                tree_walk::run_streaming(file.text());
+            }
+            else {
+                tree_walk::run(file.text());
+            }
+            report_pass_timings();
+            report_gc_stats();
 
             if (had_error || had_runtime_error) {
                 // kill the script - we don't want a script full of errors to proceed
@@ -73,6 +266,54 @@ namespace lox {
         }
     }
 
+    void tree_walk::set_engine(engine_type engine) {
+        m_engine = engine;
+    }
+
+    void tree_walk::set_streaming(bool streaming) {
+        m_streaming = streaming;
+    }
+
+    void tree_walk::set_dump_ir(bool dump) {
+        m_dump_ir = dump;
+    }
+
+    void tree_walk::set_time_passes(bool time) {
+        m_time_passes = time;
+    }
+
+    void tree_walk::set_jit(jit_mode mode) {
+        m_jit = mode;
+    }
+
+    void tree_walk::set_max_frames(size_t frames) {
+        m_max_frames = frames;
+    }
+
+    void tree_walk::set_gc_nursery(size_t bytes) {
+        m_gc_nursery = bytes;
+    }
+
+    void tree_walk::set_gc_growth(double factor) {
+        m_gc_growth = factor;
+    }
+
+    void tree_walk::set_gc_stats(bool stats) {
+        m_gc_stats = stats;
+    }
+
+    void tree_walk::report_pass_timings() {
+        if (m_time_passes && m_passes != nullptr) {
+            m_passes->report(std::cerr);
+        }
+    }
+
+    void tree_walk::report_gc_stats() {
+        if (m_gc_stats && m_interpreter != nullptr) {
+            m_interpreter->heap().report(std::cerr);
+        }
+    }
+
     void tree_walk::error(int line, std::string message) {
         tree_walk::report(line, "", message);
     }
@@ -83,7 +324,7 @@ namespace lox {
             tree_walk::report(token.line, " at end", message);
         }
         else {
-            tree_walk::report(token.line, " at '" + token.lexeme + "'", message);
+            tree_walk::report(token.line, " at '" + std::string(token.lexeme) + "'", message);
         }
     }
 
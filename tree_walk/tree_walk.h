@@ -1,18 +1,51 @@
 #pragma once
+#include <memory>
 #include <string>
+#include <string_view>
+#include <vector>
 #include "token.h"
 #include "interpreter.h"
 
 namespace lox {
+    class vm;
+    class resolver;
+    class ir_pass_manager;
+    class ir_interpreter;
+    class closure_engine;
+
+    // which backend executes the parsed statements
+    enum class engine_type { interpreter, vm, ir, closure };
+
     class tree_walk {
         public:
             tree_walk() = delete;
-            static void run(std::string source);
+            // source has to stay alive until run returns, nothing is copied out of it
+            static void run(std::string_view source);
 
             static void run_prompt();
 
+            // like run but executes each top-level declaration as soon as it is parsed,
+            // so memory is bounded by the largest declaration rather than the script
+            static void run_streaming(std::string_view source);
+
             static void run_file(std::string path);
 
+            static void set_engine(engine_type engine);
+            static void set_streaming(bool streaming);
+            // prints the optimised ir of every run to stdout, whatever the engine
+            static void set_dump_ir(bool dump);
+            // prints how long each ir pass took to stderr when a script or prompt line ends
+            static void set_time_passes(bool time);
+            // whether the interpreter compiles hot loops to machine code
+            static void set_jit(jit_mode mode);
+            // how deep the interpreter lets calls nest
+            static void set_max_frames(size_t frames);
+            // the interpreter's collector, see collector::set_nursery_size and set_growth_factor
+            static void set_gc_nursery(size_t bytes);
+            static void set_gc_growth(double factor);
+            // prints the collector's statistics to stderr when a script or prompt line ends
+            static void set_gc_stats(bool stats);
+
             static void error(int line, std::string message);
             static void error(token token, std::string message);
             static void runtime_error(const lox_runtime_exception& e);
@@ -21,7 +54,28 @@ namespace lox {
             static bool had_runtime_error;
 
         private:
+            // resolves, optimises and runs a parsed program whose nodes live in nodes
+            static void execute(std::vector<stmt*>& statements, arena& nodes);
+            static void report_pass_timings();
+            static void report_gc_stats();
+
+            static engine_type m_engine;
+            static bool m_streaming;
+            static bool m_dump_ir;
+            static bool m_time_passes;
+            static jit_mode m_jit;
+            static size_t m_max_frames;
+            static size_t m_gc_nursery;
+            static double m_gc_growth;
+            static bool m_gc_stats;
+            static resolver * m_resolver;
             static interpreter * m_interpreter;
+            static vm * m_vm;
+            static ir_pass_manager * m_passes;
+            static ir_interpreter * m_ir_interpreter;
+            static closure_engine * m_closure_engine;
+            // the trees of earlier runs that declared functions, which still use them
+            static std::vector<std::unique_ptr<arena>> m_kept_nodes;
             static void report(int line, std::string where, std::string message);
     };
 }
\ No newline at end of file
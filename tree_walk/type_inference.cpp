@@ -0,0 +1,296 @@
+#include "type_inference.h"
+#include <algorithm>
+
+namespace lox
+{
+    namespace
+    {
+        constexpr uint8_t NIL = 1;
+        constexpr uint8_t BOOLEAN = 2;
+        constexpr uint8_t NUMBER = 4;
+        constexpr uint8_t STRING = 8;
+        constexpr uint8_t CALLABLE = 16;
+        constexpr uint8_t ANY = NIL | BOOLEAN | NUMBER | STRING | CALLABLE;
+        // assigned from inside a function body, which could run at any call,
+        // so the local can't be tracked anywhere
+        constexpr uint8_t CAPTURED = 32;
+
+        uint8_t type_of(const object& value)
+        {
+            switch (value.type()) {
+                case object::object_type::nil: return NIL;
+                case object::object_type::boolean: return BOOLEAN;
+                case object::object_type::number: return NUMBER;
+                case object::object_type::text: return STRING;
+                default: return CALLABLE;
+            }
+        }
+
+        static_type to_static_type(uint8_t types)
+        {
+            switch (types) {
+                case NUMBER: return static_type::number;
+                case STRING: return static_type::string;
+                default: return static_type::unknown;
+            }
+        }
+    }
+
+    void type_inference::infer(const std::vector<stmt*>& statements)
+    {
+        for (auto statement : statements) {
+            infer(statement);
+        }
+    }
+
+    object type_inference::visit_assign(assign_expr* exp)
+    {
+        type_set value = infer(exp->m_value);
+        if (exp->m_depth != -1) {
+            auto& types = local(exp->m_depth, exp->m_slot);
+            size_t index = m_scopes.size() - 1 - exp->m_depth;
+            if (index < m_function_base) {
+                types = CAPTURED | ANY;
+            }
+            else if (not (types & CAPTURED)) {
+                types = value;
+            }
+        }
+        m_result = value;
+        return object(nullptr);
+    }
+
+    object type_inference::visit_binary(binary_expr* exp)
+    {
+        type_set left = infer(exp->m_left);
+        type_set right = infer(exp->m_right);
+
+        switch (exp->m_op.type) {
+            case token_type::PLUS:
+                // mixing types is an error, so one known side decides the result
+                if (left == NUMBER || right == NUMBER) {
+                    m_result = NUMBER;
+                }
+                else if (left == STRING || right == STRING) {
+                    m_result = STRING;
+                }
+                else {
+                    m_result = NUMBER | STRING;
+                }
+                break;
+            case token_type::MINUS:
+            case token_type::STAR:
+            case token_type::SLASH:
+                m_result = NUMBER;
+                break;
+            default:
+                // comparisons and equality
+                m_result = BOOLEAN;
+                break;
+        }
+        return object(nullptr);
+    }
+
+    object type_inference::visit_grouping(grouping_expr* exp)
+    {
+        m_result = infer(exp->m_expression);
+        return object(nullptr);
+    }
+
+    object type_inference::visit_literal(literal_expr* exp)
+    {
+        m_result = type_of(exp->m_value);
+        return object(nullptr);
+    }
+
+    object type_inference::visit_variable(variable_expr* exp)
+    {
+        m_result = exp->m_depth == -1 ? ANY : local(exp->m_depth, exp->m_slot) & ANY;
+        return object(nullptr);
+    }
+
+    object type_inference::visit_unary(unary_expr* exp)
+    {
+        infer(exp->m_right);
+        m_result = exp->m_op.type == token_type::MINUS ? NUMBER : BOOLEAN;
+        return object(nullptr);
+    }
+
+    object type_inference::visit_logical(logical_expr* exp)
+    {
+        type_set left = infer(exp->m_left);
+
+        // the right side may not run, so afterwards the locals could be in either state
+        auto skipped = m_scopes;
+        type_set right = infer(exp->m_right);
+        join(m_scopes, skipped);
+
+        m_result = left | right;
+        return object(nullptr);
+    }
+
+    object type_inference::visit_call(call_expr* exp)
+    {
+        infer(exp->m_callee);
+        for (auto argument : exp->m_arguments) {
+            infer(argument);
+        }
+        m_result = ANY;
+        return object(nullptr);
+    }
+
+    void type_inference::visit_print(print_stmt* statement)
+    {
+        infer(statement->m_expression);
+    }
+
+    void type_inference::visit_expression(expression_stmt* statement)
+    {
+        infer(statement->m_expression);
+    }
+
+    void type_inference::visit_var(var_stmt* statement)
+    {
+        type_set value = statement->m_initializer ? infer(statement->m_initializer) : NIL;
+        if (statement->m_slot != -1) {
+            auto& types = local(0, statement->m_slot);
+            if (not (types & CAPTURED)) {
+                types = value;
+            }
+        }
+    }
+
+    void type_inference::visit_block(block_stmt* statement)
+    {
+        if (not statement->is_scope()) {
+            for (auto inner : statement->m_statements) {
+                infer(inner);
+            }
+            return;
+        }
+
+        // every slot holds nil until its declaration runs
+        m_scopes.emplace_back(statement->m_slot_names.size(), NIL);
+        for (auto inner : statement->m_statements) {
+            infer(inner);
+        }
+        m_scopes.pop_back();
+    }
+
+    void type_inference::visit_if(if_stmt* statement)
+    {
+        infer(statement->m_condition);
+
+        auto skipped = m_scopes;
+        infer(statement->m_then_branch);
+        std::swap(skipped, m_scopes);
+        if (statement->m_else_branch) {
+            infer(statement->m_else_branch);
+        }
+        join(m_scopes, skipped);
+    }
+
+    void type_inference::visit_while(while_stmt* statement)
+    {
+        // go round until the types at the top of the loop stop widening, the
+        // last pass through is the one whose annotations hold for every iteration
+        auto head = m_scopes;
+        while (true) {
+            m_scopes = head;
+            infer(statement->m_condition);
+            auto exit = m_scopes;
+            infer(statement->m_body);
+
+            join(m_scopes, head);
+            if (m_scopes == head) {
+                m_scopes = std::move(exit);
+                return;
+            }
+            head = std::move(m_scopes);
+        }
+    }
+
+    void type_inference::visit_function(function_stmt* statement)
+    {
+        // the body runs whenever the function is called, by which point the
+        // enclosing locals could hold anything
+        auto outside = m_scopes;
+        for (auto& scope : m_scopes) {
+            for (auto& types : scope) {
+                types |= ANY;
+            }
+        }
+
+        size_t function_base = m_function_base;
+        m_function_base = m_scopes.size();
+        // the parameters could be passed anything
+        m_scopes.emplace_back(statement->m_slot_names.size(), NIL);
+        std::fill_n(m_scopes.back().begin(), statement->m_params.size(), ANY);
+        for (auto inner : statement->m_body) {
+            infer(inner);
+        }
+        m_scopes.pop_back();
+        m_function_base = function_base;
+
+        // keep the locals the body assigns to untracked from here on
+        for (size_t i = 0; i < outside.size(); i++) {
+            for (size_t slot = 0; slot < m_scopes[i].size(); slot++) {
+                if (m_scopes[i][slot] & CAPTURED) {
+                    outside[i].resize(std::max(outside[i].size(), slot + 1), NIL);
+                    outside[i][slot] = CAPTURED | ANY;
+                }
+            }
+        }
+        m_scopes = std::move(outside);
+
+        if (statement->m_slot != -1) {
+            auto& types = local(0, statement->m_slot);
+            if (not (types & CAPTURED)) {
+                types = CALLABLE;
+            }
+        }
+    }
+
+    void type_inference::visit_return(return_stmt* statement)
+    {
+        if (statement->m_value) {
+            infer(statement->m_value);
+        }
+    }
+
+    type_inference::type_set type_inference::infer(expr* exp)
+    {
+        exp->accept(this);
+        exp->m_static_type = to_static_type(m_result);
+        return m_result;
+    }
+
+    void type_inference::infer(stmt* statement)
+    {
+        statement->accept(this);
+    }
+
+    type_inference::type_set& type_inference::local(int depth, int slot)
+    {
+        // every scope is sized from the resolver's slot names, so this only grows
+        // one if a slot is reached that the resolver didn't name
+        auto& scope = m_scopes[m_scopes.size() - 1 - depth];
+        if (static_cast<size_t>(slot) >= scope.size()) {
+            scope.resize(slot + 1, NIL);
+        }
+        return scope[slot];
+    }
+
+    void type_inference::join(scope_types& into, const scope_types& other)
+    {
+        for (size_t i = 0; i < into.size(); i++) {
+            auto& scope = into[i];
+            if (other[i].size() > scope.size()) {
+                scope.resize(other[i].size(), NIL);
+            }
+            for (size_t slot = 0; slot < scope.size(); slot++) {
+                scope[slot] |= slot < other[i].size() ? other[i][slot] : NIL;
+            }
+        }
+    }
+}
@@ -0,0 +1,58 @@
+#pragma once
+#include <cstdint>
+#include <vector>
+#include "expr.h"
+#include "stmt.h"
+
+namespace lox
+{
+    // runs after the resolver and the constant folder, following the program in
+    // execution order to work out which expressions can only ever produce a number
+    // or a string. locals are tracked through assignments, branches and loops;
+    // globals can change behind any call so they are never proven
+    class type_inference : public expr_visitor, stmt_visitor
+    {
+        public:
+            // annotates m_static_type on every expression in the statements
+            void infer(const std::vector<stmt*>& statements);
+
+            object visit_assign(assign_expr* exp) override;
+            object visit_binary(binary_expr* exp) override;
+            object visit_grouping(grouping_expr* exp) override;
+            object visit_literal(literal_expr* exp) override;
+            object visit_variable(variable_expr* exp) override;
+            object visit_unary(unary_expr* exp) override;
+            object visit_logical(logical_expr* exp) override;
+            object visit_call(call_expr* exp) override;
+
+            void visit_print(print_stmt* statement) override;
+            void visit_expression(expression_stmt* statement) override;
+            void visit_var(var_stmt* statement) override;
+            void visit_block(block_stmt* statement) override;
+            void visit_if(if_stmt* statement) override;
+            void visit_while(while_stmt* statement) override;
+            void visit_function(function_stmt* statement) override;
+            void visit_return(return_stmt* statement) override;
+
+        private:
+            // a set of the types a value might have, one bit per type
+            using type_set = uint8_t;
+
+            // the set of possible types of every local in scope, innermost block last
+            using scope_types = std::vector<std::vector<type_set>>;
+
+            // returns the possible types of the expression and records what was proven
+            type_set infer(expr* exp);
+            void infer(stmt* statement);
+
+            type_set& local(int depth, int slot);
+            // the types of every local after either of two paths through the program
+            static void join(scope_types& into, const scope_types& other);
+
+            scope_types m_scopes;
+            // index in m_scopes of the innermost function's outermost scope
+            size_t m_function_base = 0;
+            // types of the expression that was just visited
+            type_set m_result = 0;
+    };
+}
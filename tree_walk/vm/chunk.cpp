@@ -0,0 +1,125 @@
+#include "chunk.h"
+#include <iostream>
+#include <iomanip>
+
+namespace lox
+{
+    void chunk::write(uint8_t byte, int line)
+    {
+        m_code.push_back(byte);
+
+        if (m_lines.empty() || m_lines.back().line != line) {
+            m_lines.push_back({m_code.size() - 1, line});
+        }
+    }
+
+    void chunk::write(op_code op, int line)
+    {
+        write(static_cast<uint8_t>(op), line);
+    }
+
+    size_t chunk::add_constant(object value)
+    {
+        m_constants.push_back(value);
+        return m_constants.size() - 1;
+    }
+
+    int chunk::get_line(size_t offset) const
+    {
+        // find the last run that starts at or before the offset
+        size_t low = 0;
+        size_t high = m_lines.size();
+        while (low + 1 < high) {
+            size_t mid = (low + high) / 2;
+            if (m_lines[mid].offset <= offset) {
+                low = mid;
+            }
+            else {
+                high = mid;
+            }
+        }
+
+        return m_lines.empty() ? 0 : m_lines[low].line;
+    }
+
+    void chunk::disassemble(const std::string& name) const
+    {
+        std::cout << "== " << name << " ==" << std::endl;
+        for (size_t offset = 0; offset < m_code.size();) {
+            offset = disassemble_instruction(offset);
+        }
+    }
+
+    size_t chunk::disassemble_instruction(size_t offset) const
+    {
+        std::cout << std::setfill('0') << std::setw(4) << offset << " "
+                  << std::setfill(' ') << std::setw(4) << get_line(offset) << " ";
+
+        auto constant_instruction = [this, offset](const char* name, size_t width) {
+            size_t index = 0;
+            for (size_t i = 0; i < width; i++) {
+                index |= static_cast<size_t>(m_code[offset + 1 + i]) << (8 * i);
+            }
+            object value = m_constants[index];
+            std::cout << std::left << std::setw(20) << name << std::right
+                      << std::setw(4) << index << " '" << value.to_string() << "'" << std::endl;
+            return offset + 1 + width;
+        };
+
+        auto byte_instruction = [this, offset](const char* name) {
+            std::cout << std::left << std::setw(20) << name << std::right
+                      << std::setw(4) << static_cast<int>(m_code[offset + 1]) << std::endl;
+            return offset + 2;
+        };
+
+        auto jump_instruction = [this, offset](const char* name, int sign) {
+            uint16_t jump = static_cast<uint16_t>(m_code[offset + 1] << 8) | m_code[offset + 2];
+            std::cout << std::left << std::setw(20) << name << std::right
+                      << std::setw(4) << offset << " -> " << offset + 3 + sign * jump << std::endl;
+            return offset + 3;
+        };
+
+        auto simple_instruction = [offset](const char* name) {
+            std::cout << name << std::endl;
+            return offset + 1;
+        };
+
+        switch (static_cast<op_code>(m_code[offset])) {
+            case op_code::CONSTANT: return constant_instruction("CONSTANT", 1);
+            case op_code::CONSTANT_LONG: return constant_instruction("CONSTANT_LONG", 3);
+            case op_code::NIL: return simple_instruction("NIL");
+            case op_code::TRUE: return simple_instruction("TRUE");
+            case op_code::FALSE: return simple_instruction("FALSE");
+            case op_code::POP: return simple_instruction("POP");
+            case op_code::GET_LOCAL: return byte_instruction("GET_LOCAL");
+            case op_code::SET_LOCAL: return byte_instruction("SET_LOCAL");
+            case op_code::GET_GLOBAL: return constant_instruction("GET_GLOBAL", 1);
+            case op_code::GET_GLOBAL_LONG: return constant_instruction("GET_GLOBAL_LONG", 3);
+            case op_code::DEFINE_GLOBAL: return constant_instruction("DEFINE_GLOBAL", 1);
+            case op_code::DEFINE_GLOBAL_LONG: return constant_instruction("DEFINE_GLOBAL_LONG", 3);
+            case op_code::SET_GLOBAL: return constant_instruction("SET_GLOBAL", 1);
+            case op_code::SET_GLOBAL_LONG: return constant_instruction("SET_GLOBAL_LONG", 3);
+            case op_code::EQUAL: return simple_instruction("EQUAL");
+            case op_code::NOT_EQUAL: return simple_instruction("NOT_EQUAL");
+            case op_code::GREATER: return simple_instruction("GREATER");
+            case op_code::GREATER_EQUAL: return simple_instruction("GREATER_EQUAL");
+            case op_code::LESS: return simple_instruction("LESS");
+            case op_code::LESS_EQUAL: return simple_instruction("LESS_EQUAL");
+            case op_code::ADD: return simple_instruction("ADD");
+            case op_code::SUBTRACT: return simple_instruction("SUBTRACT");
+            case op_code::MULTIPLY: return simple_instruction("MULTIPLY");
+            case op_code::DIVIDE: return simple_instruction("DIVIDE");
+            case op_code::NOT: return simple_instruction("NOT");
+            case op_code::NEGATE: return simple_instruction("NEGATE");
+            case op_code::PRINT: return simple_instruction("PRINT");
+            case op_code::JUMP: return jump_instruction("JUMP", 1);
+            case op_code::JUMP_IF_FALSE: return jump_instruction("JUMP_IF_FALSE", 1);
+            case op_code::LOOP: return jump_instruction("LOOP", -1);
+            case op_code::CALL: return byte_instruction("CALL");
+            case op_code::RETURN: return simple_instruction("RETURN");
+        }
+
+        std::cout << "Unknown opcode " << static_cast<int>(m_code[offset]) << std::endl;
+        return offset + 1;
+    }
+}
@@ -0,0 +1,67 @@
+#pragma once
+#include <cstdint>
+#include <string>
+#include <vector>
+#include "../token.h"
+
+namespace lox
+{
+    enum class op_code : uint8_t {
+        // operand: u8 constant index (u24 for the _LONG variants)
+        CONSTANT, CONSTANT_LONG,
+        NIL, TRUE, FALSE,
+        POP,
+
+        // operand: u8 stack slot
+        GET_LOCAL, SET_LOCAL,
+
+        // operand: constant index of the variable name
+        GET_GLOBAL, GET_GLOBAL_LONG,
+        DEFINE_GLOBAL, DEFINE_GLOBAL_LONG,
+        SET_GLOBAL, SET_GLOBAL_LONG,
+
+        EQUAL, NOT_EQUAL,
+        GREATER, GREATER_EQUAL, LESS, LESS_EQUAL,
+        ADD, SUBTRACT, MULTIPLY, DIVIDE,
+        NOT, NEGATE,
+
+        PRINT,
+
+        // operand: u16 forward/backward offset
+        JUMP, JUMP_IF_FALSE, LOOP,
+
+        // operand: u8 argument count
+        CALL,
+
+        RETURN
+    };
+
+    // a compiled unit of bytecode - the instructions, the constants they
+    // reference and enough line information to report runtime errors
+    class chunk
+    {
+        public:
+            void write(uint8_t byte, int line);
+            void write(op_code op, int line);
+
+            // returns the index of the value in the constant pool
+            size_t add_constant(object value);
+
+            int get_line(size_t offset) const;
+
+            // prints a human readable listing, handy when debugging the compiler
+            void disassemble(const std::string& name) const;
+            size_t disassemble_instruction(size_t offset) const;
+
+            std::vector<uint8_t> m_code;
+            std::vector<object> m_constants;
+
+        private:
+            // run length encoded - a new entry is only added when the line changes
+            struct line_start {
+                size_t offset;
+                int line;
+            };
+            std::vector<line_start> m_lines;
+    };
+}
@@ -0,0 +1,406 @@
+#include "compiler.h"
+#include "../tree_walk.h"
+
+namespace lox
+{
+    bool compiler::compile(const std::vector<stmt*>& statements, chunk* target)
+    {
+        m_chunk = target;
+        m_had_error = false;
+        m_identifier_constants.clear();
+
+        for (auto& statement : statements) {
+            compile(statement);
+        }
+        emit(op_code::RETURN);
+
+        return not m_had_error;
+    }
+
+    object compiler::visit_assign(assign_expr* exp)
+    {
+        compile(exp->m_value);
+
+        m_line = exp->m_name.line;
+        int slot = resolve_local(exp->m_name.lexeme);
+        if (slot != -1) {
+            emit(op_code::SET_LOCAL, static_cast<uint8_t>(slot));
+        }
+        else {
+            emit_indexed(op_code::SET_GLOBAL, op_code::SET_GLOBAL_LONG,
+                identifier_constant(exp->m_name.value));
+        }
+        return object(nullptr);
+    }
+
+    object compiler::visit_binary(binary_expr* exp)
+    {
+        compile(exp->m_left);
+        compile(exp->m_right);
+
+        m_line = exp->m_op.line;
+        switch (exp->m_op.type) {
+            case token_type::GREATER:
+                emit(op_code::GREATER);
+                break;
+            case token_type::GREATER_EQUAL:
+                emit(op_code::GREATER_EQUAL);
+                break;
+            case token_type::LESS:
+                emit(op_code::LESS);
+                break;
+            case token_type::LESS_EQUAL:
+                emit(op_code::LESS_EQUAL);
+                break;
+            case token_type::BANG_EQUAL:
+                emit(op_code::NOT_EQUAL);
+                break;
+            case token_type::EQUAL_EQUAL:
+                emit(op_code::EQUAL);
+                break;
+            case token_type::PLUS:
+                emit(op_code::ADD);
+                break;
+            case token_type::MINUS:
+                emit(op_code::SUBTRACT);
+                break;
+            case token_type::SLASH:
+                emit(op_code::DIVIDE);
+                break;
+            case token_type::STAR:
+                emit(op_code::MULTIPLY);
+                break;
+            default:
+                // the interpreter evaluates unsupported operators to nil
+                emit(op_code::POP);
+                emit(op_code::POP);
+                emit(op_code::NIL);
+                break;
+        }
+        return object(nullptr);
+    }
+
+    object compiler::visit_grouping(grouping_expr* exp)
+    {
+        compile(exp->m_expression);
+        return object(nullptr);
+    }
+
+    object compiler::visit_literal(literal_expr* exp)
+    {
+        switch (exp->m_value.type()) {
+            case object::object_type::nil:
+                emit(op_code::NIL);
+                break;
+            case object::object_type::boolean:
+                emit(exp->m_value.as_boolean() ? op_code::TRUE : op_code::FALSE);
+                break;
+            default:
+                emit_constant(exp->m_value);
+                break;
+        }
+        return object(nullptr);
+    }
+
+    object compiler::visit_variable(variable_expr* exp)
+    {
+        m_line = exp->m_name.line;
+        int slot = resolve_local(exp->m_name.lexeme);
+        if (slot != -1) {
+            emit(op_code::GET_LOCAL, static_cast<uint8_t>(slot));
+        }
+        else {
+            emit_indexed(op_code::GET_GLOBAL, op_code::GET_GLOBAL_LONG,
+                identifier_constant(exp->m_name.value));
+        }
+        return object(nullptr);
+    }
+
+    object compiler::visit_unary(unary_expr* exp)
+    {
+        compile(exp->m_right);
+
+        m_line = exp->m_op.line;
+        switch (exp->m_op.type) {
+            case token_type::BANG:
+                emit(op_code::NOT);
+                break;
+            case token_type::MINUS:
+                emit(op_code::NEGATE);
+                break;
+            default:
+                emit(op_code::POP);
+                emit(op_code::NIL);
+                break;
+        }
+        return object(nullptr);
+    }
+
+    object compiler::visit_logical(logical_expr* exp)
+    {
+        compile(exp->m_left);
+
+        m_line = exp->m_op.line;
+        if (exp->m_op.type == token_type::OR) {
+            // short circuit - keep the left operand if it is truthy
+            size_t else_jump = emit_jump(op_code::JUMP_IF_FALSE);
+            size_t end_jump = emit_jump(op_code::JUMP);
+
+            patch_jump(else_jump);
+            emit(op_code::POP);
+            compile(exp->m_right);
+            patch_jump(end_jump);
+        }
+        else {
+            size_t end_jump = emit_jump(op_code::JUMP_IF_FALSE);
+
+            emit(op_code::POP);
+            compile(exp->m_right);
+            patch_jump(end_jump);
+        }
+        return object(nullptr);
+    }
+
+    object compiler::visit_call(call_expr* exp)
+    {
+        compile(exp->m_callee);
+        for (auto& argument : exp->m_arguments) {
+            compile(argument);
+        }
+
+        m_line = exp->m_paren.line;
+        if (exp->m_arguments.size() > 255) {
+            error("Can't have more than 255 arguments.");
+        }
+        emit(op_code::CALL, static_cast<uint8_t>(exp->m_arguments.size()));
+        return object(nullptr);
+    }
+
+    void compiler::visit_print(print_stmt* statement)
+    {
+        compile(statement->m_expression);
+        emit(op_code::PRINT);
+    }
+
+    void compiler::visit_expression(expression_stmt* statement)
+    {
+        compile(statement->m_expression);
+        emit(op_code::POP);
+    }
+
+    void compiler::visit_var(var_stmt* statement)
+    {
+        if (statement->m_initializer) {
+            compile(statement->m_initializer);
+        }
+        else {
+            emit(op_code::NIL);
+        }
+
+        m_line = statement->m_name.line;
+        if (m_scope_depth == 0) {
+            emit_indexed(op_code::DEFINE_GLOBAL, op_code::DEFINE_GLOBAL_LONG,
+                identifier_constant(statement->m_name.value));
+            return;
+        }
+
+        // redeclaring a variable in the same block overwrites it, just like
+        // defining an existing key does in the interpreter's environment
+        for (int i = static_cast<int>(m_locals.size()) - 1; i >= 0; i--) {
+            if (m_locals[i].depth < m_scope_depth) {
+                break;
+            }
+            if (m_locals[i].name == statement->m_name.lexeme) {
+                emit(op_code::SET_LOCAL, static_cast<uint8_t>(i));
+                emit(op_code::POP);
+                return;
+            }
+        }
+
+        if (m_locals.size() >= MAX_LOCALS) {
+            error("Too many local variables in function.");
+            return;
+        }
+
+        // the initializer's value is left on the stack and becomes the local's slot
+        m_locals.push_back({statement->m_name.lexeme, m_scope_depth});
+    }
+
+    void compiler::visit_block(block_stmt* statement)
+    {
+        begin_scope();
+        for (auto& inner : statement->m_statements) {
+            compile(inner);
+        }
+        end_scope();
+    }
+
+    void compiler::visit_if(if_stmt* statement)
+    {
+        compile(statement->m_condition);
+
+        size_t then_jump = emit_jump(op_code::JUMP_IF_FALSE);
+        emit(op_code::POP);
+        compile(statement->m_then_branch);
+
+        size_t else_jump = emit_jump(op_code::JUMP);
+        patch_jump(then_jump);
+        emit(op_code::POP);
+
+        if (statement->m_else_branch) {
+            compile(statement->m_else_branch);
+        }
+        patch_jump(else_jump);
+    }
+
+    void compiler::visit_while(while_stmt* statement)
+    {
+        size_t loop_start = m_chunk->m_code.size();
+        compile(statement->m_condition);
+
+        size_t exit_jump = emit_jump(op_code::JUMP_IF_FALSE);
+        emit(op_code::POP);
+        compile(statement->m_body);
+        emit_loop(loop_start);
+
+        patch_jump(exit_jump);
+        emit(op_code::POP);
+    }
+
+    void compiler::visit_function(function_stmt* statement)
+    {
+        // todo - only the interpreter runs functions so far, tree_walk won't hand
+        // a program declaring one to the vm
+    }
+
+    void compiler::visit_return(return_stmt* statement)
+    {
+        // only allowed inside a function body
+    }
+
+    void compiler::compile(expr* exp)
+    {
+        exp->accept(this);
+    }
+
+    void compiler::compile(stmt* statement)
+    {
+        statement->accept(this);
+    }
+
+    void compiler::emit(op_code op)
+    {
+        m_chunk->write(op, m_line);
+    }
+
+    void compiler::emit(uint8_t byte)
+    {
+        m_chunk->write(byte, m_line);
+    }
+
+    void compiler::emit(op_code op, uint8_t operand)
+    {
+        emit(op);
+        emit(operand);
+    }
+
+    void compiler::emit_indexed(op_code op, op_code long_op, size_t index)
+    {
+        if (index <= UINT8_MAX) {
+            emit(op, static_cast<uint8_t>(index));
+            return;
+        }
+
+        if (index >= MAX_LONG_INDEX) {
+            error("Too many constants in one chunk.");
+            return;
+        }
+
+        emit(long_op);
+        emit(static_cast<uint8_t>(index & 0xff));
+        emit(static_cast<uint8_t>((index >> 8) & 0xff));
+        emit(static_cast<uint8_t>((index >> 16) & 0xff));
+    }
+
+    void compiler::emit_constant(object value)
+    {
+        emit_indexed(op_code::CONSTANT, op_code::CONSTANT_LONG, m_chunk->add_constant(value));
+    }
+
+    size_t compiler::emit_jump(op_code op)
+    {
+        emit(op);
+        emit(static_cast<uint8_t>(0xff));
+        emit(static_cast<uint8_t>(0xff));
+        return m_chunk->m_code.size() - 2;
+    }
+
+    void compiler::patch_jump(size_t offset)
+    {
+        // -2 to adjust for the bytecode for the jump offset itself
+        size_t jump = m_chunk->m_code.size() - offset - 2;
+        if (jump > UINT16_MAX) {
+            error("Too much code to jump over.");
+        }
+
+        m_chunk->m_code[offset] = (jump >> 8) & 0xff;
+        m_chunk->m_code[offset + 1] = jump & 0xff;
+    }
+
+    void compiler::emit_loop(size_t loop_start)
+    {
+        emit(op_code::LOOP);
+
+        // +3 to also jump back over the LOOP instruction and its operand
+        size_t offset = m_chunk->m_code.size() - loop_start + 2;
+        if (offset > UINT16_MAX) {
+            error("Loop body too large.");
+        }
+
+        emit(static_cast<uint8_t>((offset >> 8) & 0xff));
+        emit(static_cast<uint8_t>(offset & 0xff));
+    }
+
+    size_t compiler::identifier_constant(const object& name)
+    {
+        auto find_iter = m_identifier_constants.find(name);
+        if (find_iter != m_identifier_constants.end()) {
+            return find_iter->second;
+        }
+
+        size_t index = m_chunk->add_constant(name);
+        m_identifier_constants[name] = index;
+        return index;
+    }
+
+    int compiler::resolve_local(std::string_view name)
+    {
+        for (int i = static_cast<int>(m_locals.size()) - 1; i >= 0; i--) {
+            if (m_locals[i].name == name) {
+                return i;
+            }
+        }
+        return -1;
+    }
+
+    void compiler::begin_scope()
+    {
+        m_scope_depth++;
+    }
+
+    void compiler::end_scope()
+    {
+        m_scope_depth--;
+
+        while (not m_locals.empty() && m_locals.back().depth > m_scope_depth) {
+            emit(op_code::POP);
+            m_locals.pop_back();
+        }
+    }
+
+    void compiler::error(std::string message)
+    {
+        tree_walk::error(m_line, message);
+        m_had_error = true;
+    }
+}
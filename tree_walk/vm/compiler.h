@@ -0,0 +1,81 @@
+#pragma once
+#include <map>
+#include <memory>
+#include <string>
+#include <vector>
+#include "../expr.h"
+#include "../stmt.h"
+#include "chunk.h"
+#include "../string_table.h"
+
+namespace lox
+{
+    // walks the tree produced by the parser once and emits bytecode for the vm,
+    // the expression visits return nil as all the work is done by emitting code
+    class compiler : public expr_visitor, stmt_visitor
+    {
+        public:
+            // returns false if a compile error was reported
+            bool compile(const std::vector<stmt*>& statements, chunk* target);
+
+            object visit_assign(assign_expr* exp) override;
+            object visit_binary(binary_expr* exp) override;
+            object visit_grouping(grouping_expr* exp) override;
+            object visit_literal(literal_expr* exp) override;
+            object visit_variable(variable_expr* exp) override;
+            object visit_unary(unary_expr* exp) override;
+            object visit_logical(logical_expr* exp) override;
+            object visit_call(call_expr* exp) override;
+
+            void visit_print(print_stmt* statement) override;
+            void visit_expression(expression_stmt* statement) override;
+            void visit_var(var_stmt* statement) override;
+            void visit_block(block_stmt* statement) override;
+            void visit_if(if_stmt* statement) override;
+            void visit_while(while_stmt* statement) override;
+            void visit_function(function_stmt* statement) override;
+            void visit_return(return_stmt* statement) override;
+
+        private:
+            struct local {
+                // points into the source being compiled
+                std::string_view name;
+                int depth;
+            };
+
+            void compile(expr* exp);
+            void compile(stmt* statement);
+
+            void emit(op_code op);
+            void emit(uint8_t byte);
+            void emit(op_code op, uint8_t operand);
+            // picks the short or _LONG form depending on the size of the index
+            void emit_indexed(op_code op, op_code long_op, size_t index);
+            void emit_constant(object value);
+            size_t emit_jump(op_code op);
+            void patch_jump(size_t offset);
+            void emit_loop(size_t loop_start);
+
+            // name is the interned string the scanner stored in the token
+            size_t identifier_constant(const object& name);
+            // returns -1 if the name isn't a local and must be looked up as a global
+            int resolve_local(std::string_view name);
+
+            void begin_scope();
+            void end_scope();
+
+            // reports against the line of the last token seen
+            void error(std::string message);
+
+            chunk* m_chunk = nullptr;
+            int m_line = 0;
+            bool m_had_error = false;
+
+            std::vector<local> m_locals;
+            int m_scope_depth = 0;
+            interned_map<size_t> m_identifier_constants;
+
+            static const size_t MAX_LOCALS = 256;
+            static const size_t MAX_LONG_INDEX = 1 << 24;
+    };
+}
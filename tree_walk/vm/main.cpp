@@ -0,0 +1,19 @@
+#include <iostream>
+#include "../tree_walk.h"
+
+// same front end as lox but executes everything on the bytecode vm
+int main(int num_args, char ** args) {
+    lox::tree_walk::set_engine(lox::engine_type::vm);
+
+    if (num_args == 2) {
+        lox::tree_walk::run_file(args[1]);
+    }
+    else if (num_args == 1) {
+        lox::tree_walk::run_prompt();
+    }
+    else {
+        std::cout << "Usage: lox_vm [script]" << std::endl;
+    }
+
+    return 0;
+}
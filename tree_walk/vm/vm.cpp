@@ -0,0 +1,235 @@
+#include "vm.h"
+#include <iostream>
+#include "../lox_callable.h"
+#include "../native_funcs.h"
+#include "../tree_walk.h"
+
+namespace lox
+{
+    vm::vm()
+    {
+        m_stack.reserve(256);
+        for (auto& native : native_functions()) {
+            m_globals[object(native.first)] = native.second;
+        }
+    }
+
+    void vm::interpret(const chunk& chunk)
+    {
+        const uint8_t* ip = chunk.m_code.data();
+        const uint8_t* instruction = ip;
+
+        auto read_byte = [&ip]() {
+            return *ip++;
+        };
+
+        auto read_short = [&ip]() {
+            ip += 2;
+            return static_cast<uint16_t>((ip[-2] << 8) | ip[-1]);
+        };
+
+        auto read_long = [&ip]() {
+            ip += 3;
+            return static_cast<size_t>(ip[-3]) | (static_cast<size_t>(ip[-2]) << 8) |
+                (static_cast<size_t>(ip[-1]) << 16);
+        };
+
+        auto pop = [this]() {
+            object value = m_stack.back();
+            m_stack.pop_back();
+            return value;
+        };
+
+        try {
+            while (true) {
+                instruction = ip;
+                switch (static_cast<op_code>(read_byte())) {
+                    case op_code::CONSTANT:
+                        m_stack.push_back(chunk.m_constants[read_byte()]);
+                        break;
+                    case op_code::CONSTANT_LONG:
+                        m_stack.push_back(chunk.m_constants[read_long()]);
+                        break;
+                    case op_code::NIL:
+                        m_stack.push_back(object(nullptr));
+                        break;
+                    case op_code::TRUE:
+                        m_stack.push_back(object(true));
+                        break;
+                    case op_code::FALSE:
+                        m_stack.push_back(object(false));
+                        break;
+                    case op_code::POP:
+                        m_stack.pop_back();
+                        break;
+
+                    case op_code::GET_LOCAL:
+                        m_stack.push_back(m_stack[read_byte()]);
+                        break;
+                    case op_code::SET_LOCAL:
+                        m_stack[read_byte()] = m_stack.back();
+                        break;
+
+                    case op_code::GET_GLOBAL:
+                    case op_code::GET_GLOBAL_LONG:
+                    {
+                        size_t index = *instruction == static_cast<uint8_t>(op_code::GET_GLOBAL) ?
+                            read_byte() : read_long();
+                        auto& name = chunk.m_constants[index];
+                        auto find_iter = m_globals.find(name);
+                        if (find_iter == m_globals.end()) {
+                            runtime_error(chunk, instruction, "Undefined variable '" + name.as_text() + "'.");
+                            return;
+                        }
+                        m_stack.push_back(find_iter->second);
+                    } break;
+                    case op_code::DEFINE_GLOBAL:
+                    case op_code::DEFINE_GLOBAL_LONG:
+                    {
+                        size_t index = *instruction == static_cast<uint8_t>(op_code::DEFINE_GLOBAL) ?
+                            read_byte() : read_long();
+                        m_globals[chunk.m_constants[index]] = pop();
+                    } break;
+                    case op_code::SET_GLOBAL:
+                    case op_code::SET_GLOBAL_LONG:
+                    {
+                        size_t index = *instruction == static_cast<uint8_t>(op_code::SET_GLOBAL) ?
+                            read_byte() : read_long();
+                        auto& name = chunk.m_constants[index];
+                        auto find_iter = m_globals.find(name);
+                        if (find_iter == m_globals.end()) {
+                            runtime_error(chunk, instruction, "Undefined variable '" + name.as_text() + "'.");
+                            return;
+                        }
+                        // assignment is an expression so the value stays on the stack
+                        find_iter->second = m_stack.back();
+                    } break;
+
+                    case op_code::EQUAL:
+                    {
+                        object right = pop();
+                        m_stack.back() = m_stack.back() == right;
+                    } break;
+                    case op_code::NOT_EQUAL:
+                    {
+                        object right = pop();
+                        m_stack.back() = m_stack.back() != right;
+                    } break;
+                    case op_code::GREATER:
+                    {
+                        object right = pop();
+                        m_stack.back() = m_stack.back() > right;
+                    } break;
+                    case op_code::GREATER_EQUAL:
+                    {
+                        object right = pop();
+                        m_stack.back() = m_stack.back() >= right;
+                    } break;
+                    case op_code::LESS:
+                    {
+                        object right = pop();
+                        m_stack.back() = m_stack.back() < right;
+                    } break;
+                    case op_code::LESS_EQUAL:
+                    {
+                        object right = pop();
+                        m_stack.back() = m_stack.back() <= right;
+                    } break;
+                    case op_code::ADD:
+                    {
+                        object right = pop();
+                        m_stack.back() = m_stack.back() + right;
+                    } break;
+                    case op_code::SUBTRACT:
+                    {
+                        object right = pop();
+                        m_stack.back() = m_stack.back() - right;
+                    } break;
+                    case op_code::MULTIPLY:
+                    {
+                        object right = pop();
+                        m_stack.back() = m_stack.back() * right;
+                    } break;
+                    case op_code::DIVIDE:
+                    {
+                        object right = pop();
+                        m_stack.back() = m_stack.back() / right;
+                    } break;
+                    case op_code::NOT:
+                        m_stack.back() = !m_stack.back();
+                        break;
+                    case op_code::NEGATE:
+                        m_stack.back() = -m_stack.back();
+                        break;
+
+                    case op_code::PRINT:
+                        std::cout << pop().to_string() << std::endl;
+                        break;
+
+                    case op_code::JUMP:
+                    {
+                        uint16_t offset = read_short();
+                        ip += offset;
+                    } break;
+                    case op_code::JUMP_IF_FALSE:
+                    {
+                        uint16_t offset = read_short();
+                        if (not m_stack.back()) {
+                            ip += offset;
+                        }
+                    } break;
+                    case op_code::LOOP:
+                    {
+                        uint16_t offset = read_short();
+                        ip -= offset;
+                    } break;
+
+                    case op_code::CALL:
+                    {
+                        uint8_t arg_count = read_byte();
+                        auto first_argument = m_stack.end() - arg_count;
+                        object& callee = *(first_argument - 1);
+
+                        if (not callee.is_callable()) {
+                            runtime_error(chunk, instruction, "Can only call functions and classes.");
+                            return;
+                        }
+
+                        auto func = callee.as_callable();
+                        if (arg_count != func->arity()) {
+                            runtime_error(chunk, instruction,
+                                "Expected " +
+                                std::to_string(func->arity()) +
+                                " arguments but got " +
+                                std::to_string(arg_count) + ".");
+                            return;
+                        }
+
+                        std::vector<object> arguments(first_argument, m_stack.end());
+                        // natives don't need the tree walking interpreter
+                        object result = func->call(nullptr, arguments);
+                        m_stack.resize(m_stack.size() - arg_count);
+                        m_stack.back() = result;
+                    } break;
+
+                    case op_code::RETURN:
+                        return;
+                }
+            }
+        }
+        // the operators on lox::object report type errors this way
+        catch (const std::logic_error& e) {
+            runtime_error(chunk, instruction, e.what());
+        }
+    }
+
+    void vm::runtime_error(const chunk& chunk, const uint8_t* instruction, std::string message)
+    {
+        token where;
+        where.type = token_type::END_OF_FILE;
+        where.line = chunk.get_line(instruction - chunk.m_code.data());
+
+        tree_walk::runtime_error(lox_runtime_exception(where, message));
+        m_stack.clear();
+    }
+}
@@ -0,0 +1,25 @@
+#pragma once
+#include <string>
+#include <unordered_map>
+#include <vector>
+#include "chunk.h"
+#include "../string_table.h"
+
+namespace lox
+{
+    // a stack based virtual machine that executes the bytecode produced by the compiler,
+    // globals persist between calls to interpret so it can back the interactive prompt
+    class vm
+    {
+        public:
+            vm();
+
+            void interpret(const chunk& chunk);
+
+        private:
+            void runtime_error(const chunk& chunk, const uint8_t* instruction, std::string message);
+
+            std::vector<object> m_stack;
+            interned_map<object> m_globals;
+    };
+}